@@ -8,6 +8,19 @@ message("You are running qmake on a generated .pro file. This may not work!")
 
 
 HEADERS += ./src/IObjectClassInstance.h \
+    ./src/FrameProfiler.h \
+    ./src/FileNameIndex.h \
+    ./src/LevelEntry.h \
+    ./src/JsonStreamReader.h \
+    ./src/LevelSnapshotCache.h \
+    ./src/ThumbnailDiskCache.h \
+    ./src/LevelThumbnails.h \
+    ./src/TileBlitter.h \
+    ./src/LevelModel.h \
+    ./src/LevelLoadScheduler.h \
+    ./src/FloodFillPreview.h \
+    ./src/Benchmarks.h \
+    ./src/TileFloodFill.h \
     ./src/ScriptingLanguage.h \
     ./src/StringHash.h \
     ./src/StringTools.h \
@@ -30,6 +43,7 @@ HEADERS += ./src/IObjectClassInstance.h \
     ./src/DarkStyleTheme.h \
     ./src/DialogFeatures.h \
     ./src/EntitySpatialGrid.h \
+    ./src/FlatEntitySpatialGrid.h \
     ./src/FileFormatManager.h \
     ./src/FusionDarkTheme.h \
     ./src/FusionLightTheme.h \
@@ -137,6 +151,17 @@ HEADERS += ./src/IObjectClassInstance.h \
     ./src/AniEditor/AniEditorAddSprite.h \
     ./src/AniEditor/AniEditorWindow.h
 SOURCES += ./src/AboutDialog.cpp \
+    ./src/FrameProfiler.cpp \
+    ./src/FileNameIndex.cpp \
+    ./src/JsonStreamReader.cpp \
+    ./src/LevelSnapshotCache.cpp \
+    ./src/ThumbnailDiskCache.cpp \
+    ./src/LevelThumbnails.cpp \
+    ./src/TileBlitter.cpp \
+    ./src/LevelLoadScheduler.cpp \
+    ./src/FloodFillPreview.cpp \
+    ./src/Benchmarks.cpp \
+    ./src/TileFloodFill.cpp \
     ./src/AbstractLevelEntity.cpp \
     ./src/AbstractLevelFormat.cpp \
     ./src/AbstractResourceManager.cpp \
@@ -71,6 +71,7 @@ namespace TilesEditor
 
 		void setLayerIndex(int layer) {
 			m_tileLayer = layer;
+			updateSpatialGridDepth();
 		}
 
 		int getLayerIndex() const {
@@ -87,6 +88,13 @@ namespace TilesEditor
 	
 		void setEntityOrder(double value) {
 			m_entityOrder = value;
+			updateSpatialGridDepth();
+		}
+
+		//Spatial maps keep entities in depth order, so they need to know when it changes
+		void updateSpatialGridDepth() {
+			if (m_spatialGridAdded && m_world && m_spatialGridDepth != getRealDepth())
+				m_world->updateEntityRect(this);
 		}
 
 		sgs_Variable& getScriptObject();
@@ -94,7 +102,7 @@ namespace TilesEditor
 		double getEntityOrder() const { return m_entityOrder; }
 		double getUnitWidth() const;
 		double getUnitHeight() const;
-		virtual double getRealDepth() const {
+		double getRealDepth() const override {
 			return getDepth() + m_entityOrder;
 		}
 
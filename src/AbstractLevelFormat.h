@@ -3,14 +3,20 @@
 
 #include <QIODevice>
 #include "IWorld.h"
+#include "LevelModel.h"
 
 namespace TilesEditor
 {
 	class LevelNPC;
+	class Tileset;
 	class AbstractLevelFormat
 	{
 	public:
 		virtual bool loadLevel(Level* inputLevel, QIODevice* stream) = 0;
+
+		//Read the file into a detached model (see canParse). This runs on worker threads,
+		//so it can't touch a level, the world or any resources
+		virtual bool parseLevel(LevelModel* model, Tileset* defaultTileset, QIODevice* stream) { return false; }
 		virtual bool saveLevel(Level* outputLevel, QIODevice* stream) = 0;
 
 		//Apply the format to this level.
@@ -18,6 +24,7 @@ namespace TilesEditor
 
 		virtual bool canSave() const { return false; }
 		virtual bool canLoad() const { return false; }
+		virtual bool canParse() const { return false; }
 
 		virtual void filterLevelSize(int* hcount, int* vcount) {}
 		virtual bool customLevelSizes() const { return true; }
@@ -1,17 +1,34 @@
 #include <QTextStream>
+#include <QThread>
 #include "AbstractResourceManager.h"
 #include "Image.h"
 #include "AniEditor/Ani.h"
 
 namespace TilesEditor
 {
+	qint64 AbstractResourceManager::retentionBudget = 64 * 1024 * 1024;
+
+	//Anis (and images with nothing decoded) still cost something, so they can't pile up without limit
+	static const qint64 MIN_RETAINED_COST = 1024;
+
+	AbstractResourceManager::AbstractResourceManager(ObjectManager* objectManager) :
+		m_objectManager(objectManager)
+	{
+		m_decodePool.setMaxThreadCount(qMax(2, QThread::idealThreadCount() - 1));
+	}
 
 	AbstractResourceManager::~AbstractResourceManager()
 	{
+		//Decodes still running would hand their images to m_decodeContext
+		m_decodePool.clear();
+		m_decodePool.waitForDone();
+
 		for (auto resource : m_resources)
 		{
 			resource->decrementAndDelete();
 		}
+
+		clearRetained();
 	}
 
 	QString AbstractResourceManager::readAllToString(const QString& fileName)
@@ -29,7 +46,7 @@ namespace TilesEditor
 	
 	}
 
-    Resource* AbstractResourceManager::loadResource(IFileRequester* requester, const QString& resourceName, ResourceType type)
+    Resource* AbstractResourceManager::loadResource(IFileRequester* requester, const QString& resourceName, ResourceType type, bool async)
     {
 		auto resourceNameLower = resourceName.toLower();
 		auto it = m_resources.find(resourceNameLower);
@@ -40,14 +57,42 @@ namespace TilesEditor
 
 			if (resource->getResourceType() == type)
 			{
+				//Still being decoded
+				if (m_decodingImages.contains(resourceNameLower))
+				{
+					if (requester && async)
+						addFileRequest(requester, resourceNameLower);
+					else decodeImageNow(resourceNameLower);
+				}
+
 				resource->incrementRef();
 				return resource;
 			}
 			return nullptr;
 		}
+		else if (auto resource = reviveResource(resourceNameLower, type))
+		{
+			return resource;
+		}
 		else if (m_failedResources.find(resourceNameLower) == m_failedResources.end())
 		{
 			Resource* res = nullptr;
+			++m_retentionMisses;
+
+			//Return a not loaded image now, and let the requester know when it has been decoded
+			QString imagePath;
+			if (type == ResourceType::RESOURCE_IMAGE && requester && async && locateFile(resourceNameLower, &imagePath))
+			{
+				auto image = new Image(resourceNameLower);
+				image->setFileName(imagePath);
+				image->incrementRef();
+				m_resources[resourceNameLower] = image;
+				m_decodingImages[resourceNameLower] = image;
+
+				addFileRequest(requester, resourceNameLower);
+				decodeImage(resourceNameLower, imagePath);
+				return image;
+			}
 
 			QString fullPath;
 			auto stream = openStream(resourceNameLower, QIODevice::ReadOnly, &fullPath);
@@ -112,8 +157,9 @@ namespace TilesEditor
 				resource->incrementRef();
 				return resource;
 			}
+			return nullptr;
 		}
-		return nullptr;
+		return reviveResource(resourceNameLower, type);
 	}
 
 	void AbstractResourceManager::freeResource(Resource* resource)
@@ -123,14 +169,105 @@ namespace TilesEditor
 
 		if (resource->decrementRef() == 0)
 		{
-			auto it = m_resources.find(resource->getName().toLower());
-			if (it != m_resources.end())
+			auto resourceNameLower = resource->getName().toLower();
+			auto it = m_resources.find(resourceNameLower);
+			auto registered = it != m_resources.end() && it.value() == resource;
+			if (registered)
 				m_resources.erase(it);
 
+			//Keep it for the next time it is asked for. Blanks still waiting on a file and images still decoding aren't kept
+			if (registered && retentionBudget > 0 && resource->isLoaded() && !m_decodingImages.contains(resourceNameLower) && !m_fileRequests.contains(resourceNameLower))
+			{
+				deleteRetained(resourceNameLower);
+
+				m_retainedOrder.push_front(resource);
+				m_retained[resourceNameLower] = m_retainedOrder.begin();
+				m_retainedBytes += getRetainedCost(resource);
+				evictRetained(retentionBudget);
+				return;
+			}
+
+			//Any decode still running for it is ignored
+			m_decodingImages.remove(resourceNameLower);
+			delete resource;
+		}
+	}
+
+	qint64 AbstractResourceManager::getRetainedCost(Resource* resource)
+	{
+		return qMax(resource->getMemoryUsage(), MIN_RETAINED_COST);
+	}
+
+	Resource* AbstractResourceManager::reviveResource(const QString& name, ResourceType type)
+	{
+		auto it = m_retained.find(name);
+		if (it == m_retained.end())
+			return nullptr;
+
+		auto resource = *it.value();
+		if (resource->getResourceType() != type)
+		{
+			deleteRetained(name);
+			return nullptr;
+		}
+
+		m_retainedBytes -= getRetainedCost(resource);
+		m_retainedOrder.erase(it.value());
+		m_retained.erase(it);
+		++m_retentionHits;
+
+		resource->incrementRef();
+		m_resources[name] = resource;
+		return resource;
+	}
+
+	void AbstractResourceManager::deleteRetained(const QString& name)
+	{
+		auto it = m_retained.find(name);
+		if (it == m_retained.end())
+			return;
+
+		auto resource = *it.value();
+		m_retainedBytes -= getRetainedCost(resource);
+		m_retainedOrder.erase(it.value());
+		m_retained.erase(it);
+		delete resource;
+	}
+
+	void AbstractResourceManager::evictRetained(qint64 budget)
+	{
+		while (m_retainedBytes > budget && !m_retainedOrder.empty())
+		{
+			auto resource = m_retainedOrder.back();
+			m_retainedOrder.pop_back();
+			m_retained.remove(resource->getName().toLower());
+			m_retainedBytes -= getRetainedCost(resource);
+			++m_retentionEvictions;
 			delete resource;
 		}
 	}
 
+	AbstractResourceManager::RetentionStats AbstractResourceManager::getRetentionStats() const
+	{
+		RetentionStats retval;
+		retval.hits = m_retentionHits;
+		retval.misses = m_retentionMisses;
+		retval.evictions = m_retentionEvictions;
+		retval.bytes = m_retainedBytes;
+		retval.count = int(m_retainedOrder.size());
+		return retval;
+	}
+
+	void AbstractResourceManager::clearRetained()
+	{
+		for (auto resource : m_retainedOrder)
+			delete resource;
+
+		m_retainedOrder.clear();
+		m_retained.clear();
+		m_retainedBytes = 0;
+	}
+
 	QPixmap AbstractResourceManager::loadPixmap(const QString& name)
 	{
 		auto resourceNameLower = name.toLower();
@@ -165,6 +302,10 @@ namespace TilesEditor
 	void AbstractResourceManager::updateFile(const QString& name)
 	{
 		auto resourceNameLower = name.toLower();
+
+		//A kept copy of the old file is loaded again when next asked for
+		deleteRetained(resourceNameLower);
+
 		auto it = m_resources.find(resourceNameLower);
 		if (it != m_resources.end())
 		{
@@ -175,55 +316,114 @@ namespace TilesEditor
 			auto stream = openStreamFullPath(fileName, QIODevice::ReadOnly);
 
 			if (stream) {
+				m_decodingImages.remove(resourceNameLower);
 				resource->replace(stream, this);
 				resource->setLoaded(true);
 				delete stream;
 			}
 		}
 
-		auto it2 = m_fileRequests.find(resourceNameLower);
-		if (it2 != m_fileRequests.end())
-		{
-			auto listeners = it2.value();
-			for (auto listener : listeners)
-				listener->fileReady(resourceNameLower, this);
-			m_fileRequests.erase(it2);
-		}
+		notifyFileReady(resourceNameLower);
 	}
 
 	void AbstractResourceManager::updateFile(const QString& resourceName, QIODevice* stream)
 	{
 		//Check if this file is a loaded resource. If it is, replace it
 		auto resourceNameLower = resourceName.toLower();
+		deleteRetained(resourceNameLower);
+
 		auto it = m_resources.find(resourceNameLower);
 		if (it != m_resources.end())
 		{
 			auto resource = it.value();
+			m_decodingImages.remove(resourceNameLower);
 			resource->replace(stream, this);
 			resource->setLoaded(true);
 		}
 
 		//Alert all our listeners that this file has been received
-		auto it2 = m_fileRequests.find(resourceNameLower);
-		if (it2 != m_fileRequests.end())
+		notifyFileReady(resourceNameLower);
+	}
+
+	void AbstractResourceManager::notifyFileReady(const QString& fileName)
+	{
+		auto it = m_fileRequests.find(fileName);
+		if (it != m_fileRequests.end())
 		{
-			auto listeners = it2.value();
+			auto listeners = it.value();
 			for (auto listener : listeners)
-				listener->fileReady(resourceNameLower, this);
-			m_fileRequests.erase(it2);
+				listener->fileReady(fileName, this);
+			m_fileRequests.erase(it);
 		}
 	}
 
+	void AbstractResourceManager::decodeImage(const QString& name, const QString& fullPath)
+	{
+		auto context = &m_decodeContext;
+		m_decodePool.start([this, context, name, fullPath]()
+		{
+			QImage decoded;
+			auto stream = openStreamFullPath(fullPath, QIODevice::ReadOnly);
+			if (stream)
+			{
+				decoded.loadFromData(stream->readAll());
+				delete stream;
+			}
+
+			QMetaObject::invokeMethod(context, [this, name, decoded]() {
+				imageDecoded(name, decoded);
+			}, Qt::QueuedConnection);
+		});
+	}
+
+	void AbstractResourceManager::decodeImageNow(const QString& name)
+	{
+		auto image = m_decodingImages.value(name);
+		if (image == nullptr)
+			return;
+
+		//The background decode is ignored when it finishes
+		QImage decoded;
+		auto stream = openStreamFullPath(image->getFileName(), QIODevice::ReadOnly);
+		if (stream)
+		{
+			decoded.loadFromData(stream->readAll());
+			delete stream;
+		}
+		imageDecoded(name, decoded);
+	}
+
+	void AbstractResourceManager::imageDecoded(const QString& name, const QImage& decoded)
+	{
+		//Freed, replaced or decoded already
+		auto image = m_decodingImages.take(name);
+		if (image == nullptr)
+			return;
+
+		if (decoded.isNull())
+		{
+			requestFileFailed(name);
+			return;
+		}
+
+		image->setImage(decoded);
+		image->setLoaded(true);
+		notifyFileReady(name);
+	}
+
 	void AbstractResourceManager::requestFile(IFileRequester* listener, const QString& fileName)
+	{
+		addFileRequest(listener, fileName);
+		requestFile(fileName);
+	}
+
+	void AbstractResourceManager::addFileRequest(IFileRequester* listener, const QString& fileName)
 	{
 		auto& thing = m_listeners[listener];
 		thing.insert(fileName);
 
 		auto& thing2 = m_fileRequests[fileName];
 		thing2.insert(listener);
-
-
-		requestFile(fileName);
 	}
 
 	void AbstractResourceManager::removeListener(IFileRequester* listener)
@@ -6,6 +6,11 @@
 #include <QSet>
 #include <QIODevice>
 #include <QPixmap>
+#include <QImage>
+#include <QHash>
+#include <QObject>
+#include <QThreadPool>
+#include <list>
 #include "Resource.h"
 #include "IFileRequester.h"
 #include "RefCounter.h"
@@ -13,6 +18,7 @@
 namespace TilesEditor
 {
 	class ObjectManager;
+	class Image;
 	class AbstractResourceManager :
 		public RefCounter
 	{
@@ -24,9 +30,35 @@ namespace TilesEditor
 		QMap<IFileRequester*, QSet<QString>> m_listeners;
 		QMap<QString, QSet<IFileRequester*>> m_fileRequests;
 
+		//Images still being decoded in the background. Everyone asking for one gets the same (not loaded) Image
+		QHash<QString, Image*> m_decodingImages;
+		QThreadPool m_decodePool;
+
+		//Decoded images are handed back to the main thread through this, so they are dropped once the manager is gone
+		QObject m_decodeContext;
+
+		//Freed resources kept so they can be handed out again without going to disk. Most recently freed first
+		std::list<Resource*> m_retainedOrder;
+		QHash<QString, std::list<Resource*>::iterator> m_retained;
+		qint64 m_retainedBytes = 0;
+		qint64 m_retentionHits = 0;
+		qint64 m_retentionMisses = 0;
+		qint64 m_retentionEvictions = 0;
+
 	private:
 		void clearFileRequest(const QString& fileName);
 		void clearFileListener(IFileRequester* listener);
+		void addFileRequest(IFileRequester* listener, const QString& fileName);
+		void notifyFileReady(const QString& fileName);
+
+		void decodeImage(const QString& name, const QString& fullPath);
+		void decodeImageNow(const QString& name);
+		void imageDecoded(const QString& name, const QImage& decoded);
+
+		static qint64 getRetainedCost(Resource* resource);
+		Resource* reviveResource(const QString& name, ResourceType type);
+		void deleteRetained(const QString& name);
+		void evictRetained(qint64 budget);
 
 	protected:
 		//Filename should be name part only. not FULL PATH
@@ -37,8 +69,18 @@ namespace TilesEditor
 		void requestFileFailed(const QString& fileName);
 		
 	public:
-		AbstractResourceManager(ObjectManager* objectManager) :
-			m_objectManager(objectManager) {}
+		struct RetentionStats {
+			qint64 hits = 0;
+			qint64 misses = 0;
+			qint64 evictions = 0;
+			qint64 bytes = 0;
+			int count = 0;
+		};
+
+		//Freed images and anis are kept (least recently freed first to go) until they use more than this many bytes. 0 to delete them straight away
+		static qint64 retentionBudget;
+
+		AbstractResourceManager(ObjectManager* objectManager);
 
 		virtual ~AbstractResourceManager();
 
@@ -46,12 +88,18 @@ namespace TilesEditor
 
 		ObjectManager* getObjectManager() { return m_objectManager; }
 		void setObjectManager(ObjectManager* objectManager) { m_objectManager = objectManager; }
-		Resource* loadResource(IFileRequester* requester, const QString& name, ResourceType type);
+		//Images asked for by a requester are decoded in the background. They are returned not loaded, and requester->fileReady
+		//is called once they are. Pass async as false to always get the image decoded
+		Resource* loadResource(IFileRequester* requester, const QString& name, ResourceType type, bool async = true);
 		Resource* acquireExistingResource(const QString& name, ResourceType type);
 
 		void freeResource(Resource* resource);
 		QPixmap loadPixmap(const QString& name);
 
+		//Hits are resources loadResource got back from the freed ones, misses are ones it had to load
+		RetentionStats getRetentionStats() const;
+		void clearRetained();
+
 		void updateFile(const QString& name);
 		void updateFile(const QString& resourceName, QIODevice* stream);
 
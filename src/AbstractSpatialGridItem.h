@@ -11,6 +11,9 @@ namespace TilesEditor
 		template <typename T>
 		friend class EntitySpatialGrid;
 
+		template <typename T>
+		friend class FlatEntitySpatialGrid;
+
 	protected:
 		int m_spacialGridLeft = 0;
 		int m_spacialGridTop = 0;
@@ -20,7 +23,15 @@ namespace TilesEditor
 		uint64_t m_spatialGridSearchIndex = 0;
 		bool m_spatialGridAdded = false;
 
+		//getRealDepth when the item was added or last updated. FlatEntitySpatialGrid keeps its cells in this order
+		double m_spatialGridDepth = 0.0;
+
 	public:
+		//Items are drawn lowest depth first
+		virtual double getRealDepth() const {
+			return 0.0;
+		}
+
 		virtual double getX() const {
 			return QRectF::x();
 		}
@@ -434,9 +434,18 @@ namespace TilesEditor
 
 	void Ani::replace(QIODevice* stream, AbstractResourceManager* resourceManager)
 	{
+		m_compositeFrames.clear();
 		loadGraalAni(this, stream, resourceManager);
 	}
 
+	qint64 Ani::getMemoryUsage() const
+	{
+		qint64 retval = 0;
+		for (auto& composite : m_compositeFrames)
+			retval += qint64(composite.pixmap.width()) * composite.pixmap.height() * (composite.pixmap.depth() / 8);
+		return retval;
+	}
+
 	Ani* Ani::loadGraalAni(const QString& name, QIODevice* stream, AbstractResourceManager* resourceManager)
 	{
 		Ani* retval = new Ani(name, resourceManager);
@@ -5,6 +5,7 @@
 #include <QString>
 #include <QList>
 #include <QMap>
+#include <QHash>
 #include <QVector>
 #include <QIODevice>
 #include <QPainter>
@@ -241,6 +242,23 @@ namespace TilesEditor
 		QMap<QString, Image*> m_hiddenDefaults;
 
 		QVector<Frame*> m_frames;
+
+		//Frames drawn by AniInstance with all their sprites, shared by every instance drawing the same frame with the same
+		//properties and body colours. Cleared when the ani is replaced
+		struct CompositeFrame {
+			QPixmap pixmap;
+
+			//Where the pixmap goes, relative to the position the ani is drawn at
+			QPoint offset;
+
+			//Images drawn into it, with their version at the time
+			QVector<QPair<Image*, quint64>> images;
+			bool cacheable = true;
+		};
+
+		static const int MAX_COMPOSITE_FRAMES = 256;
+		QHash<QByteArray, CompositeFrame> m_compositeFrames;
+
 		bool m_containsBodySprite;
 		int m_nextSpriteIndex = 0;
 		QRect m_boundingBox;
@@ -295,6 +313,7 @@ namespace TilesEditor
 
 		ResourceType getResourceType() const override { return RESOURCE_ANI; }
 		void replace(QIODevice* stream, AbstractResourceManager* resourceManager) override;
+		qint64 getMemoryUsage() const override;
 
 		QString getPropertyValue(const QString& propName) override { return getDefaultImageName(propName); }
 		static Ani* loadGraalAni(const QString& name, QIODevice* stream, AbstractResourceManager* resourceManager);
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <QPicture>
 #include "AniInstance.h"
 
 namespace TilesEditor
@@ -122,12 +124,84 @@ namespace TilesEditor
 		}
 	}
 
+	QByteArray AniInstance::getCompositeKey(size_t frameIndex, int dir) const
+	{
+		QByteArray retval;
+		auto append = [&retval](const auto& value) {
+			retval.append(reinterpret_cast<const char*>(&value), sizeof(value));
+		};
+
+		append(quint64(frameIndex));
+		append(dir);
+		for (auto colour : m_bodyColours)
+			append(colour);
+
+		//Property values pick sprites (and images), and the image versions catch images being replaced
+		for (auto it = m_aniProperties.cbegin(); it != m_aniProperties.cend(); ++it)
+		{
+			retval.append(it.key().toUtf8()).append('\0');
+			retval.append(it.value().first.toUtf8()).append('\0');
+			append(it.value().second ? it.value().second->getVersion() : quint64(0));
+		}
+		return retval;
+	}
+
+	Ani::CompositeFrame* AniInstance::getCompositeFrame(Ani::Frame* frame, size_t frameIndex, int dir, AbstractResourceManager* resourceManager, QPainter* painter)
+	{
+		auto key = getCompositeKey(frameIndex, dir);
+		auto it = m_ani->m_compositeFrames.find(key);
+		if (it != m_ani->m_compositeFrames.end())
+		{
+			auto& composite = it.value();
+
+			//Custom images aren't part of the key, so check none of the images have been replaced since
+			auto current = std::all_of(composite.images.cbegin(), composite.images.cend(), [](const QPair<Image*, quint64>& pair) {
+				return pair.first->getVersion() == pair.second;
+			});
+
+			if (current)
+				return composite.cacheable ? &composite : nullptr;
+			m_ani->m_compositeFrames.erase(it);
+		}
+
+		//Record the frame to find out how big it is, then play it into a pixmap
+		Ani::CompositeFrame composite;
+		QPicture picture;
+		QPainter recorder(&picture);
+		recorder.setRenderHints(painter->renderHints());
+		drawPieces(frame, dir, 0.0, 0.0, resourceManager, &recorder, &composite);
+		recorder.end();
+
+		auto rect = picture.boundingRect();
+		if (composite.cacheable && rect.isValid())
+		{
+			QImage image(rect.size(), QImage::Format_ARGB32_Premultiplied);
+			image.fill(Qt::transparent);
+
+			QPainter imagePainter(&image);
+			imagePainter.drawPicture(-rect.topLeft(), picture);
+			imagePainter.end();
+
+			composite.pixmap = QPixmap::fromImage(image);
+			composite.offset = rect.topLeft();
+		}
+
+		if (m_ani->m_compositeFrames.size() >= Ani::MAX_COMPOSITE_FRAMES)
+			m_ani->m_compositeFrames.clear();
+
+		//Frames that can't be cached are remembered too, so they aren't recorded every time
+		auto& retval = m_ani->m_compositeFrames[key];
+		retval = composite;
+		return retval.cacheable ? &retval : nullptr;
+	}
+
 	void AniInstance::draw(int dir, double x, double y, AbstractResourceManager* resourceManager, QPainter* painter)
 	{
 		if (m_ani == nullptr)
 			return;
 
-		auto frame = m_ani->getFrame((size_t)m_frame);
+		auto frameIndex = (size_t)m_frame;
+		auto frame = m_ani->getFrame(frameIndex);
 
 		if (frame != nullptr)
 		{
@@ -135,25 +209,37 @@ namespace TilesEditor
 			dir = dir < 0 ? 0 : dir;
 			dir = dir > 3 ? 3 : dir;
 
-			auto& pieces = frame->pieces[dir];
-
-			for (auto& piece : pieces)
+			auto composite = getCompositeFrame(frame, frameIndex, dir, resourceManager, painter);
+			if (composite != nullptr)
 			{
-				if (piece->type == Ani::Frame::PIECE_SPRITE)
-				{ 
-					auto spritePiece = static_cast<Ani::Frame::FramePieceSprite*>(piece);
-					auto sprite = m_ani->getAniSprite(this, spritePiece->spriteIndex, spritePiece->spriteName);
+				if (!composite->pixmap.isNull())
+					painter->drawPixmap(qFloor(0.5 + x) + composite->offset.x(), qFloor(0.5 + y) + composite->offset.y(), composite->pixmap);
+				return;
+			}
 
-					if (sprite && sprite->width * sprite->height > 0)
-						drawSprite(sprite, x + piece->xoffset, y + piece->yoffset, resourceManager, painter, 0);
-				}
+			drawPieces(frame, dir, x, y, resourceManager, painter, nullptr);
+		}
+	}
+
+	void AniInstance::drawPieces(Ani::Frame* frame, int dir, double x, double y, AbstractResourceManager* resourceManager, QPainter* painter, Ani::CompositeFrame* composite)
+	{
+		auto& pieces = frame->pieces[dir];
 
+		for (auto& piece : pieces)
+		{
+			if (piece->type == Ani::Frame::PIECE_SPRITE)
+			{ 
+				auto spritePiece = static_cast<Ani::Frame::FramePieceSprite*>(piece);
+				auto sprite = m_ani->getAniSprite(this, spritePiece->spriteIndex, spritePiece->spriteName);
+
+				if (sprite && sprite->width * sprite->height > 0)
+					drawSprite(sprite, x + piece->xoffset, y + piece->yoffset, resourceManager, painter, 0, composite);
 			}
 
 		}
 	}
 
-	void AniInstance::drawSprite(Ani::AniSprite* sprite, double x, double y, AbstractResourceManager* resourceManager, QPainter* painter, int level)
+	void AniInstance::drawSprite(Ani::AniSprite* sprite, double x, double y, AbstractResourceManager* resourceManager, QPainter* painter, int level, Ani::CompositeFrame* composite)
 	{
 		if (m_ani == nullptr)
 			return;
@@ -175,7 +261,7 @@ namespace TilesEditor
 					auto child = m_ani->getAniSprite(this, childIndex, "");
 					if (child)
 					{
-						drawSprite(child, x + int(offsets.x()), y + int(offsets.y()), resourceManager, painter, level + 1);
+						drawSprite(child, x + int(offsets.x()), y + int(offsets.y()), resourceManager, painter, level + 1, composite);
 					}
 				}
 			}
@@ -194,6 +280,9 @@ namespace TilesEditor
 
 			if (image != nullptr)
 			{
+				if (composite)
+					composite->images.push_back(QPair<Image*, quint64>(image, image->getVersion()));
+
 				auto opacity = painter->opacity();
 				painter->save();
 				painter->translate(qFloor(0.5 + x), qFloor(0.5 + y));
@@ -211,6 +300,10 @@ namespace TilesEditor
 					auto compMode = painter->compositionMode();
 					if (sprite->colorEffect.alpha() < 255)
 					{
+						//Adds to whatever is already drawn underneath, so it has to be drawn straight to the scene
+						if (composite)
+							composite->cacheable = false;
+
 						painter->setOpacity(opacity * sprite->colorEffect.alphaF());
 						painter->setCompositionMode(QPainter::CompositionMode::CompositionMode_Plus);
 					}
@@ -250,7 +343,7 @@ namespace TilesEditor
 					auto child = m_ani->getAniSprite(this, childIndex, "");
 					if (child)
 					{
-						drawSprite(child, x + int(offsets.x()), y + int(offsets.y()), resourceManager, painter, level + 1);
+						drawSprite(child, x + int(offsets.x()), y + int(offsets.y()), resourceManager, painter, level + 1, composite);
 					}
 				}
 			}
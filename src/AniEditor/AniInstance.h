@@ -23,6 +23,10 @@ namespace TilesEditor
 		QMap<QString, QPair<QString, Image*>> m_aniProperties;
 		QRgb m_bodyColours[5];
 
+		QByteArray getCompositeKey(size_t frameIndex, int dir) const;
+		Ani::CompositeFrame* getCompositeFrame(Ani::Frame* frame, size_t frameIndex, int dir, AbstractResourceManager* resourceManager, QPainter* painter);
+		void drawPieces(Ani::Frame* frame, int dir, double x, double y, AbstractResourceManager* resourceManager, QPainter* painter, Ani::CompositeFrame* composite);
+
 	public:
 		AniInstance();
 		void freeResources(AbstractResourceManager* resourceManager);
@@ -42,8 +46,11 @@ namespace TilesEditor
 		void setBodyColour(int index, QRgb colour) { m_bodyColours[index] = colour; }
 
 		void applyBodyColours(Image* image);
+		//Frames are drawn once with all their sprites and kept by the ani, so drawing a frame drawn before is a single blit
 		void draw(int dir, double x, double y, AbstractResourceManager* resourceManager, QPainter* painter);
-		void drawSprite(Ani::AniSprite* sprite, double x, double y, AbstractResourceManager* resourceManager, QPainter* painter, int level = 0);
+
+		//Images drawn are added to composite, if given
+		void drawSprite(Ani::AniSprite* sprite, double x, double y, AbstractResourceManager* resourceManager, QPainter* painter, int level = 0, Ani::CompositeFrame* composite = nullptr);
 
 		
 	};
@@ -0,0 +1,1410 @@
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include <QStack>
+#include <QPair>
+#include <QSet>
+#include <QApplication>
+#include <QSettings>
+#include <QTemporaryDir>
+#include <QDir>
+#include <QFile>
+#include <QBuffer>
+#include <QDirIterator>
+#include <QImage>
+#include <QPainter>
+#include <QPaintEngine>
+#include <QPaintDevice>
+#include <QtMath>
+#include <algorithm>
+#include <cstdlib>
+#include <climits>
+#include <cmath>
+#include "Benchmarks.h"
+#include "Tilemap.h"
+#include "TileFloodFill.h"
+#include "MainWindow.h"
+#include "EditorTabWidget.h"
+#include "EntitySpatialGrid.h"
+#include "FlatEntitySpatialGrid.h"
+#include "TileBlitter.h"
+#include "Image.h"
+#include "LevelFormatNW.h"
+#include "LevelFormatGraal.h"
+#include "LevelSnapshotCache.h"
+#include "FileNameIndex.h"
+#include "ResourceManagerFileSystem.h"
+#include "FrameProfiler.h"
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace TilesEditor
+{
+	int Benchmarks::run(const QStringList& args)
+	{
+		auto name = args.value(0);
+
+		QMap<QString, QString> options;
+		for (auto i = 1; i + 1 < args.size(); i += 2)
+		{
+			if (args[i].startsWith('-'))
+				options[args[i].mid(1)] = args[i + 1];
+		}
+
+		auto output = cJSON_CreateObject();
+		cJSON_AddStringToObject(output, "benchmark", name.toLocal8Bit().data());
+
+		int retval = 1;
+		if (name == "floodfill")
+			retval = floodFill(options, output);
+		else if (name == "render")
+			retval = render(options, output);
+		else if (name == "spatialgrid")
+			retval = spatialGrid(options, output);
+		else if (name == "tileblit")
+			retval = tileBlit(options, output);
+		else if (name == "snapshot")
+			retval = snapshot(options, output);
+		else if (name == "nwparse")
+			retval = nwParse(options, output);
+		else if (name == "graalparse")
+			retval = graalParse(options, output);
+		else if (name == "fileindex")
+			retval = fileIndex(options, output);
+		else cJSON_AddStringToObject(output, "error", "unknown benchmark");
+
+		auto text = cJSON_Print(output);
+		QTextStream(stdout) << text << Qt::endl;
+		free(text);
+		cJSON_Delete(output);
+
+		return retval;
+	}
+
+	void Benchmarks::addTimings(cJSON* output, const char* name, const QList<double>& timings)
+	{
+		auto sorted = timings;
+		std::sort(sorted.begin(), sorted.end());
+
+		double total = 0.0;
+		for (auto value : sorted)
+			total += value;
+
+		auto percentile = [&](double p) -> double {
+			if (sorted.isEmpty())
+				return 0.0;
+			return sorted[qMin(sorted.size() - 1, qsizetype(p * sorted.size()))];
+		};
+
+		auto jsonTimings = cJSON_CreateObject();
+		cJSON_AddNumberToObject(jsonTimings, "count", sorted.size());
+		cJSON_AddNumberToObject(jsonTimings, "meanMs", sorted.isEmpty() ? 0.0 : total / sorted.size());
+		cJSON_AddNumberToObject(jsonTimings, "minMs", sorted.isEmpty() ? 0.0 : sorted.first());
+		cJSON_AddNumberToObject(jsonTimings, "p50Ms", percentile(0.50));
+		cJSON_AddNumberToObject(jsonTimings, "p90Ms", percentile(0.90));
+		cJSON_AddNumberToObject(jsonTimings, "p99Ms", percentile(0.99));
+		cJSON_AddNumberToObject(jsonTimings, "maxMs", sorted.isEmpty() ? 0.0 : sorted.last());
+		cJSON_AddItemToObject(output, name, jsonTimings);
+	}
+
+	int Benchmarks::tileBlit(const QMap<QString, QString>& options, cJSON* output)
+	{
+		auto levelSize = options.value("levelsize", "64").toInt();
+		auto iterations = options.value("iterations", "20").toInt();
+		auto translucentPercent = options.value("translucent", "10").toInt();
+
+		if (levelSize <= 0 || iterations <= 0)
+			return 1;
+
+		//Random tileset with some see-through pixels
+		QRandomGenerator random(1234);
+		QImage tilesetImage(2048, 512, QImage::Format_ARGB32_Premultiplied);
+		for (auto y = 0; y < tilesetImage.height(); ++y)
+		{
+			auto line = reinterpret_cast<QRgb*>(tilesetImage.scanLine(y));
+			for (auto x = 0; x < tilesetImage.width(); ++x)
+				line[x] = random.bounded(8) == 0 ? 0 : qPremultiply(qRgba(random.bounded(256), random.bounded(256), random.bounded(256), 255));
+		}
+		Image tileset("benchmark", tilesetImage);
+
+		Tilemap tilemap(nullptr, 0.0, 0.0, levelSize, levelSize, 0);
+		for (auto y = 0; y < levelSize; ++y)
+		{
+			for (auto x = 0; x < levelSize; ++x)
+			{
+				auto translucency = int(random.bounded(100)) < translucentPercent ? 1 + random.bounded(15) : 0;
+				tilemap.setTile(x, y, Tilemap::MakeTile(random.bounded(128), random.bounded(32), 0, translucency));
+			}
+		}
+
+		QImage painterOutput(levelSize * 16, levelSize * 16, QImage::Format_ARGB32_Premultiplied);
+		QImage blitterOutput(levelSize * 16, levelSize * 16, QImage::Format_ARGB32_Premultiplied);
+
+		//The per-tile drawPixmap path Level used to render chunks with
+		QList<double> painterTimings;
+		for (auto i = 0; i < iterations; ++i)
+		{
+			QElapsedTimer timer;
+			timer.start();
+
+			painterOutput.fill(Qt::transparent);
+			QPainter painter(&painterOutput);
+
+			int currentTranslucency = 0;
+			for (auto y = 0; y < levelSize; ++y)
+			{
+				for (auto x = 0; x < levelSize; ++x)
+				{
+					auto tile = tilemap.getTile(x, y);
+					auto translucency = Tilemap::GetTileTranslucency(tile);
+					if (translucency != currentTranslucency)
+					{
+						currentTranslucency = translucency;
+						painter.setOpacity(translucency != 15 ? 1.0 - (translucency / 15.0) : 0.05);
+					}
+					painter.drawPixmap(QPoint(x * 16, y * 16), tileset.pixmap(), QRect(Tilemap::GetTileX(tile) * 16, Tilemap::GetTileY(tile) * 16, 16, 16));
+				}
+			}
+			painter.end();
+
+			painterTimings.push_back(timer.nsecsElapsed() / 1000000.0);
+		}
+
+		QList<double> blitterTimings;
+		for (auto i = 0; i < iterations; ++i)
+		{
+			QElapsedTimer timer;
+			timer.start();
+
+			blitterOutput.fill(Qt::transparent);
+			TileBlitter blitter(&blitterOutput);
+
+			auto& source = tileset.premultipliedImage();
+			for (auto y = 0; y < levelSize; ++y)
+			{
+				for (auto x = 0; x < levelSize; ++x)
+				{
+					auto tile = tilemap.getTile(x, y);
+					blitter.drawTile(x * 16, y * 16, source, Tilemap::GetTileX(tile) * 16, Tilemap::GetTileY(tile) * 16, Tilemap::GetTileTranslucency(tile));
+				}
+			}
+
+			blitterTimings.push_back(timer.nsecsElapsed() / 1000000.0);
+		}
+
+		//QPainter rounds opacity slightly differently, so compare with a small tolerance
+		int maxDifference = 0;
+		for (auto y = 0; y < painterOutput.height(); ++y)
+		{
+			auto a = reinterpret_cast<const uchar*>(painterOutput.constScanLine(y));
+			auto b = reinterpret_cast<const uchar*>(blitterOutput.constScanLine(y));
+			for (auto x = 0; x < painterOutput.width() * 4; ++x)
+				maxDifference = qMax(maxDifference, qAbs(int(a[x]) - int(b[x])));
+		}
+
+		cJSON_AddNumberToObject(output, "levelSize", levelSize);
+		cJSON_AddNumberToObject(output, "iterations", iterations);
+		cJSON_AddNumberToObject(output, "translucentPercent", translucentPercent);
+		cJSON_AddNumberToObject(output, "maxChannelDifference", maxDifference);
+		addTimings(output, "painter", painterTimings);
+		addTimings(output, "blitter", blitterTimings);
+		return 0;
+	}
+
+	//Plain box for the spatial grid benchmark
+	class BenchmarkGridItem :
+		public AbstractSpatialGridItem
+	{
+		template <typename T>
+		friend class EntitySpatialGrid;
+
+		template <typename T>
+		friend class FlatEntitySpatialGrid;
+
+	public:
+		BenchmarkGridItem(double x, double y, int width, int height) {
+			setX(x);
+			setY(y);
+			setWidth(width);
+			setHeight(height);
+		}
+	};
+
+	//Time inserting, moving and searching items in grid. Returns the total number of search results
+	static qint64 benchmarkSpatialGrid(IEntitySpatialMap<BenchmarkGridItem>* grid, const QVector<BenchmarkGridItem*>& items, const QVector<QPointF>& moves, const QVector<QRectF>& searches,
+		QList<double>& insertTimings, QList<double>& updateTimings, QList<double>& searchTimings)
+	{
+		QElapsedTimer timer;
+		timer.start();
+		for (auto item : items)
+			grid->add(item);
+		insertTimings.push_back(timer.nsecsElapsed() / 1000000.0);
+
+		timer.restart();
+		for (auto i = 0; i < items.size(); ++i)
+		{
+			items[i]->setX(items[i]->getX() + moves[i].x());
+			items[i]->setY(items[i]->getY() + moves[i].y());
+			grid->updateEntity(items[i]);
+		}
+		updateTimings.push_back(timer.nsecsElapsed() / 1000000.0);
+
+		qint64 results = 0;
+		timer.restart();
+		for (auto& rect : searches)
+		{
+			QList<BenchmarkGridItem*> output;
+			results += grid->search(rect, true, output);
+		}
+		searchTimings.push_back(timer.nsecsElapsed() / 1000000.0);
+
+		//Put everything back for the next run
+		for (auto i = 0; i < items.size(); ++i)
+		{
+			grid->remove(items[i]);
+			items[i]->setX(items[i]->getX() - moves[i].x());
+			items[i]->setY(items[i]->getY() - moves[i].y());
+		}
+		return results;
+	}
+
+	int Benchmarks::spatialGrid(const QMap<QString, QString>& options, cJSON* output)
+	{
+		auto itemCount = options.value("items", "50000").toInt();
+		auto worldSize = options.value("worldsize", "16384").toInt();
+		auto searchCount = options.value("searches", "2000").toInt();
+		auto iterations = options.value("iterations", "5").toInt();
+
+		if (itemCount <= 0 || worldSize <= 0 || searchCount <= 0 || iterations <= 0)
+			return 1;
+
+		//Mostly npc sized items, with the odd big one that spans a few cells
+		QRandomGenerator random(1234);
+		QVector<BenchmarkGridItem*> items;
+		QVector<QPointF> moves;
+		for (auto i = 0; i < itemCount; ++i)
+		{
+			auto size = random.bounded(20) == 0 ? 512 : 32;
+			items.push_back(new BenchmarkGridItem(random.bounded(worldSize), random.bounded(worldSize), size, size));
+			moves.push_back(QPointF(random.bounded(64) - 32, random.bounded(64) - 32));
+		}
+
+		QVector<QRectF> searches;
+		for (auto i = 0; i < searchCount; ++i)
+			searches.push_back(QRectF(random.bounded(worldSize), random.bounded(worldSize), 1280, 720));
+
+		QList<double> gridInsert, gridUpdate, gridSearch;
+		QList<double> flatInsert, flatUpdate, flatSearch;
+		qint64 gridResults = 0, flatResults = 0;
+		for (auto i = 0; i < iterations; ++i)
+		{
+			EntitySpatialGrid<BenchmarkGridItem> grid(0.0, 0.0, worldSize, worldSize);
+			gridResults = benchmarkSpatialGrid(&grid, items, moves, searches, gridInsert, gridUpdate, gridSearch);
+
+			FlatEntitySpatialGrid<BenchmarkGridItem> flatGrid(0.0, 0.0, worldSize, worldSize);
+			flatResults = benchmarkSpatialGrid(&flatGrid, items, moves, searches, flatInsert, flatUpdate, flatSearch);
+		}
+
+		qDeleteAll(items);
+
+		cJSON_AddNumberToObject(output, "items", itemCount);
+		cJSON_AddNumberToObject(output, "worldSize", worldSize);
+		cJSON_AddNumberToObject(output, "searches", searchCount);
+		cJSON_AddNumberToObject(output, "iterations", iterations);
+		cJSON_AddNumberToObject(output, "searchResults", double(flatResults));
+		cJSON_AddBoolToObject(output, "matchesEntitySpatialGrid", gridResults == flatResults);
+		addTimings(output, "insertEntitySpatialGrid", gridInsert);
+		addTimings(output, "insertFlatEntitySpatialGrid", flatInsert);
+		addTimings(output, "updateEntitySpatialGrid", gridUpdate);
+		addTimings(output, "updateFlatEntitySpatialGrid", flatUpdate);
+		addTimings(output, "searchEntitySpatialGrid", gridSearch);
+		addTimings(output, "searchFlatEntitySpatialGrid", flatSearch);
+		return 0;
+	}
+
+	//Paint engine that draws nothing and counts the calls made to it
+	class DrawCallCounter :
+		public QPaintEngine
+	{
+	public:
+		int drawCalls = 0;
+
+		DrawCallCounter() : QPaintEngine(QPaintEngine::AllFeatures) {}
+
+		bool begin(QPaintDevice* device) override { return true; }
+		bool end() override { return true; }
+		void updateState(const QPaintEngineState& state) override {}
+		Type type() const override { return QPaintEngine::User; }
+
+		void drawPixmap(const QRectF& r, const QPixmap& pm, const QRectF& sr) override { ++drawCalls; }
+		void drawImage(const QRectF& r, const QImage& pm, const QRectF& sr, Qt::ImageConversionFlags flags) override { ++drawCalls; }
+		void drawTiledPixmap(const QRectF& r, const QPixmap& pixmap, const QPointF& s) override { ++drawCalls; }
+		void drawRects(const QRect* rects, int rectCount) override { ++drawCalls; }
+		void drawRects(const QRectF* rects, int rectCount) override { ++drawCalls; }
+		void drawLines(const QLine* lines, int lineCount) override { ++drawCalls; }
+		void drawLines(const QLineF* lines, int lineCount) override { ++drawCalls; }
+		void drawEllipse(const QRectF& r) override { ++drawCalls; }
+		void drawEllipse(const QRect& r) override { ++drawCalls; }
+		void drawPath(const QPainterPath& path) override { ++drawCalls; }
+		void drawPoints(const QPointF* points, int pointCount) override { ++drawCalls; }
+		void drawPoints(const QPoint* points, int pointCount) override { ++drawCalls; }
+		void drawPolygon(const QPointF* points, int pointCount, PolygonDrawMode mode) override { ++drawCalls; }
+		void drawPolygon(const QPoint* points, int pointCount, PolygonDrawMode mode) override { ++drawCalls; }
+		void drawTextItem(const QPointF& p, const QTextItem& textItem) override { ++drawCalls; }
+	};
+
+	class DrawCallCounterDevice :
+		public QPaintDevice
+	{
+	private:
+		mutable DrawCallCounter m_engine;
+		int m_width;
+		int m_height;
+
+	public:
+		DrawCallCounterDevice(int width, int height) : m_width(width), m_height(height) {}
+
+		int getDrawCalls() const { return m_engine.drawCalls; }
+		void reset() { m_engine.drawCalls = 0; }
+
+		QPaintEngine* paintEngine() const override { return &m_engine; }
+
+		int metric(PaintDeviceMetric metric) const override
+		{
+			switch (metric) {
+				case PdmWidth: return m_width;
+				case PdmHeight: return m_height;
+				case PdmWidthMM: return m_width * 254 / 960;
+				case PdmHeightMM: return m_height * 254 / 960;
+				case PdmNumColors: return INT_MAX;
+				case PdmDepth: return 32;
+				case PdmDpiX:
+				case PdmDpiY:
+				case PdmPhysicalDpiX:
+				case PdmPhysicalDpiY: return 96;
+				case PdmDevicePixelRatio: return 1;
+				case PdmDevicePixelRatioScaled: return int(QPaintDevice::devicePixelRatioFScale());
+				default: return 0;
+			}
+		}
+	};
+
+	qint64 Benchmarks::getPeakMemoryUsage()
+	{
+#ifdef Q_OS_WIN
+		PROCESS_MEMORY_COUNTERS counters;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return qint64(counters.PeakWorkingSetSize);
+		return -1;
+#else
+		struct rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+			return -1;
+
+	#ifdef Q_OS_MACOS
+		return qint64(usage.ru_maxrss);
+	#else
+		//Linux reports kilobytes
+		return qint64(usage.ru_maxrss) * 1024;
+	#endif
+#endif
+	}
+
+	int Benchmarks::snapshot(const QMap<QString, QString>& options, cJSON* output)
+	{
+		auto iterations = options.value("iterations", "5").toInt();
+		auto generate = options.value("generate", "16x16").split('x');
+		auto worldWidth = qMax(generate.value(0).toInt(), 1);
+		auto worldHeight = qMax(generate.value(1, generate.value(0)).toInt(), 1);
+
+		if (iterations <= 0)
+			return 1;
+
+		QTemporaryDir tempDir;
+		if (!tempDir.isValid() || generateWorld(tempDir.path(), worldWidth, worldHeight, options.value("layers", "2").toInt(), options.value("npcs", "4").toInt()).isEmpty())
+			return 1;
+
+		QStringList fileNames;
+		for (auto& name : QDir(tempDir.path()).entryList(QStringList("*.nw"), QDir::Files))
+			fileNames.push_back(QDir(tempDir.path()).filePath(name));
+
+		auto snapshots = LevelSnapshotCache::instance();
+		snapshots->setDirectory(QDir(tempDir.path()).filePath("snapshots"));
+		auto tilesetHash = LevelSnapshotCache::getTilesetHash(nullptr);
+
+		LevelFormatNW format;
+
+		//Just reading the files, which is as fast as loading can get
+		QList<double> readTimings;
+		qint64 bytes = 0;
+		for (auto i = 0; i < iterations; ++i)
+		{
+			QElapsedTimer timer;
+			timer.start();
+
+			bytes = 0;
+			for (auto& fileName : fileNames)
+			{
+				QFile file(fileName);
+				if (file.open(QIODevice::ReadOnly))
+					bytes += file.readAll().size();
+			}
+			readTimings.push_back(timer.nsecsElapsed() / 1000000.0);
+		}
+
+		//Reading and parsing every level. The last pass saves the snapshots
+		QList<double> parseTimings;
+		QVector<LevelModel> parsed(fileNames.size());
+		for (auto i = 0; i < iterations; ++i)
+		{
+			QElapsedTimer timer;
+			timer.start();
+
+			for (auto j = 0; j < fileNames.size(); ++j)
+			{
+				QFile file(fileNames[j]);
+				if (!file.open(QIODevice::ReadOnly))
+					return 1;
+
+				parsed[j] = LevelModel();
+				if (!format.parseLevel(&parsed[j], nullptr, &file))
+					return 1;
+			}
+			parseTimings.push_back(timer.nsecsElapsed() / 1000000.0);
+		}
+
+		for (auto j = 0; j < fileNames.size(); ++j)
+		{
+			QFile file(fileNames[j]);
+			if (file.open(QIODevice::ReadOnly))
+				snapshots->save(fileNames[j], tilesetHash, file.readAll(), parsed[j]);
+		}
+
+		//Loading every level from its snapshot, checking it matches what was parsed
+		QList<double> snapshotTimings;
+		auto mismatches = 0;
+		for (auto i = 0; i < iterations; ++i)
+		{
+			QElapsedTimer timer;
+			timer.start();
+
+			for (auto j = 0; j < fileNames.size(); ++j)
+			{
+				LevelModel model;
+				if (!snapshots->load(fileNames[j], tilesetHash, &model))
+					return 1;
+
+				if (i == 0)
+				{
+					auto same = model.tileLayers.keys() == parsed[j].tileLayers.keys() && model.links.size() == parsed[j].links.size() &&
+						model.signs.size() == parsed[j].signs.size() && model.npcs.size() == parsed[j].npcs.size();
+
+					for (auto it = model.tileLayers.begin(); same && it != model.tileLayers.end(); ++it)
+						same = it->tiles == parsed[j].tileLayers[it.key()].tiles;
+
+					for (auto k = 0; same && k < model.npcs.size(); ++k)
+						same = model.npcs[k].code == parsed[j].npcs[k].code && model.npcs[k].x == parsed[j].npcs[k].x && model.npcs[k].y == parsed[j].npcs[k].y;
+
+					if (!same)
+						++mismatches;
+				}
+			}
+			snapshotTimings.push_back(timer.nsecsElapsed() / 1000000.0);
+		}
+
+		snapshots->setDirectory("");
+
+		cJSON_AddNumberToObject(output, "levels", fileNames.size());
+		cJSON_AddNumberToObject(output, "bytes", double(bytes));
+		cJSON_AddNumberToObject(output, "iterations", iterations);
+		cJSON_AddNumberToObject(output, "mismatches", mismatches);
+		addTimings(output, "read", readTimings);
+		addTimings(output, "parse", parseTimings);
+		addTimings(output, "snapshot", snapshotTimings);
+		return mismatches == 0 ? 0 : 1;
+	}
+
+	int Benchmarks::nwParse(const QMap<QString, QString>& options, cJSON* output)
+	{
+		auto iterations = options.value("iterations", "10").toInt();
+		auto generate = options.value("generate", "16x16").split('x');
+		auto worldWidth = qMax(generate.value(0).toInt(), 1);
+		auto worldHeight = qMax(generate.value(1, generate.value(0)).toInt(), 1);
+
+		if (iterations <= 0)
+			return 1;
+
+		QTemporaryDir tempDir;
+		if (!tempDir.isValid() || generateWorld(tempDir.path(), worldWidth, worldHeight, options.value("layers", "2").toInt(), options.value("npcs", "4").toInt()).isEmpty())
+			return 1;
+
+		//The whole corpus is read up front so only parsing is timed
+		QList<QByteArray> files;
+		qint64 bytes = 0;
+		for (auto& name : QDir(tempDir.path()).entryList(QStringList("*.nw"), QDir::Files))
+		{
+			QFile file(QDir(tempDir.path()).filePath(name));
+			if (!file.open(QIODevice::ReadOnly))
+				return 1;
+
+			files.push_back(file.readAll());
+			bytes += files.last().size();
+		}
+
+		LevelFormatNW format;
+
+		QList<double> timings;
+		qint64 tiles = 0;
+		for (auto i = 0; i < iterations; ++i)
+		{
+			QElapsedTimer timer;
+			timer.start();
+
+			tiles = 0;
+			for (auto& fileData : files)
+			{
+				QBuffer buffer(&fileData);
+				buffer.open(QIODevice::ReadOnly);
+
+				LevelModel model;
+				if (!format.parseLevel(&model, nullptr, &buffer))
+					return 1;
+
+				for (auto& tileLayer : model.tileLayers)
+					tiles += tileLayer.tiles.size();
+			}
+			timings.push_back(timer.nsecsElapsed() / 1000000.0);
+		}
+
+		auto sorted = timings;
+		std::sort(sorted.begin(), sorted.end());
+		auto medianSeconds = qMax(sorted[sorted.size() / 2], 0.001) / 1000.0;
+
+		cJSON_AddNumberToObject(output, "levels", files.size());
+		cJSON_AddNumberToObject(output, "bytes", double(bytes));
+		cJSON_AddNumberToObject(output, "tiles", double(tiles));
+		cJSON_AddNumberToObject(output, "iterations", iterations);
+		cJSON_AddNumberToObject(output, "megabytesPerSecond", bytes / (1024.0 * 1024.0) / medianSeconds);
+		cJSON_AddNumberToObject(output, "levelsPerSecond", files.size() / medianSeconds);
+		addTimings(output, "parse", timings);
+		return 0;
+	}
+
+	QByteArray Benchmarks::generateGraalLevel(QRandomGenerator& random, LevelModel* expected)
+	{
+		QByteArray retval;
+
+		//Old levels have one layer of 12 bit codes, newer ones up to 3 layers of 13 bit codes
+		auto version = random.bounded(3);
+		auto layers = 1;
+		auto bits = 13;
+		if (version == 0)
+		{
+			retval.append("GR-V1.01");
+			bits = 12;
+		}
+		else if (version == 1)
+			retval.append("GR-V1.03");
+		else {
+			retval.append("GR-V1.05");
+			layers = 1 + random.bounded(3);
+			retval.append(char(32 + layers));
+		}
+
+		auto controlBit = bits == 12 ? 0x800 : 0x1000;
+		//0xFFF (no tile) would be a control code in 12 bit levels
+		auto randomTile = [&]() { return random.bounded(8) == 0 && bits == 13 ? 0xFFF : int(random.bounded(0x800)); };
+		auto convertTile = [](int code) { return code == 0xFFF ? Tilemap::MakeInvisibleTile(0) : Level::convertFromGraalTile(code, nullptr); };
+
+		for (auto layer = 0; layer < layers; ++layer)
+		{
+			quint32 buffer = 0;
+			auto bitCount = 0;
+			auto writeCode = [&](int code) {
+				buffer |= quint32(code) << bitCount;
+				bitCount += bits;
+				while (bitCount >= 8)
+				{
+					retval.append(char(buffer & 0xFF));
+					buffer >>= 8;
+					bitCount -= 8;
+				}
+			};
+
+			auto& tileLayer = expected->getOrMakeTileLayer(layer);
+			auto board = tileLayer.tiles.data();
+
+			//Single tiles, runs of one tile and runs of a pair of tiles
+			auto boardIndex = 0;
+			while (boardIndex < 64 * 64)
+			{
+				auto mode = random.bounded(4);
+				auto count = 2 + random.bounded(30);
+				if (mode == 0 && boardIndex + count <= 64 * 64)
+				{
+					auto tile = randomTile();
+					writeCode(controlBit | count);
+					writeCode(tile);
+
+					for (auto i = 0; i < count; ++i)
+						board[boardIndex++] = convertTile(tile);
+				}
+				else if (mode == 1 && boardIndex + count * 2 <= 64 * 64)
+				{
+					auto tile0 = randomTile();
+					auto tile1 = randomTile();
+					writeCode(controlBit | 0x100 | count);
+					writeCode(tile0);
+					writeCode(tile1);
+
+					for (auto i = 0; i < count; ++i)
+					{
+						board[boardIndex++] = convertTile(tile0);
+						board[boardIndex++] = convertTile(tile1);
+					}
+				}
+				else {
+					auto tile = randomTile();
+					writeCode(tile);
+					board[boardIndex++] = convertTile(tile);
+				}
+			}
+
+			if (bitCount > 0)
+				retval.append(char(buffer & 0xFF));
+		}
+
+		for (auto i = random.bounded(6); i > 0; --i)
+		{
+			auto nextLevel = QString("level%1.graal").arg(random.bounded(100));
+			auto x = random.bounded(64);
+			auto y = random.bounded(64);
+			auto width = 1 + random.bounded(4);
+			auto height = 1 + random.bounded(4);
+			auto nextX = QString::number(random.bounded(64));
+
+			retval.append(QString("%1 %2 %3 %4 %5 %6 playery\n").arg(nextLevel).arg(x).arg(y).arg(width).arg(height).arg(nextX).toLatin1());
+			expected->links.push_back(LevelModel::Link{ x * 16.0, y * 16.0, width * 16, height * 16, false, nextLevel, nextX, "playery", 0, 0 });
+		}
+		retval.append("#\n");
+
+		for (auto i = random.bounded(4); i > 0; --i)
+		{
+			auto x = random.bounded(64);
+			auto y = random.bounded(64);
+			auto type = random.bounded(10);
+
+			retval.append(char(x));
+			retval.append(char(y));
+			retval.append(char(type));
+			retval.append("Hello\\Ouch\\Goodbye\\\n");
+			expected->baddies.push_back(LevelModel::Baddy{ x * 16.0, y * 16.0, type, 0, QStringList({ "Hello", "Ouch", "Goodbye", "" }) });
+		}
+		retval.append("\xFF\xFF\xFF\n", 4);
+
+		for (auto i = random.bounded(8); i > 0; --i)
+		{
+			auto x = random.bounded(64);
+			auto y = random.bounded(64);
+
+			retval.append(char(32 + x));
+			retval.append(char(32 + y));
+			retval.append("npc.png#if (created) {\xA7  setshape 1,32,32;\xA7}\xA7\n");
+			expected->npcs.push_back(LevelModel::NPC{ "npc.png", x * 16.0, y * 16.0, "if (created) {\n  setshape 1,32,32;\n}\n" });
+		}
+		retval.append("#\n");
+
+		//Item names aren't checked, so the chest is only matched by position and sign
+		for (auto i = random.bounded(4); i > 0; --i)
+		{
+			auto x = random.bounded(64);
+			auto y = random.bounded(64);
+			auto item = random.bounded(25);
+			auto signIndex = random.bounded(4);
+
+			retval.append(char(32 + x));
+			retval.append(char(32 + y));
+			retval.append(char(32 + item));
+			retval.append(char(32 + signIndex));
+			retval.append("\n");
+			expected->chests.push_back(LevelModel::Chest{ x * 16.0, y * 16.0, QString(), signIndex, 0 });
+		}
+		retval.append("#\n");
+
+		//Sign text is encoded, so signs are only matched by position
+		for (auto i = random.bounded(4); i > 0; --i)
+		{
+			auto x = random.bounded(64);
+			auto y = random.bounded(64);
+
+			retval.append(char(32 + x));
+			retval.append(char(32 + y));
+			for (auto j = 20 + random.bounded(60); j > 0; --j)
+				retval.append(char(32 + random.bounded(70)));
+			retval.append("\n");
+			expected->signs.push_back(LevelModel::Sign{ x * 16.0, y * 16.0, 0, QString() });
+		}
+		return retval;
+	}
+
+	//Whether model has the tiles and entities generateGraalLevel wrote
+	static bool matchesGraalLevel(const LevelModel& expected, const LevelModel& model)
+	{
+		if (expected.tileLayers.keys() != model.tileLayers.keys() || expected.links.size() != model.links.size() ||
+			expected.baddies.size() != model.baddies.size() || expected.npcs.size() != model.npcs.size() ||
+			expected.chests.size() != model.chests.size() || expected.signs.size() != model.signs.size())
+			return false;
+
+		for (auto it = expected.tileLayers.cbegin(); it != expected.tileLayers.cend(); ++it)
+		{
+			if (it->tiles != model.tileLayers[it.key()].tiles)
+				return false;
+		}
+
+		for (auto i = 0; i < expected.links.size(); ++i)
+		{
+			auto& a = expected.links[i];
+			auto& b = model.links[i];
+			if (a.x != b.x || a.y != b.y || a.width != b.width || a.height != b.height || a.nextLevel != b.nextLevel || a.nextX != b.nextX || a.nextY != b.nextY)
+				return false;
+		}
+
+		for (auto i = 0; i < expected.baddies.size(); ++i)
+		{
+			auto& a = expected.baddies[i];
+			auto& b = model.baddies[i];
+			if (a.x != b.x || a.y != b.y || a.type != b.type || a.verses != b.verses)
+				return false;
+		}
+
+		for (auto i = 0; i < expected.npcs.size(); ++i)
+		{
+			auto& a = expected.npcs[i];
+			auto& b = model.npcs[i];
+			if (a.image != b.image || a.x != b.x || a.y != b.y || a.code != b.code)
+				return false;
+		}
+
+		for (auto i = 0; i < expected.chests.size(); ++i)
+		{
+			auto& a = expected.chests[i];
+			auto& b = model.chests[i];
+			if (a.x != b.x || a.y != b.y || a.signIndex != b.signIndex)
+				return false;
+		}
+
+		for (auto i = 0; i < expected.signs.size(); ++i)
+		{
+			if (expected.signs[i].x != model.signs[i].x || expected.signs[i].y != model.signs[i].y)
+				return false;
+		}
+		return true;
+	}
+
+	int Benchmarks::graalParse(const QMap<QString, QString>& options, cJSON* output)
+	{
+		auto levelCount = options.value("levels", "500").toInt();
+		auto iterations = options.value("iterations", "10").toInt();
+
+		if (levelCount <= 0 || iterations <= 0)
+			return 1;
+
+		QRandomGenerator random(1234);
+		QList<QByteArray> files;
+		QVector<LevelModel> expected(levelCount);
+		qint64 bytes = 0;
+		for (auto i = 0; i < levelCount; ++i)
+		{
+			files.push_back(generateGraalLevel(random, &expected[i]));
+			bytes += files.last().size();
+		}
+
+		LevelFormatGraal format;
+
+		//Every level has to decode to exactly what was generated
+		auto failures = 0;
+		for (auto i = 0; i < files.size(); ++i)
+		{
+			QBuffer buffer(&files[i]);
+			buffer.open(QIODevice::ReadOnly);
+
+			LevelModel model;
+			if (!format.parseLevel(&model, nullptr, &buffer) || !matchesGraalLevel(expected[i], model))
+				++failures;
+		}
+
+		QList<double> timings;
+		for (auto i = 0; i < iterations; ++i)
+		{
+			QElapsedTimer timer;
+			timer.start();
+
+			for (auto& fileData : files)
+			{
+				QBuffer buffer(&fileData);
+				buffer.open(QIODevice::ReadOnly);
+
+				LevelModel model;
+				format.parseLevel(&model, nullptr, &buffer);
+			}
+			timings.push_back(timer.nsecsElapsed() / 1000000.0);
+		}
+
+		QList<double> sorted = timings;
+		std::sort(sorted.begin(), sorted.end());
+		auto medianSeconds = qMax(sorted[sorted.size() / 2], 0.001) / 1000.0;
+
+		cJSON_AddNumberToObject(output, "levels", files.size());
+		cJSON_AddNumberToObject(output, "bytes", double(bytes));
+		cJSON_AddNumberToObject(output, "iterations", iterations);
+		cJSON_AddNumberToObject(output, "failures", failures);
+		cJSON_AddNumberToObject(output, "megabytesPerSecond", bytes / (1024.0 * 1024.0) / medianSeconds);
+		addTimings(output, "parse", timings);
+		return failures == 0 ? 0 : 1;
+	}
+
+	QString Benchmarks::generateWorld(const QString& directory, int width, int height, int layers, int npcs)
+	{
+		static const char base64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+		QDir dir(directory);
+		QRandomGenerator random(1234);
+
+		//A graal sized tileset (128x32 tiles) of flat coloured tiles
+		QImage tileset(128 * 16, 32 * 16, QImage::Format_ARGB32);
+		QPainter tilesetPainter(&tileset);
+		for (auto y = 0; y < 32; ++y)
+		{
+			for (auto x = 0; x < 128; ++x)
+				tilesetPainter.fillRect(x * 16, y * 16, 16, 16, QColor::fromRgb(random.generate() | 0xFF000000));
+		}
+		tilesetPainter.end();
+		tileset.save(dir.filePath("benchtiles.png"));
+
+		auto gmapName = QString("bench_%1x%2.gmap").arg(width).arg(height);
+
+		QFile gmapFile(dir.filePath(gmapName));
+		if (!gmapFile.open(QIODevice::WriteOnly | QIODevice::Text))
+			return "";
+
+		QTextStream gmapStream(&gmapFile);
+		gmapStream << "GRMAP001" << Qt::endl;
+		gmapStream << "WIDTH " << width << Qt::endl;
+		gmapStream << "HEIGHT " << height << Qt::endl;
+		gmapStream << "TILESET benchtiles.png" << Qt::endl;
+		gmapStream << "LEVELNAMES" << Qt::endl;
+
+		for (auto levelY = 0; levelY < height; ++levelY)
+		{
+			for (auto levelX = 0; levelX < width; ++levelX)
+			{
+				auto levelName = QString("bench_%1_%2.nw").arg(levelX).arg(levelY);
+				gmapStream << "\"" << levelName << "\",";
+
+				QFile levelFile(dir.filePath(levelName));
+				if (!levelFile.open(QIODevice::WriteOnly | QIODevice::Text))
+					return "";
+
+				QTextStream levelStream(&levelFile);
+				levelStream << "GLEVNW01" << Qt::endl;
+
+				for (auto layer = 0; layer < layers; ++layer)
+				{
+					for (auto y = 0; y < 64; ++y)
+					{
+						//Layer 0 is solid, upper layers have a few short runs of tiles
+						auto left = 0;
+						auto count = 64;
+						if (layer > 0)
+						{
+							if (random.bounded(4) != 0)
+								continue;
+
+							left = random.bounded(48);
+							count = 1 + random.bounded(16);
+						}
+
+						levelStream << "BOARD " << left << " " << y << " " << count << " " << layer << " ";
+						for (auto x = 0; x < count; ++x)
+						{
+							auto graalTile = random.bounded(4096);
+							levelStream << base64[graalTile >> 6] << base64[graalTile & 0x3F];
+						}
+						levelStream << Qt::endl;
+					}
+				}
+
+				for (auto i = 0; i < npcs; ++i)
+					levelStream << "NPC - " << random.bounded(62) << " " << random.bounded(62) << Qt::endl << "NPCEND" << Qt::endl;
+			}
+			gmapStream << Qt::endl;
+		}
+
+		gmapStream << "LEVELNAMESEND" << Qt::endl;
+		return dir.filePath(gmapName);
+	}
+
+	int Benchmarks::render(const QMap<QString, QString>& options, cJSON* output)
+	{
+		auto app = qobject_cast<QApplication*>(QCoreApplication::instance());
+
+		auto frames = options.value("frames", "300").toInt();
+		auto viewWidth = options.value("width", "1280").toInt();
+		auto viewHeight = options.value("height", "720").toInt();
+		auto zoomMin = options.value("zoommin", "0.25").toDouble();
+		auto zoomMax = options.value("zoommax", "2").toDouble();
+		auto preload = options.value("preload", "1").toInt() != 0;
+
+		if (app == nullptr || frames <= 0 || viewWidth <= 0 || viewHeight <= 0 || zoomMin <= 0.0 || zoomMax <= 0.0)
+			return 1;
+
+		QTemporaryDir tempDir;
+		if (!tempDir.isValid())
+			return 1;
+
+		//Either an existing level/gmap/world, or a generated one
+		auto fileName = options.value("file");
+		if (fileName.isEmpty())
+		{
+			auto generate = options.value("generate", "16x16").split('x');
+			auto worldWidth = qMax(generate.value(0).toInt(), 1);
+			auto worldHeight = qMax(generate.value(1, generate.value(0)).toInt(), 1);
+
+			fileName = generateWorld(tempDir.path(), worldWidth, worldHeight, options.value("layers", "2").toInt(), options.value("npcs", "4").toInt());
+			if (fileName.isEmpty())
+				return 1;
+		}
+
+		QSettings settings(QDir(tempDir.path()).filePath("settings.ini"), QSettings::IniFormat);
+		settings.setValue("TilesEditor/WorkingDirectory", QFileInfo(fileName).absolutePath() + "/");
+		settings.setValue("levelSnapshots", false);
+
+		QElapsedTimer loadTimer;
+		loadTimer.start();
+
+		MainWindow window(*app, settings);
+		auto tab = window.openLevelFilename(fileName);
+		if (tab == nullptr)
+			return 1;
+
+		if (options.contains("tileset"))
+			tab->setTileset(options.value("tileset"));
+
+		QRectF worldRect;
+		int levelCount = 1;
+		if (tab->m_overworld)
+		{
+			worldRect = QRectF(0, 0, tab->m_overworld->getWidth(), tab->m_overworld->getHeight());
+			levelCount = tab->m_overworld->getLevelEntries().size();
+
+			if (preload)
+				tab->m_overworld->preloadLevels();
+		}
+		else if (tab->m_level)
+			worldRect = QRectF(0, 0, tab->m_level->getWidth(), tab->m_level->getHeight());
+
+		//Let any threaded level loads finish
+		auto waitForLoads = [&](int timeoutMs)
+		{
+			if (tab->m_overworld == nullptr)
+				return;
+
+			QElapsedTimer timer;
+			timer.start();
+			while (timer.elapsed() < timeoutMs)
+			{
+				bool loading = false;
+				for (auto level : tab->m_overworld->getLevelList())
+				{
+					if (level->getLoadState() == LoadState::STATE_LOADING)
+					{
+						loading = true;
+						break;
+					}
+				}
+
+				if (!loading)
+					break;
+				QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+			}
+		};
+
+		if (preload)
+			waitForLoads(options.value("loadtimeout", "120000").toInt());
+		auto loadMs = loadTimer.nsecsElapsed() / 1000000.0;
+
+		//Camera path: either "centerX centerY zoom" lines from a file or a lissajous curve over the world
+		struct Camera {
+			double x;
+			double y;
+			double zoom;
+		};
+
+		QVector<Camera> path;
+		if (options.contains("path"))
+		{
+			QFile pathFile(options.value("path"));
+			if (pathFile.open(QIODevice::ReadOnly | QIODevice::Text))
+			{
+				QTextStream pathStream(&pathFile);
+				for (QString line = pathStream.readLine(); !line.isNull(); line = pathStream.readLine())
+				{
+					auto words = line.split(' ', Qt::SkipEmptyParts);
+					if (words.size() >= 3)
+						path.push_back(Camera{ words[0].toDouble(), words[1].toDouble(), qMax(words[2].toDouble(), 0.01) });
+				}
+			}
+			frames = path.size();
+		}
+		else {
+			for (auto i = 0; i < frames; ++i)
+			{
+				auto t = double(i) / qMax(frames - 1, 1);
+				auto zoomT = 0.5 - 0.5 * std::cos(t * 2.0 * M_PI * 2.0);
+
+				path.push_back(Camera{
+					worldRect.center().x() + worldRect.width() * 0.45 * std::sin(t * 2.0 * M_PI),
+					worldRect.center().y() + worldRect.height() * 0.45 * std::sin(t * 4.0 * M_PI),
+					zoomMin * std::pow(zoomMax / zoomMin, zoomT) });
+			}
+		}
+
+		QImage frameImage(viewWidth, viewHeight, QImage::Format_ARGB32_Premultiplied);
+		DrawCallCounterDevice counterDevice(viewWidth, viewHeight);
+
+		auto renderFrame = [&](QPaintDevice* device, const Camera& camera)
+		{
+			QRectF viewRect(camera.x - viewWidth / camera.zoom / 2.0, camera.y - viewHeight / camera.zoom / 2.0, viewWidth / camera.zoom, viewHeight / camera.zoom);
+
+			//Same set up as GraphicsView::drawBackground
+			QPainter painter(device);
+			painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
+			painter.setRenderHint(QPainter::VerticalSubpixelPositioning, 1);
+			painter.scale(camera.zoom, camera.zoom);
+			painter.translate(-viewRect.x(), -viewRect.y());
+
+			tab->renderScene(&painter, viewRect);
+		};
+
+		//Timed frames can be saved as a Chrome trace too (with the profiler overlay drawn in them)
+		auto tracePath = options.value("trace");
+		FrameProfiler::instance()->clear();
+
+		QList<double> frameTimings;
+		QList<double> drawCalls;
+		for (auto& camera : path)
+		{
+			QElapsedTimer timer;
+			timer.start();
+
+			FrameProfiler::instance()->setEnabled(!tracePath.isEmpty());
+			renderFrame(&frameImage, camera);
+			frameTimings.push_back(timer.nsecsElapsed() / 1000000.0);
+			FrameProfiler::instance()->setEnabled(false);
+
+			//Replay the frame (now with warm caches) to count the draw calls it makes
+			counterDevice.reset();
+			renderFrame(&counterDevice, camera);
+			drawCalls.push_back(counterDevice.getDrawCalls());
+
+			//Levels that started loading during the frame finish between frames
+			QCoreApplication::processEvents();
+		}
+
+		cJSON_AddStringToObject(output, "file", QFileInfo(fileName).fileName().toLocal8Bit().data());
+		cJSON_AddNumberToObject(output, "levels", levelCount);
+		cJSON_AddNumberToObject(output, "frames", frames);
+		cJSON_AddNumberToObject(output, "width", viewWidth);
+		cJSON_AddNumberToObject(output, "height", viewHeight);
+		cJSON_AddBoolToObject(output, "preload", preload);
+		cJSON_AddNumberToObject(output, "loadMs", loadMs);
+		addTimings(output, "frame", frameTimings);
+
+		std::sort(drawCalls.begin(), drawCalls.end());
+		double totalDrawCalls = 0.0;
+		for (auto value : drawCalls)
+			totalDrawCalls += value;
+
+		auto jsonDrawCalls = cJSON_CreateObject();
+		cJSON_AddNumberToObject(jsonDrawCalls, "mean", drawCalls.isEmpty() ? 0.0 : totalDrawCalls / drawCalls.size());
+		cJSON_AddNumberToObject(jsonDrawCalls, "min", drawCalls.isEmpty() ? 0.0 : drawCalls.first());
+		cJSON_AddNumberToObject(jsonDrawCalls, "max", drawCalls.isEmpty() ? 0.0 : drawCalls.last());
+		cJSON_AddItemToObject(output, "drawCalls", jsonDrawCalls);
+
+		cJSON_AddNumberToObject(output, "peakRssBytes", double(getPeakMemoryUsage()));
+
+		if (!tracePath.isEmpty())
+			cJSON_AddBoolToObject(output, "traceSaved", FrameProfiler::instance()->saveTrace(tracePath));
+
+		//Resources freed by levels going out of view and loaded again when they come back
+		auto retention = tab->getResourceManager()->getRetentionStats();
+		auto jsonRetention = cJSON_CreateObject();
+		cJSON_AddNumberToObject(jsonRetention, "hits", double(retention.hits));
+		cJSON_AddNumberToObject(jsonRetention, "misses", double(retention.misses));
+		cJSON_AddNumberToObject(jsonRetention, "evictions", double(retention.evictions));
+		cJSON_AddNumberToObject(jsonRetention, "retained", retention.count);
+		cJSON_AddNumberToObject(jsonRetention, "retainedBytes", double(retention.bytes));
+		cJSON_AddItemToObject(output, "resourceRetention", jsonRetention);
+		return 0;
+	}
+
+	int Benchmarks::floodFill(const QMap<QString, QString>& options, cJSON* output)
+	{
+		auto levelCount = options.value("levels", "20").toInt();
+		auto levelSize = options.value("levelsize", "64").toInt();
+		auto iterations = options.value("iterations", "5").toInt();
+		auto wallPercent = options.value("walls", "10").toInt();
+
+		if (levelCount <= 0 || levelSize <= 0 || iterations <= 0)
+			return 1;
+
+		//Synthetic overworld: levelCount x levelCount levels of grass with scattered walls
+		auto grassTile = Tilemap::MakeTile(0, 0, 0);
+		auto wallTile = Tilemap::MakeTile(1, 0, 0);
+
+		QRandomGenerator random(1234);
+		QVector<Tilemap*> tilemaps;
+		for (auto y = 0; y < levelCount; ++y)
+		{
+			for (auto x = 0; x < levelCount; ++x)
+			{
+				auto tilemap = new Tilemap(nullptr, x * levelSize * 16.0, y * levelSize * 16.0, levelSize, levelSize, 0);
+				for (auto tileY = 0; tileY < levelSize; ++tileY)
+				{
+					for (auto tileX = 0; tileX < levelSize; ++tileX)
+					{
+						if (int(random.bounded(100)) < wallPercent)
+							tilemap->setTile(tileX, tileY, wallTile);
+					}
+				}
+				tilemaps.push_back(tilemap);
+			}
+		}
+
+		auto lookup = [&](int tileX, int tileY) -> Tilemap* {
+			if (tileX < 0 || tileY < 0)
+				return nullptr;
+
+			auto levelX = tileX / levelSize;
+			auto levelY = tileY / levelSize;
+			if (levelX >= levelCount || levelY >= levelCount)
+				return nullptr;
+			return tilemaps[levelY * levelCount + levelX];
+		};
+
+		Tilemap pattern(nullptr, 0.0, 0.0, 1, 1, 0);
+		pattern.setTile(0, 0, Tilemap::MakeTile(2, 0, 0));
+
+		//Make sure the start position isn't a wall
+		auto startTileX = (levelCount * levelSize) / 2;
+		auto startTileY = (levelCount * levelSize) / 2;
+		lookup(startTileX, startTileY)->setTile(startTileX % levelSize, startTileY % levelSize, grassTile);
+
+		QList<double> scanlineTimings;
+		int scanlineTiles = 0;
+		for (auto i = 0; i < iterations; ++i)
+		{
+			QElapsedTimer timer;
+			timer.start();
+
+			TileFloodFill floodFill(lookup);
+			scanlineTiles = floodFill.fill(startTileX, startTileY, &pattern);
+
+			scanlineTimings.push_back(timer.nsecsElapsed() / 1000000.0);
+		}
+
+		//The per-tile QSet/QStack fill the editor used before TileFloodFill
+		QList<double> legacyTimings;
+		int legacyTiles = 0;
+		for (auto i = 0; i < iterations; ++i)
+		{
+			QElapsedTimer timer;
+			timer.start();
+
+			QSet<QPair<int, int>> scannedIndexes;
+			QStack<QPair<int, int>> nodes;
+			legacyTiles = 0;
+
+			auto addNode = [&](int x, int y)
+			{
+				QPair<int, int> a(x, y);
+				if (!scannedIndexes.contains(a))
+				{
+					scannedIndexes.insert(a);
+					nodes.push(a);
+				}
+			};
+			addNode(startTileX, startTileY);
+
+			while (nodes.count() > 0)
+			{
+				auto node = nodes.pop();
+				auto tilemap = lookup(node.first, node.second);
+				if (tilemap == nullptr)
+					continue;
+
+				int tile = 0;
+				if (tilemap->tryGetTile(node.first % levelSize, node.second % levelSize, &tile) && tile == grassTile)
+				{
+					++legacyTiles;
+					addNode(node.first - 1, node.second);
+					addNode(node.first, node.second - 1);
+					addNode(node.first + 1, node.second);
+					addNode(node.first, node.second + 1);
+				}
+			}
+
+			legacyTimings.push_back(timer.nsecsElapsed() / 1000000.0);
+		}
+
+		qDeleteAll(tilemaps);
+
+		cJSON_AddNumberToObject(output, "levels", levelCount * levelCount);
+		cJSON_AddNumberToObject(output, "levelSize", levelSize);
+		cJSON_AddNumberToObject(output, "iterations", iterations);
+		cJSON_AddNumberToObject(output, "tilesFilled", scanlineTiles);
+		cJSON_AddBoolToObject(output, "matchesLegacy", scanlineTiles == legacyTiles);
+		addTimings(output, "scanline", scanlineTimings);
+		addTimings(output, "legacy", legacyTimings);
+
+		return scanlineTiles == legacyTiles ? 0 : 1;
+	}
+
+	int Benchmarks::fileIndex(const QMap<QString, QString>& options, cJSON* output)
+	{
+		auto iterations = options.value("iterations", "5").toInt();
+		auto folders = options.value("folders", "32").toInt();
+		auto subFolders = options.value("subfolders", "8").toInt();
+		auto files = options.value("files", "64").toInt();
+		auto lookups = options.value("lookups", "10000").toInt();
+
+		if (iterations <= 0 || folders <= 0 || subFolders < 0 || files <= 0)
+			return 1;
+
+		QTemporaryDir tempDir;
+		if (!tempDir.isValid())
+			return 1;
+
+		//Two levels of folders, each full of empty files
+		auto rootPath = QDir(tempDir.path()).filePath("assets") + "/";
+		auto makeFiles = [&](const QString& path) -> bool
+		{
+			if (!QDir().mkpath(path))
+				return false;
+
+			for (auto i = 0; i < files; ++i)
+			{
+				QFile file(path + QString("file%1.png").arg(i));
+				if (!file.open(QIODevice::WriteOnly))
+					return false;
+			}
+			return true;
+		};
+
+		for (auto i = 0; i < folders; ++i)
+		{
+			auto folderPath = rootPath + QString("folder%1/").arg(i);
+			if (!makeFiles(folderPath))
+				return 1;
+
+			for (auto j = 0; j < subFolders; ++j)
+			{
+				if (!makeFiles(folderPath + QString("sub%1/").arg(j)))
+					return 1;
+			}
+		}
+
+		//Walking the folders on one thread, as searchDirectory used to
+		QList<double> legacyTimings;
+		qint64 fileCount = 0;
+		for (auto i = 0; i < iterations; ++i)
+		{
+			QElapsedTimer timer;
+			timer.start();
+
+			QHash<QString, QString> fileNames;
+			QStack<QString> stack;
+			stack.push(rootPath);
+			while (!stack.isEmpty())
+			{
+				auto path = stack.pop();
+				QDirIterator it(path, QStringList(), QDir::Filter::Files | QDir::Filter::NoDotAndDotDot | QDir::Filter::Dirs);
+				while (it.hasNext())
+				{
+					auto fInfo = it.nextFileInfo();
+					if (fInfo.isDir())
+						stack.push(fInfo.absoluteFilePath() + "/");
+					else if (fInfo.isFile())
+						fileNames[fInfo.fileName().toLower()] = fInfo.absoluteFilePath();
+				}
+			}
+			fileCount = fileNames.size();
+			legacyTimings.push_back(timer.nsecsElapsed() / 1000000.0);
+		}
+
+		//Listing every folder on several threads, with nothing saved
+		auto indexFileName = QDir(tempDir.path()).filePath("fileindex.dat");
+		QList<double> coldTimings;
+		for (auto i = 0; i < iterations; ++i)
+		{
+			QFile::remove(indexFileName);
+
+			QElapsedTimer timer;
+			timer.start();
+
+			FileNameIndex index;
+			index.setFileName(indexFileName);
+			index.update(rootPath, 2);
+			index.waitForUpdates();
+			coldTimings.push_back(timer.nsecsElapsed() / 1000000.0);
+		}
+
+		//Starting again with the saved index, so only the modified times are checked
+		QList<double> warmTimings;
+		for (auto i = 0; i < iterations; ++i)
+		{
+			QElapsedTimer timer;
+			timer.start();
+
+			FileNameIndex index;
+			index.setFileName(indexFileName);
+			index.update(rootPath, 2);
+			index.waitForUpdates();
+			warmTimings.push_back(timer.nsecsElapsed() / 1000000.0);
+		}
+
+		//Looking up names that don't exist. The first lookup of each checks every search folder, after that they are remembered
+		ResourceManagerFileSystem resourceManager(rootPath, nullptr);
+		resourceManager.addSearchDirRecursive(rootPath, 2);
+		FileNameIndex::instance()->waitForUpdates();
+
+		QList<double> firstMissTimings, repeatMissTimings;
+		for (auto pass = 0; pass < 2; ++pass)
+		{
+			QElapsedTimer timer;
+			timer.start();
+
+			for (auto i = 0; i < lookups; ++i)
+			{
+				QString fullPath;
+				if (resourceManager.locateFile(QString("missing%1.png").arg(i), &fullPath))
+					return 1;
+			}
+			(pass == 0 ? firstMissTimings : repeatMissTimings).push_back(timer.nsecsElapsed() / 1000000.0);
+		}
+
+		cJSON_AddNumberToObject(output, "files", fileCount);
+		cJSON_AddNumberToObject(output, "folders", folders * (subFolders + 1) + 1);
+		addTimings(output, "legacy", legacyTimings);
+		addTimings(output, "cold", coldTimings);
+		addTimings(output, "warm", warmTimings);
+		addTimings(output, "firstMiss", firstMissTimings);
+		addTimings(output, "repeatMiss", repeatMissTimings);
+		return 0;
+	}
+};
@@ -0,0 +1,42 @@
+#ifndef BENCHMARKSH
+#define BENCHMARKSH
+
+#include <QStringList>
+#include <QMap>
+#include <QString>
+#include <QByteArray>
+#include <QRandomGenerator>
+#include "cJSON/cJSON.h"
+#include "LevelModel.h"
+
+namespace TilesEditor
+{
+	//Command line benchmarks: TilesEditor -benchmark <name> [-option value]...
+	//Results are printed to stdout as json
+	class Benchmarks
+	{
+	private:
+		static int floodFill(const QMap<QString, QString>& options, cJSON* output);
+		static int render(const QMap<QString, QString>& options, cJSON* output);
+		static int spatialGrid(const QMap<QString, QString>& options, cJSON* output);
+		static int tileBlit(const QMap<QString, QString>& options, cJSON* output);
+		static int snapshot(const QMap<QString, QString>& options, cJSON* output);
+		static int nwParse(const QMap<QString, QString>& options, cJSON* output);
+		static int graalParse(const QMap<QString, QString>& options, cJSON* output);
+		static int fileIndex(const QMap<QString, QString>& options, cJSON* output);
+
+		//Write a gmap of width x height generated levels (and a tileset image) to directory. Returns the gmap file name
+		static QString generateWorld(const QString& directory, int width, int height, int layers, int npcs);
+		static qint64 getPeakMemoryUsage();
+
+		//A random graal level, using every part of the format the decoder reads. expected is filled with what the decoder should read back
+		static QByteArray generateGraalLevel(QRandomGenerator& random, LevelModel* expected);
+
+		static void addTimings(cJSON* output, const char* name, const QList<double>& timings);
+
+	public:
+		static int run(const QStringList& args);
+	};
+};
+
+#endif
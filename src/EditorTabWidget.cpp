@@ -27,6 +27,8 @@
 #include "LevelObjectInstance.h"
 #include "EditTilesets.h"
 #include "ResourceManagerFileSystem.h"
+#include "TileFloodFill.h"
+#include "FrameProfiler.h"
 
 namespace TilesEditor
 {
@@ -79,6 +81,14 @@ namespace TilesEditor
 		m_tilesetImage = nullptr;
 		m_graphicsView->setSceneRect(QRect(0, 0, 64 * 16, 64 * 16));
 		m_graphicsView->setAntiAlias(false);
+
+		m_floodFillPreview = new FloodFillPreview(this);
+		connect(m_floodFillPreview, &FloodFillPreview::ready, m_graphicsView, &GraphicsView::redraw);
+
+		m_levelThumbnails = new LevelThumbnails(this);
+		connect(m_levelThumbnails, &LevelThumbnails::ready, m_graphicsView, &GraphicsView::redraw);
+		m_levelThumbnails->setDiskCache(engine->getThumbnailDiskCache());
+		connect(engine->getThumbnailDiskCache(), &ThumbnailDiskCache::ready, m_graphicsView, &GraphicsView::redraw);
 		ui_objectClass.objectsTable->setModel(new ObjectListModel());
 		ui_objectClass.objectsTable->setColumnWidth(2, 70);
 		ui_objectClass.objectsTable->setColumnWidth(3, 70);
@@ -130,6 +140,19 @@ namespace TilesEditor
 
 		auto trimSignEndings = functionsMenu->addAction("Trim Sign Endings");
 		connect(trimSignEndings, &QAction::triggered, this, &EditorTabWidget::trimSignEndingsClicked);
+
+		functionsMenu->addSeparator();
+		auto frameProfiler = functionsMenu->addAction("Frame Profiler");
+		frameProfiler->setCheckable(true);
+		connect(frameProfiler, &QAction::triggered, this, &EditorTabWidget::frameProfilerClicked);
+
+		//The profiler is shared by every tab, so it may have been turned on or off from another one
+		connect(functionsMenu, &QMenu::aboutToShow, [frameProfiler]() {
+			frameProfiler->setChecked(FrameProfiler::isEnabled());
+		});
+
+		auto saveFrameTrace = functionsMenu->addAction("Save Frame Trace...");
+		connect(saveFrameTrace, &QAction::triggered, this, &EditorTabWidget::saveFrameTraceClicked);
 		ui.functionsButton->setMenu(functionsMenu);
 
 		m_graphicsView->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
@@ -171,6 +194,7 @@ namespace TilesEditor
 
 
 		connect(m_graphicsView, &GraphicsView::renderView, this, &EditorTabWidget::renderScene);
+		connect(m_graphicsView, &GraphicsView::renderForeground, this, &EditorTabWidget::renderForeground);
 		connect(m_graphicsView, &GraphicsView::mousePress, this, &EditorTabWidget::graphicsMousePress);
 		connect(m_graphicsView, &GraphicsView::mouseRelease, this, &EditorTabWidget::graphicsMouseRelease);
 		connect(m_graphicsView, &GraphicsView::mouseMove, this, &EditorTabWidget::graphicsMouseMove);
@@ -273,117 +297,24 @@ namespace TilesEditor
 
 	void EditorTabWidget::renderFloodFillPreview(const QPointF& point, QSet<Level*>& viewLevels, QPainter* painter, const QRectF& viewRect)
 	{
-		QSet<int> startTiles;
-		QSet<QPair<int, int>> scannedIndexes;
-
+		FrameProfiler::Scope scope("flood fill");
 		auto startTileX = int(std::floor(point.x() / 16));
 		auto startTileY = int(std::floor(point.y() / 16));
 
-
-
 		auto purpleSquareRect = QRect(startTileX * 16, startTileY * 16, m_fillPattern.getWidth(), m_fillPattern.getHeight());
 
-		auto startTileX2 = (int)std::ceil(double(startTileX) / m_fillPattern.getHCount()) * m_fillPattern.getHCount();
-		auto startTileY2 = (int)std::ceil(double(startTileY) / m_fillPattern.getVCount()) * m_fillPattern.getVCount();
-
-		//Get a set of tiles that can be replaced
-		for (auto y = 0; y < m_fillPattern.getVCount(); ++y)
-		{
-			for (auto x = 0; x < m_fillPattern.getHCount(); ++x)
-			{
-				int tile = 0;
-				if (tryGetTileAt(QPointF((startTileX + x) * 16, (startTileY + y) * 16), &tile))
-					startTiles.insert(tile);
-			}
-		}
-
-
-		QStack<QPair<int, int> > nodes;
-		auto addNode = [&](int x, int y)
-		{
-			QPair<int, int> a(x, y);
-
-			if (!scannedIndexes.contains(a))
-			{
-				scannedIndexes.insert(a);
-				nodes.push(a);
-			}
-
-		};
-		addNode(startTileX, startTileY);
-
-		Level* level = nullptr;
-		while (nodes.count() > 0)
-		{
-			auto node = nodes.pop();
-
-			auto nodeXPos = node.first * 16.0;
-			auto nodeYPos = node.second * 16.0;
-
-			if (level == nullptr || nodeXPos < level->getX() || nodeXPos >= level->getRight() || nodeYPos < level->getY() || nodeYPos >= level->getBottom())
-			{
-				level = getLevelAt(QPointF(nodeXPos, nodeYPos));
-				if (!viewLevels.contains(level))
-				{
-					level = nullptr;
-					continue;
-				}
-			}
-
-
-			if (level != nullptr)
-			{
-				
-				auto tilemap = level->getTilemap(m_selectedTilesLayer);
-				if (tilemap != nullptr)
-				{
-					
-					//left/top position within the destination "Tilemap"
-					auto tilemapX = node.first - int(std::floor(tilemap->getX() / 16.0));
-					auto tilemapY = node.second - int(std::floor(tilemap->getY() / 16.0));
-		
-					//Get the correct pattern co-ordinates
-					auto deltaX = startTileX2 + (node.first - startTileX);
-					auto deltaY = startTileY2 + (node.second - startTileY);
-
-					auto patternTileX = deltaX % m_fillPattern.getHCount();
-					auto patternTileY = deltaY % m_fillPattern.getVCount();
-
-
-					auto patternTile = m_fillPattern.getTile(patternTileX, patternTileY);
-					int tile = 0;
-					if (tilemap->tryGetTile(tilemapX, tilemapY, &tile) && !Tilemap::IsInvisibleTile(tile))
-					{
-						
-						if (startTiles.contains(tile))
-						{
-							QRectF rect(node.first * 16, node.second * 16, 16, 16);
-							if (!rect.intersects(purpleSquareRect))
-							{
-								
-								level->drawTile(node.first * 16, node.second * 16, m_tilesetImage, Tilemap::GetTileX(patternTile), Tilemap::GetTileY(patternTile), painter);
-							}
-								//painter->drawPixmap(node.first * 16, node.second * 16, m_tilesetImage->pixmap(), Tilemap::GetTileX(patternTile) * 16, Tilemap::GetTileY(patternTile) * 16, 16, 16);
-
-
-							addNode(node.first - 1, node.second);
-							addNode(node.first, node.second - 1);
-
-							addNode(node.first + 1, node.second);
-							addNode(node.first, node.second + 1);
-
-
-						}
-					}
-				}
-			}
-		}
+		//Only preview the fill within the levels being drawn. The region is filled in the background
+		//and cached, so this is usually just a blit
+		m_floodFillPreview->update(startTileX, startTileY, m_selectedTilesLayer, &m_fillPattern, m_fillPattern.getRevision(), viewLevels);
+		m_floodFillPreview->draw(painter, viewRect, purpleSquareRect, startTileX, startTileY, m_selectedTilesLayer, m_fillPattern.getRevision(), m_tilesetImage);
 	}
 
 	void EditorTabWidget::renderScene(QPainter * painter, const QRectF & _rect)
 	{
 		QRectF viewRect(std::floor(_rect.x()), std::floor(_rect.y()), _rect.width() + 2, _rect.height() + 2);
 
+		auto profiler = FrameProfiler::instance();
+		profiler->beginFrame();
 	
 		//forcing the view x/y offset as a whole number prevents tile alignment errors
 		auto transform = painter->transform();
@@ -396,11 +327,60 @@ namespace TilesEditor
 		auto mousePos = m_graphicsView->mapToScene(m_graphicsView->mapFromGlobal(QCursor::pos()));
 
 	
-		auto drawLevels = getLevelsInRect(QRectF(viewRect.x() - 1000, viewRect.y() - 1000, viewRect.width() + 2000, viewRect.height() + 2000));
+		//Nearest levels get loaded first
+		if (m_overworld)
+			m_overworld->getLoadScheduler()->setViewRect(viewRect);
+
+		//Zoomed out far enough that tiles are only a few pixels, so levels are drawn from their thumbnails
+		auto mipLevel = LevelThumbnails::getMipLevel(transform.m11());
+
+		//When drawing from thumbnails, overworld levels are only created and loaded once we know there is no thumbnail saved for them.
+		//Not loaded (or still loading) levels are drawn from the thumbnail saved on disk. They are loaded in the background
+		//when there is no saved thumbnail, it is out of date, or it is too small for this zoom
+		QSet<Level*> drawLevels;
+		QRectF drawRect(viewRect.x() - 1000, viewRect.y() - 1000, viewRect.width() + 2000, viewRect.height() + 2000);
+		FrameProfiler::Scope levelSearchScope("level search");
+		if (m_overworld && mipLevel > 0 && m_tilesetImage)
+		{
+			QSet<LevelEntry*> drawEntries;
+			m_overworld->searchLevelEntries(drawRect, drawEntries);
+
+			for (auto entry : drawEntries)
+			{
+				if (entry->getLoadState() == LoadState::STATE_NOT_LOADED || entry->getLoadState() == LoadState::STATE_LOADING)
+				{
+					QString fullPath;
+					if (entry->getFileName().isEmpty() && m_resourceManager->locateFile(entry->getName(), &fullPath))
+						entry->setFileName(fullPath);
+
+					auto status = m_levelThumbnails->drawSaved(painter, entry->getFileName(), entry->toQRectF(), m_tilesetImage);
+					FrameProfiler::count(FrameProfiler::COUNTER_DRAW_CALLS);
+					if (status == ThumbnailDiskCache::Status::Missing || status == ThumbnailDiskCache::Status::Stale || mipLevel < LevelThumbnails::DISK_MIP_LEVEL)
+						loadLevel(m_overworld->getLevel(entry), true);
+				}
+				else drawLevels.insert(m_overworld->getLevel(entry));
+			}
+		}
+		else drawLevels = getLevelsInRect(drawRect);
+
+		//Unload levels we've moved far away from when over the memory budget
+		if (m_overworld)
+		{
+			m_overworld->touchLevels(drawLevels);
+			//Evicted levels are unmodified (so not in the undo history), unselected and well away from drawLevels, so nothing points at them
+			for (auto level : m_overworld->getLevelsToEvict(viewRect, [this](Level* level) { return isLevelPinned(level); }))
+			{
+				unloadLevel(level);
+				m_overworld->releaseLevel(level);
+			}
+		}
+		levelSearchScope.end();
+
 		//Draw npcs
-		QSet<AbstractLevelEntity*> drawObjects;
+		QList<AbstractLevelEntity*> drawTilemaps;
 
 
+		FrameProfiler::Scope thumbnailScope("thumbnails");
 		if (m_tilesetImage)
 		{
 
@@ -409,11 +389,27 @@ namespace TilesEditor
 			{
 				auto& layers = level->getTileLayers();
 
+				if (mipLevel > 0 && level->getLoadState() == LoadState::STATE_LOADED)
+				{
+					QVector<int> visibleLayers;
+					for (auto tilemap : layers)
+					{
+						if (isLayerVisible(tilemap->getLayerIndex()))
+							visibleLayers.push_back(tilemap->getLayerIndex());
+					}
+
+					if (m_levelThumbnails->draw(painter, level, m_tilesetImage, visibleLayers, mipLevel))
+					{
+						FrameProfiler::count(FrameProfiler::COUNTER_DRAW_CALLS);
+						continue;
+					}
+				}
+
 				for (auto tilemap : layers)
 				{
 					if(isLayerVisible(tilemap->getLayerIndex()))
 					{
-						drawObjects.insert(tilemap);
+						drawTilemaps.push_back(tilemap);
 					}
 				}
 			}
@@ -421,17 +417,33 @@ namespace TilesEditor
 
 
 
+		thumbnailScope.end();
+
+		//The spatial maps keep their entities in depth order, so they come back ready to draw
+		FrameProfiler::Scope spatialQueryScope("spatial query");
+		QList<AbstractLevelEntity*> drawEntities;
 		if (m_overworld)
 		{
-			m_overworld->getEntitySpatialMap()->search(viewRect, false, drawObjects);
+			m_overworld->getEntitySpatialMap()->searchOrdered(viewRect, false, drawEntities);
 		}
 		else if (m_level) {
-			m_level->getEntitySpatialMap()->search(viewRect, false, drawObjects);
+			m_level->getEntitySpatialMap()->searchOrdered(viewRect, false, drawEntities);
 		}
+		spatialQueryScope.end();
+
+		//Only the tilemaps (a few per level) need sorting, then they're merged in. Tilemaps go first when the depth is the same
+		FrameProfiler::Scope depthSortScope("depth sort");
+		std::stable_sort(drawTilemaps.begin(), drawTilemaps.end(), AbstractLevelEntity::sortByDepthFunc);
+
+		QList<AbstractLevelEntity*> sortedObjects(drawTilemaps.size() + drawEntities.size());
+		std::merge(drawTilemaps.cbegin(), drawTilemaps.cend(), drawEntities.cbegin(), drawEntities.cend(), sortedObjects.begin(), AbstractLevelEntity::sortByDepthFunc);
+		FrameProfiler::count(FrameProfiler::COUNTER_ENTITIES_SORTED, drawTilemaps.size());
+		depthSortScope.end();
 
-		QList<AbstractLevelEntity*> sortedObjects(drawObjects.begin(), drawObjects.end());
-		std::sort(sortedObjects.begin(), sortedObjects.end(), AbstractLevelEntity::sortByDepthFunc);
 
+		//Timed as one event each, rather than one per tilemap or entity
+		FrameProfiler::Total tilesTotal("tiles");
+		FrameProfiler::Total entitiesTotal("entities");
 
 		bool drawnFloodFill = !ui.floodFillButton->isChecked();
 		for (auto entity : sortedObjects)
@@ -455,6 +467,7 @@ namespace TilesEditor
 
 			if (entity->getEntityType() == LevelEntityType::ENTITY_TILEMAP && m_tilesetImage)
 			{
+				tilesTotal.resume();
 				auto tilemap = static_cast<Tilemap*>(entity);
 				auto fade = m_selectedTilesLayer != tilemap->getLayerIndex() && ui.fadeLayersButton->isChecked();
 				if (fade)
@@ -470,11 +483,15 @@ namespace TilesEditor
 					if (tilemap->getLevel())
 						tilemap->getLevel()->drawTilemap(tilemap, m_tilesetImage, tilemap->getX(), tilemap->getY(), painter, viewRect);
 				}
+				tilesTotal.pause();
 				continue;
 			}
 
 			if (isLayerVisible(entity->getLayerIndex()))
 			{
+				entitiesTotal.resume();
+				FrameProfiler::count(FrameProfiler::COUNTER_DRAW_CALLS);
+
 				auto fade = m_selectedTilesLayer != entity->getLayerIndex() && ui.fadeLayersButton->isChecked();
 				entity->loadResources();
 
@@ -484,9 +501,11 @@ namespace TilesEditor
 					entity->draw(painter, viewRect);
 					painter->setOpacity(1.0);
 				} else entity->draw(painter, viewRect);
-				
+				entitiesTotal.pause();
 			}
 		}
+		tilesTotal.end();
+		entitiesTotal.end();
 
 
 		if (!drawnFloodFill)
@@ -494,6 +513,8 @@ namespace TilesEditor
 			drawnFloodFill = true;
 			renderFloodFillPreview(mousePos, drawLevels, painter, _rect);
 		}
+
+		FrameProfiler::Scope selectionScope("selection");
 		if (m_selection != nullptr && m_selection->isVisible())
 		{
 			if (m_selection->getSelectionType() == SelectionType::SELECTION_TILES)
@@ -536,9 +557,11 @@ namespace TilesEditor
 			painter->fillRect(rect, QColor(255, 0, 255, 128));
 
 		}
+		selectionScope.end();
 
 		if (m_overworld)
 		{
+			FrameProfiler::Scope scope("level names");
 			QFontMetrics fm(m_font1);
 
 			int fontHeight = fm.height();
@@ -592,6 +615,7 @@ namespace TilesEditor
 		//Draw grid
 		if (ui.gridButton->isChecked())
 		{
+			FrameProfiler::Scope scope("grid");
 			if (ui.hcountSpinBox->value() > 0 && ui.vcountSpinBox->value() > 0)
 			{
 				if (m_gridImage.isNull())
@@ -616,6 +640,20 @@ namespace TilesEditor
 			}
 
 		}
+
+		profiler->endFrame();
+
+		//The overlay is drawn in renderForeground, outside of the timed frame. It covers the whole view,
+		//so the view has to redraw all of it every time
+		auto updateMode = FrameProfiler::isEnabled() ? QGraphicsView::FullViewportUpdate : QGraphicsView::MinimalViewportUpdate;
+		if (m_graphicsView->viewportUpdateMode() != updateMode)
+			m_graphicsView->setViewportUpdateMode(updateMode);
+	}
+
+	void EditorTabWidget::renderForeground(QPainter* painter, const QRectF& rect)
+	{
+		if (FrameProfiler::isEnabled())
+			FrameProfiler::instance()->drawOverlay(painter, m_graphicsView->viewport()->rect());
 	}
 
 	void EditorTabWidget::renderTilesetSelection(QPainter* painter, const QRectF& viewRect)
@@ -750,7 +788,8 @@ namespace TilesEditor
 			m_resourceManager->freeResource(m_tilesetImage);
 		}
 
-		m_tilesetImage = static_cast<Image*>(m_resourceManager->loadResource(this, imageName, ResourceType::RESOURCE_IMAGE));
+		//Nothing can be drawn without the tileset, so don't decode it in the background
+		m_tilesetImage = static_cast<Image*>(m_resourceManager->loadResource(this, imageName, ResourceType::RESOURCE_IMAGE, false));
 
 		if (m_tilesetImage)
 		{
@@ -1528,6 +1567,15 @@ namespace TilesEditor
 	{
 		if (m_tileset.getImageName().toLower() == fileName)
 		{
+			//The tileset image was replaced in place, so any pre-composited tiles are stale
+			if (m_overworld)
+			{
+				for (auto level : m_overworld->getLevelList())
+					level->invalidateTileRenderCache();
+			}
+			else if (m_level)
+				m_level->invalidateTileRenderCache();
+
 			m_graphicsView->redraw();
 			ui_tilesetsClass.graphicsView->redraw();
 			ui_tileObjectsClass.graphicsView->redraw();
@@ -1569,12 +1617,16 @@ namespace TilesEditor
 
 	void EditorTabWidget::loadLevel(Level* level, bool threaded)
 	{
-		while (!threaded && level->getLoadState() == LoadState::STATE_LOADING)
+		//Levels still queued (or loading) in the background are loaded now instead
+		if (!threaded && level->getLoadState() == LoadState::STATE_LOADING && m_overworld)
 		{
+			if (m_overworld->getLoadScheduler()->cancel(level))
+				level->setLoadState(LoadState::STATE_NOT_LOADED);
 		}
 
 		if (level->getLoadState() == LoadState::STATE_NOT_LOADED)
 		{
+			FrameProfiler::count(FrameProfiler::COUNTER_LEVELS_LOADED);
 			level->setLoadState(LoadState::STATE_LOADING);
 			QString fullPath;
 			if (m_resourceManager->locateFile(level->getName(), &fullPath))
@@ -1590,6 +1642,34 @@ namespace TilesEditor
 		}
 	}
 
+	void EditorTabWidget::unloadLevel(Level* level)
+	{
+		auto objectListModel = static_cast<ObjectListModel*>(ui_objectClass.objectsTable->model());
+
+		//Remove this level's npcs from the npc search
+		for (auto entity : level->getObjects())
+		{
+			if (entity->getEntityType() == LevelEntityType::ENTITY_NPC)
+				objectListModel->removeEntity(static_cast<LevelNPC*>(entity));
+		}
+
+		m_levelThumbnails->remove(level);
+		level->unload();
+	}
+
+	bool EditorTabWidget::isLevelPinned(Level* level)
+	{
+		if (m_selection != nullptr && m_selection->getSelectionType() == SelectionType::SELECTION_OBJECTS)
+		{
+			for (auto entity : static_cast<ObjectSelection*>(m_selection)->getObjects())
+			{
+				if (entity->getLevel() == level)
+					return true;
+			}
+		}
+		return false;
+	}
+
 	void EditorTabWidget::loadOverworld(const QString& name, const QString & fileName)
 	{
 		m_overworld = new Overworld(this, name);
@@ -2785,94 +2865,35 @@ namespace TilesEditor
 	
 	void EditorTabWidget::floodFillPattern(const QPointF& point, int layer, const Tilemap* pattern, QList<TileInfo>* outputNodes)
 	{
-		QSet<int> startTiles;
-		QSet<QPair<int, int>> scannedIndexes;
 		auto startTileX = int(std::floor(point.x() / 16));
 		auto startTileY = int(std::floor(point.y() / 16));
 
-		auto startTileX2 = (int)std::ceil(double(startTileX) / pattern->getHCount()) * pattern->getHCount();
-		auto startTileY2 = (int)std::ceil(double(startTileY) / pattern->getVCount()) * pattern->getVCount();
-
-		//Get a set of tiles that can be replaced
-		for (auto y = 0; y < pattern->getVCount(); ++y)
-		{
-			for (auto x = 0; x < pattern->getHCount(); ++x)
-			{
-				int tile = 0;
-				if (tryGetTileAt(QPointF((startTileX + x) * 16, (startTileY + y) * 16), &tile))
-					startTiles.insert(tile);
-			}
-		}
-
-		QStack<QPair<int, int> > nodes;
-		auto addNode = [&](int x, int y)
+		TileFloodFill floodFill([this, layer](int tileX, int tileY) -> Tilemap*
 		{
-			QPair<int, int> a(x, y);
-
-			if (!scannedIndexes.contains(a))
-			{
-				scannedIndexes.insert(a);
-				nodes.push(a);
-			}
+			auto level = getLevelAt(QPointF(tileX * 16.0, tileY * 16.0));
+			return level != nullptr ? level->getTilemap(layer) : nullptr;
+		});
 
-		};
-		addNode(startTileX, startTileY);
+		//Work out the whole region first, then replace the tiles
+		floodFill.fill(startTileX, startTileY, pattern);
 
-		Level* level = nullptr;
-		while (nodes.count() > 0)
+		for (auto& span : floodFill.getSpans())
 		{
-			auto node = nodes.pop();
-
-			auto nodeXPos = node.first * 16.0;
-			auto nodeYPos = node.second * 16.0;
+			auto tilemap = span.tilemap;
+			if (tilemap->getLevel())
+				setModified(tilemap->getLevel());
 
-			if (level == nullptr || nodeXPos < level->getX() || nodeXPos >= level->getRight() || nodeYPos < level->getY() || nodeYPos >= level->getBottom())
-				level = getLevelAt(QPointF(nodeXPos, nodeYPos));
-
-			if (level != nullptr)
+			auto tileY = span.originY + span.tileY;
+			for (auto x = span.left; x <= span.right; ++x)
 			{
-				auto tilemap = level->getTilemap(m_selectedTilesLayer);
-				if (tilemap != nullptr)
-				{
-					//left/top position within the destination "Tilemap"
-					auto tilemapX = node.first - int(std::floor(tilemap->getX() / 16.0));
-					auto tilemapY = node.second - int(std::floor(tilemap->getY() / 16.0));
-
-					//Get the correct pattern co-ordinates
-					auto deltaX = startTileX2 + (node.first - startTileX);
-					auto deltaY = startTileY2 + (node.second - startTileY);
+				auto tileX = span.originX + x;
 
-					auto patternTileX = deltaX % pattern->getHCount();
-					auto patternTileY = deltaY % pattern->getVCount();
+				if (outputNodes)
+					outputNodes->push_back(TileInfo{ (unsigned short)tileX, (unsigned short)tileY, tilemap->getTile(x, span.tileY) });
 
-
-					auto patternTile = pattern->getTile(patternTileX, patternTileY);
-					int tile = 0;
-					if (tilemap->tryGetTile(tilemapX, tilemapY, &tile) && !Tilemap::IsInvisibleTile(tile))
-					{
-						if (startTiles.contains(tile))
-						{
-							setModified(level);
-
-							if (outputNodes)
-								outputNodes->push_back(TileInfo { (unsigned short)node.first, (unsigned short)node.second, tile });
-
-							tilemap->setTile(tilemapX, tilemapY, patternTile);
-
-
-							addNode(node.first - 1, node.second);
-							addNode(node.first, node.second - 1);
-
-							addNode(node.first + 1, node.second);
-							addNode(node.first, node.second + 1);
-
-
-						}
-					}
-				}
+				tilemap->setTile(x, span.tileY, floodFill.getPatternTile(tileX, tileY));
 			}
 		}
-		
 	}
 
 	void EditorTabWidget::setProperty(const QString& name, const QVariant& value)
@@ -3782,8 +3803,9 @@ namespace TilesEditor
 			if (QMessageBox::question(nullptr, "Warning", "Are you sure you want to remove all edge links from all levels in the overworld?", QMessageBox::Yes, QMessageBox::No) == QMessageBox::Yes)
 			{
 				auto undoCommand = new QUndoCommand("Delete Overworld Edge Links");
-				for (auto level : m_overworld->getLevelList())
+				for (auto entry : m_overworld->getLevelEntries())
 				{
+					auto level = m_overworld->getLevel(entry);
 					loadLevel(level, false);
 
 					if (level->getLoadState() == LoadState::STATE_LOADED)
@@ -3791,7 +3813,7 @@ namespace TilesEditor
 						auto& links = level->getLinks();
 
 						for (auto link : links) {
-							if (link->isPossibleEdgeLink() && m_overworld->getLevelList().contains(link->getNextLevel()))
+							if (link->isPossibleEdgeLink() && m_overworld->containsLevel(link->getNextLevel()))
 							{
 								deleteEntity(link, undoCommand);
 							}
@@ -3817,7 +3839,11 @@ namespace TilesEditor
 		QList<Level*> levels;
 
 		if (m_overworld)
-			levels = m_overworld->getLevelList().values();
+		{
+			//Every level in the overworld, not just the ones created so far
+			for (auto entry : m_overworld->getLevelEntries())
+				levels.push_back(m_overworld->getLevel(entry));
+		}
 		else if (m_level) {
 			levels.push_back(m_level);
 		}
@@ -3872,7 +3898,11 @@ namespace TilesEditor
 		QList<Level*> levels;
 
 		if (m_overworld)
-			levels = m_overworld->getLevelList().values();
+		{
+			//Every level in the overworld, not just the ones created so far
+			for (auto entry : m_overworld->getLevelEntries())
+				levels.push_back(m_overworld->getLevel(entry));
+		}
 		else if (m_level) {
 			levels.push_back(m_level);
 		}
@@ -3912,6 +3942,28 @@ namespace TilesEditor
 		else delete undoCommand;
 	}
 
+	void EditorTabWidget::frameProfilerClicked(bool checked)
+	{
+		if (checked)
+			FrameProfiler::instance()->clear();
+
+		FrameProfiler::instance()->setEnabled(checked);
+		m_graphicsView->redraw();
+	}
+
+	void EditorTabWidget::saveFrameTraceClicked(bool checked)
+	{
+		if (!FrameProfiler::instance()->hasFrames())
+		{
+			QMessageBox::information(nullptr, "Save Frame Trace", "Turn on the frame profiler and draw some frames first.");
+			return;
+		}
+
+		auto fileName = QFileDialog::getSaveFileName(nullptr, "Save Frame Trace", "frametrace.json", "Chrome Trace (*.json)");
+		if (!fileName.isEmpty() && !FrameProfiler::instance()->saveTrace(fileName))
+			QMessageBox::critical(nullptr, "Error", "Unable to save the frame trace.");
+	}
+
 	void EditorTabWidget::tileIconMouseDoubleClick(QMouseEvent* event)
 	{
 		setDefaultTile(Tilemap::MakeInvisibleTile(0));
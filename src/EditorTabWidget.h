@@ -27,6 +27,8 @@
 #include "ObjectManager.h"
 #include "IEngine.h"
 #include "TileDefs.h"
+#include "FloodFillPreview.h"
+#include "LevelThumbnails.h"
 
 namespace TilesEditor
 {
@@ -37,6 +39,8 @@ namespace TilesEditor
 	{
 		Q_OBJECT
 
+		friend class Benchmarks;
+
 	signals:
 		void openLevel(const QString& levelName);
 		void changeTabText(const QString& text);
@@ -45,6 +49,7 @@ namespace TilesEditor
 
 	public slots:
 		void renderScene(QPainter* painter, const QRectF& rect);
+		void renderForeground(QPainter* painter, const QRectF& rect);
 		void renderTilesetSelection(QPainter* painter, const QRectF& rect);
 		void renderTileObjects(QPainter* painter, const QRectF& rect);
 		void paintDefaultTile(QPainter* painter, const QRectF& rect);
@@ -111,6 +116,8 @@ namespace TilesEditor
 		void deleteEdgeLinksClicked(bool checked);
 		void trimScriptEndingsClicked(bool checked);
 		void trimSignEndingsClicked(bool checked);
+		void frameProfilerClicked(bool checked);
+		void saveFrameTraceClicked(bool checked);
 		void tileIconMouseDoubleClick(QMouseEvent* event);
 		void gridValueChanged(int);
 	
@@ -182,6 +189,8 @@ namespace TilesEditor
 		AbstractSelection* m_selection;
 
 		Tilemap	m_fillPattern;
+		FloodFillPreview* m_floodFillPreview;
+		LevelThumbnails* m_levelThumbnails;
 		QUndoStack m_undoStack;
 
 		bool m_panning = false;
@@ -202,6 +211,8 @@ namespace TilesEditor
 
 
 		void loadLevel(Level* level, bool threaded = true);
+		void unloadLevel(Level* level);
+		bool isLevelPinned(Level* level);
 		bool selectingLevel();
 		void setTileset(const Tileset* tileset);
 		void setTileset(const QString& name);
@@ -4,6 +4,7 @@
 #include <QList>
 #include <QSet>
 #include <cmath>
+#include <algorithm>
 #include <stdint.h>
 
 #include "IEntitySpatialMap.h"
@@ -120,6 +121,18 @@ namespace TilesEditor
         }
 
 
+        int searchOrdered(const QRectF& rect, bool accurate, QList<T*>& output, bool (*f)(T*, void* userData), void* userData)
+        {
+            QList<T*> found;
+            auto count = search(rect, accurate, found, f, userData);
+
+            std::stable_sort(found.begin(), found.end(), [](T* entity1, T* entity2) {
+                return entity1->getRealDepth() < entity2->getRealDepth();
+            });
+            output.append(found);
+            return count;
+        }
+
         int search(const QRectF& rect, bool accurate, QSet<T*>& output, bool (*f)(T*, void* userData), void* userData)
         {
             static uint64_t currentSearchIndex = 0;
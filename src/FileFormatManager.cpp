@@ -46,6 +46,35 @@ namespace TilesEditor
 		return false;
 	}
 
+	bool FileFormatManager::canParseLevel(const QString& levelName) const
+	{
+		auto pos = levelName.lastIndexOf('.');
+		if (pos >= 0)
+		{
+			auto it = m_levelFormats.find(levelName.mid(pos + 1));
+			if (it != m_levelFormats.end())
+				return it.value()->canParse();
+		}
+		return false;
+	}
+
+	bool FileFormatManager::parseLevel(const QString& levelName, LevelModel* model, Tileset* defaultTileset, QIODevice* stream)
+	{
+		auto pos = levelName.lastIndexOf('.');
+		if (pos >= 0)
+		{
+			auto it = m_levelFormats.find(levelName.mid(pos + 1));
+			if (it != m_levelFormats.end())
+			{
+				auto& filter = it.value();
+
+				if (filter->canParse())
+					return filter->parseLevel(model, defaultTileset, stream);
+			}
+		}
+		return false;
+	}
+
 	void FileFormatManager::applyFormat(Level* level)
 	{
 		auto& levelName = level->getName();
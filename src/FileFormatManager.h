@@ -20,6 +20,10 @@ namespace TilesEditor
 		bool saveLevel(Level* level, QIODevice* stream);
 		bool loadLevel(Level* level, QIODevice* stream);
 
+		//Used by worker threads, so formats must not be registered while levels are loading
+		bool canParseLevel(const QString& levelName) const;
+		bool parseLevel(const QString& levelName, LevelModel* model, Tileset* defaultTileset, QIODevice* stream);
+
 		void applyFormat(Level* level);
 		void applyFormat(const QString& format, Level* level);
 		void registerLevelExtension(const QString& ext, AbstractLevelFormat* levelFormat);
@@ -0,0 +1,326 @@
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThread>
+#include <algorithm>
+#include "FileNameIndex.h"
+
+namespace TilesEditor
+{
+	FileNameIndex::FileNameIndex(QObject* parent):
+		QObject(parent)
+	{
+		//Mostly waiting on the disk, so use a few threads even on small machines
+		m_threadPool.setMaxThreadCount(qMax(4, QThread::idealThreadCount()));
+
+		//Changes seen by the watcher are saved in batches
+		m_saveTimer.setSingleShot(true);
+		m_saveTimer.setInterval(2000);
+		connect(&m_saveTimer, &QTimer::timeout, this, &FileNameIndex::save);
+		connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, &FileNameIndex::directoryChanged);
+	}
+
+	FileNameIndex::~FileNameIndex()
+	{
+		m_threadPool.waitForDone();
+		if (m_modified)
+			save();
+	}
+
+	void FileNameIndex::setFileName(const QString& fileName)
+	{
+		m_fileName = fileName;
+		load();
+	}
+
+	bool FileNameIndex::listDirectory(const QString& path, qint64 modified, Directory* output)
+	{
+		if (!QDir(path).exists())
+			return false;
+
+		output->modified = modified;
+		output->entries.clear();
+
+		QDirIterator it(path, QStringList(), QDir::Filter::Files | QDir::Filter::NoDotAndDotDot | QDir::Filter::Dirs);
+		while (it.hasNext())
+		{
+			auto fInfo = it.nextFileInfo();
+
+			if (fInfo.isDir())
+				output->entries.push_back(fInfo.fileName() + '/');
+			else if (fInfo.isFile())
+				output->entries.push_back(fInfo.fileName());
+		}
+		return true;
+	}
+
+	void FileNameIndex::update(const QString& path, int maxLevel)
+	{
+		auto update = std::make_shared<Update>();
+		update->path = path;
+		update->maxLevel = maxLevel;
+		update->directories = m_directories;
+		update->alreadyValidated = m_validated;
+		update->queue.push_back(Work{ path, 0 });
+		update->workers = m_threadPool.maxThreadCount();
+		m_updates.push_back(update);
+
+		for (int i = 0; i < update->workers; ++i)
+			m_threadPool.start([this, update]() { runUpdate(update); });
+	}
+
+	void FileNameIndex::runUpdate(std::shared_ptr<Update> update)
+	{
+		//Each thread takes folders off the queue and adds their sub folders to it, until the queue is empty and no one is busy
+		QMutexLocker locker(&update->mutex);
+		for (;;)
+		{
+			while (update->queue.isEmpty() && update->busy > 0)
+				update->condition.wait(&update->mutex);
+
+			if (update->queue.isEmpty())
+				break;
+
+			auto work = update->queue.takeLast();
+			++update->busy;
+
+			//Folders already checked are kept up to date by the watcher
+			auto alreadyValid = update->alreadyValidated.contains(work.path);
+			auto it = update->directories.constFind(work.path);
+			auto hasListing = it != update->directories.cend();
+			auto directory = hasListing ? it.value() : Directory();
+
+			locker.unlock();
+
+			auto exists = true;
+			auto relisted = false;
+			if (!alreadyValid)
+			{
+				QFileInfo fi(work.path);
+				if (!fi.isDir())
+					exists = false;
+				else {
+					auto modified = fi.lastModified().toMSecsSinceEpoch();
+					if (!hasListing || directory.modified != modified)
+					{
+						exists = listDirectory(work.path, modified, &directory);
+						relisted = true;
+					}
+				}
+			}
+
+			locker.relock();
+			--update->busy;
+
+			if (exists)
+			{
+				if (relisted)
+					update->listed[work.path] = directory;
+
+				if (!alreadyValid)
+					update->validated.push_back(work);
+
+				if (work.level < update->maxLevel)
+				{
+					for (auto& entry : directory.entries)
+					{
+						if (entry.endsWith('/'))
+							update->queue.push_back(Work{ work.path + entry, work.level + 1 });
+					}
+				}
+			}
+			else update->missing.push_back(work.path);
+
+			update->condition.wakeAll();
+		}
+
+		//The last worker out hands the results to the main thread
+		if (--update->workers > 0)
+			return;
+
+		update->condition.wakeAll();
+		locker.unlock();
+
+		QMetaObject::invokeMethod(this, [this, update]() {
+			if (m_updates.removeOne(update))
+				finishUpdate(*update);
+		}, Qt::QueuedConnection);
+	}
+
+	void FileNameIndex::waitForUpdates()
+	{
+		while (!m_updates.isEmpty())
+		{
+			auto update = m_updates.takeFirst();
+			{
+				QMutexLocker locker(&update->mutex);
+				while (update->workers > 0)
+					update->condition.wait(&update->mutex);
+			}
+			finishUpdate(*update);
+		}
+	}
+
+	void FileNameIndex::finishUpdate(Update& update)
+	{
+		for (auto& missingPath : update.missing)
+		{
+			if (m_directories.remove(missingPath))
+				m_modified = true;
+		}
+
+		for (auto it = update.listed.begin(); it != update.listed.end(); ++it)
+		{
+			m_directories[it.key()] = it.value();
+			m_modified = true;
+		}
+
+		if (!update.validated.isEmpty())
+		{
+			//The shallowest folders are watched first, so in a huge tree it's the deep folders that get checked on each update instead
+			std::stable_sort(update.validated.begin(), update.validated.end(), [](const Work& work1, const Work& work2) {
+				return work1.level < work2.level;
+			});
+
+			QStringList watchPaths;
+			for (auto& work : update.validated)
+			{
+				if (m_validated.size() >= MAX_WATCHED_DIRECTORIES)
+					break;
+
+				if (!m_validated.contains(work.path))
+				{
+					m_validated.insert(work.path);
+					watchPaths.push_back(work.path.chopped(1));
+				}
+			}
+
+			//Folders that couldn't be watched are checked again on every update, like the ones over the limit
+			if (!watchPaths.isEmpty())
+			{
+				for (auto& failedPath : m_watcher.addPaths(watchPaths))
+					m_validated.remove(failedPath + '/');
+			}
+		}
+
+		if (m_modified)
+			save();
+
+		emit updated(update.path, update.maxLevel);
+	}
+
+	const FileNameIndex::Directory* FileNameIndex::getDirectory(const QString& path) const
+	{
+		auto it = m_directories.constFind(path);
+		return it != m_directories.cend() ? &it.value() : nullptr;
+	}
+
+	void FileNameIndex::directoryChanged(const QString& watchPath)
+	{
+		auto path = watchPath + '/';
+		auto it = m_directories.find(path);
+		if (it == m_directories.end())
+			return;
+
+		auto oldEntries = it.value().entries;
+
+		Directory directory;
+		QFileInfo fi(path);
+		if (!fi.isDir() || !listDirectory(path, fi.lastModified().toMSecsSinceEpoch(), &directory))
+		{
+			m_directories.erase(it);
+			m_validated.remove(path);
+			m_watcher.removePath(watchPath);
+
+			emit filesChanged(path, QStringList(), oldEntries);
+		}
+		else {
+			it.value() = directory;
+
+			QSet<QString> oldSet(oldEntries.begin(), oldEntries.end());
+			QSet<QString> newSet(directory.entries.begin(), directory.entries.end());
+
+			QStringList added, removed;
+			for (auto& entry : directory.entries)
+			{
+				if (!oldSet.contains(entry))
+					added.push_back(entry);
+			}
+
+			for (auto& entry : oldEntries)
+			{
+				if (!newSet.contains(entry))
+					removed.push_back(entry);
+			}
+
+			if (added.isEmpty() && removed.isEmpty())
+				return;
+
+			emit filesChanged(path, added, removed);
+		}
+
+		m_modified = true;
+		m_saveTimer.start();
+	}
+
+	void FileNameIndex::load()
+	{
+		QFile file(m_fileName);
+		if (m_fileName.isEmpty() || !file.open(QIODevice::ReadOnly))
+			return;
+
+		QDataStream stream(&file);
+		stream.setVersion(QDataStream::Qt_6_0);
+
+		quint32 magic = 0, version = 0;
+		qint32 count = 0;
+		stream >> magic >> version >> count;
+		if (magic != MAGIC || version != VERSION || count < 0)
+			return;
+
+		QHash<QString, Directory> directories;
+		directories.reserve(count);
+		for (qint32 i = 0; i < count; ++i)
+		{
+			QString path;
+			Directory directory;
+			stream >> path >> directory.modified >> directory.entries;
+			directories.insert(path, directory);
+		}
+
+		//A cut short file is ignored
+		if (stream.status() != QDataStream::Ok)
+			return;
+
+		m_directories = directories;
+		m_validated.clear();
+	}
+
+	void FileNameIndex::save()
+	{
+		m_modified = false;
+		if (m_fileName.isEmpty())
+			return;
+
+		QDir().mkpath(QFileInfo(m_fileName).absolutePath());
+
+		QSaveFile file(m_fileName);
+		if (!file.open(QIODevice::WriteOnly))
+			return;
+
+		QDataStream stream(&file);
+		stream.setVersion(QDataStream::Qt_6_0);
+		stream << MAGIC << VERSION << qint32(m_directories.size());
+
+		for (auto it = m_directories.cbegin(); it != m_directories.cend(); ++it)
+			stream << it.key() << it.value().modified << it.value().entries;
+
+		if (stream.status() == QDataStream::Ok)
+			file.commit();
+	}
+};
@@ -0,0 +1,124 @@
+#ifndef FILENAMEINDEXH
+#define FILENAMEINDEXH
+
+#include <memory>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QThreadPool>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+
+namespace TilesEditor
+{
+	//Directory listings of the search folders, shared by every ResourceManagerFileSystem. Folders are listed in the background on several
+	//threads, and the listings are saved to disk so the next run only has to check each folder's modified time. Up to MAX_WATCHED_DIRECTORIES
+	//listed folders (the shallowest first) are watched while the editor runs, and filesChanged is emitted when files are added or removed
+	class FileNameIndex :
+		public QObject
+	{
+		Q_OBJECT
+
+	public:
+		struct Directory {
+			qint64 modified = 0;
+
+			//File names, and sub folder names ending with '/', in the order they were listed
+			QStringList entries;
+		};
+
+	private:
+		static const quint32 MAGIC = 0x58444946;
+		static const quint32 VERSION = 1;
+
+		//Each watch is an inotify watch on Linux, and Windows needs a thread for every 63 folders
+		static const int MAX_WATCHED_DIRECTORIES = 1024;
+
+		QString m_fileName;
+		QHash<QString, Directory> m_directories;
+
+		//Folders checked since starting and watched since, so they don't need checking again.
+		//Folders over the watch limit are checked again on every update
+		QSet<QString> m_validated;
+
+		struct Work {
+			QString path;
+			int level;
+		};
+
+		//A call to update. The workers read the listings as they were when it started, and the results are
+		//added to the index on the main thread once every worker has finished
+		struct Update {
+			QString path;
+			int maxLevel = 0;
+			QHash<QString, Directory> directories;
+			QSet<QString> alreadyValidated;
+
+			QMutex mutex;
+			QWaitCondition condition;
+			QList<Work> queue;
+			int busy = 0;
+			int workers = 0;
+
+			QHash<QString, Directory> listed;
+			QList<Work> validated;
+			QStringList missing;
+		};
+
+		QList<std::shared_ptr<Update>> m_updates;
+
+		QThreadPool m_threadPool;
+		QFileSystemWatcher m_watcher;
+		QTimer m_saveTimer;
+		bool m_modified = false;
+
+		static bool listDirectory(const QString& path, qint64 modified, Directory* output);
+		void runUpdate(std::shared_ptr<Update> update);
+		void finishUpdate(Update& update);
+		void directoryChanged(const QString& path);
+		void load();
+		void save();
+
+	signals:
+		//Paths are relative to directory. Added or removed folders end with '/'. Added folders
+		//aren't listed yet; listeners call update with however deep they search
+		void filesChanged(const QString& directory, const QStringList& added, const QStringList& removed);
+
+		//An update of path has finished and its listings can be read
+		void updated(const QString& path, int maxLevel);
+
+	public:
+		FileNameIndex(QObject* parent = nullptr);
+		~FileNameIndex();
+
+		//Where the index is saved. Loads the saved index, if there is one
+		void setFileName(const QString& fileName);
+		const QString& getFileName() const { return m_fileName; }
+
+		//Bring the listings of path (ending with '/') and its sub folders up to maxLevel deep up to date, in the background.
+		//updated is emitted when it is done
+		void update(const QString& path, int maxLevel);
+
+		//Finish any updates still running now, for lookups that can't wait for updated
+		void waitForUpdates();
+		bool isUpdating() const { return !m_updates.isEmpty(); }
+
+		//True if changes to the files in path (ending with '/') are being watched
+		bool isWatched(const QString& path) const { return m_validated.contains(path); }
+
+		//The listing of a folder, or nullptr if it hasn't been listed (or doesn't exist)
+		const Directory* getDirectory(const QString& path) const;
+
+		static FileNameIndex* instance() {
+			static auto retval = new FileNameIndex();
+			return retval;
+		}
+	};
+};
+
+#endif
@@ -0,0 +1,330 @@
+#ifndef FLATENTITYSPATIALGRIDH
+#define FLATENTITYSPATIALGRIDH
+
+#include <QList>
+#include <QSet>
+#include <QVector>
+#include <cmath>
+#include <algorithm>
+
+#include "IEntitySpatialMap.h"
+#include "ISpatialMapItem.h"
+
+
+namespace TilesEditor
+{
+    //Spatial grid where each cell keeps its entities (and a copy of their bounding boxes) in flat arrays, in depth order.
+    //Searches only read the grid, so any number of them can run at once (even from worker threads),
+    //but not at the same time as add/remove/updateEntity
+    template <typename  T>
+    class FlatEntitySpatialGrid :
+        public IEntitySpatialMap<T>
+    {
+    private:
+        struct Box {
+            double left;
+            double top;
+            double right;
+            double bottom;
+
+            bool intersects(const QRectF& rect) const {
+                return rect.right() > left && rect.bottom() > top && rect.x() < right && rect.y() < bottom;
+            }
+        };
+
+        //boxes[i] is the bounding box of entities[i], and depths[i] its depth. Sorted by depth, lowest first
+        struct Cell {
+            QVector<Box> boxes;
+            QVector<T*> entities;
+            QVector<double> depths;
+        };
+
+        double m_x;
+        double m_y;
+
+        int m_width;
+        int m_height;
+
+        int m_cellWidth;
+        int m_cellHeight;
+
+        int m_hcount;
+        int m_vcount;
+
+        QVector<Cell> m_grid;
+
+        void getCellRange(double x, double y, double width, double height, int* left, int* top, int* right, int* bottom) const
+        {
+            x -= m_x;
+            y -= m_y;
+
+            *left = (int)std::max(std::floor(x / m_cellWidth), 0.0);
+            *top = (int)std::max(std::floor(y / m_cellHeight), 0.0);
+            *right = (int)std::min(std::ceil((x + width) / m_cellWidth), (double)m_hcount);
+            *bottom = (int)std::min(std::ceil((y + height) / m_cellHeight), (double)m_vcount);
+        }
+
+        static Box makeBox(const QRectF& rect) {
+            return Box{ rect.x(), rect.y(), rect.right(), rect.bottom() };
+        }
+
+        //Entities that cover more than one cell are only reported from the first of their cells inside the searched
+        //range. That is enough to avoid duplicates without marking the entities, so searches don't write anything
+        bool isFirstCell(const Box& box, int cellX, int cellY, int left, int top) const
+        {
+            auto boxLeft = (int)std::max(std::floor((box.left - m_x) / m_cellWidth), 0.0);
+            auto boxTop = (int)std::max(std::floor((box.top - m_y) / m_cellHeight), 0.0);
+
+            return std::max(boxLeft, left) == cellX && std::max(boxTop, top) == cellY;
+        }
+
+        template <typename Output, typename Insert>
+        int searchCells(const QRectF& rect, bool accurate, Output& output, Insert insert, bool (*f)(T*, void* userData), void* userData) const
+        {
+            int left, top, right, bottom;
+            getCellRange(rect.x(), rect.y(), rect.width(), rect.height(), &left, &top, &right, &bottom);
+
+            int count = 0;
+            for (int y = top; y < bottom; ++y)
+            {
+                for (int x = left; x < right; ++x)
+                {
+                    auto& cell = m_grid[y * m_hcount + x];
+                    auto boxes = cell.boxes.constData();
+                    auto size = cell.boxes.size();
+
+                    for (qsizetype i = 0; i < size; ++i)
+                    {
+                        if (accurate && !boxes[i].intersects(rect))
+                            continue;
+
+                        if (!isFirstCell(boxes[i], x, y, left, top))
+                            continue;
+
+                        auto entity = cell.entities[i];
+                        if (f == nullptr || f(entity, userData))
+                        {
+                            insert(output, entity);
+                            ++count;
+                        }
+                    }
+                }
+            }
+            return count;
+        }
+
+        void insertIntoCells(T* entity, const Box& box)
+        {
+            auto depth = entity->m_spatialGridDepth;
+            for (auto y = entity->m_spacialGridTop; y < entity->m_spacialGridBottom; ++y)
+            {
+                for (auto x = entity->m_spacialGridLeft; x < entity->m_spacialGridRight; ++x)
+                {
+                    auto& cell = m_grid[y * m_hcount + x];
+
+                    //After anything with the same depth, so entities at the same depth keep the order they were added in
+                    auto index = std::upper_bound(cell.depths.cbegin(), cell.depths.cend(), depth) - cell.depths.cbegin();
+                    cell.boxes.insert(index, box);
+                    cell.entities.insert(index, entity);
+                    cell.depths.insert(index, depth);
+                }
+            }
+        }
+
+        void removeFromCells(T* entity)
+        {
+            for (auto y = entity->m_spacialGridTop; y < entity->m_spacialGridBottom; ++y)
+            {
+                for (auto x = entity->m_spacialGridLeft; x < entity->m_spacialGridRight; ++x)
+                {
+                    auto& cell = m_grid[y * m_hcount + x];
+                    auto index = cell.entities.indexOf(entity);
+                    if (index >= 0)
+                    {
+                        cell.boxes.remove(index);
+                        cell.entities.remove(index);
+                        cell.depths.remove(index);
+                    }
+                }
+            }
+        }
+
+    public:
+        FlatEntitySpatialGrid(double x, double y, int mapWidth, int mapHeight, int cellWidth = 256, int cellHeight = 256)
+        {
+            m_x = x;
+            m_y = y;
+            m_hcount = (int)std::ceil((double)mapWidth / cellWidth);
+            m_vcount = (int)std::ceil((double)mapHeight / cellHeight);
+
+            m_width = mapWidth;
+            m_height = mapHeight;
+
+            m_cellWidth = cellWidth;
+            m_cellHeight = cellHeight;
+
+            m_grid.resize(m_hcount * m_vcount);
+        }
+
+        int search(const QRectF& rect, bool accurate, QList<T*>& output, bool (*f)(T*, void* userData), void* userData)
+        {
+            return searchCells(rect, accurate, output, [](QList<T*>& list, T* entity) { list.append(entity); }, f, userData);
+        }
+
+        int search(const QRectF& rect, bool accurate, QSet<T*>& output, bool (*f)(T*, void* userData), void* userData)
+        {
+            return searchCells(rect, accurate, output, [](QSet<T*>& set, T* entity) { set.insert(entity); }, f, userData);
+        }
+
+        int searchOrdered(const QRectF& rect, bool accurate, QList<T*>& output, bool (*f)(T*, void* userData), void* userData)
+        {
+            struct Entry {
+                double depth;
+                T* entity;
+            };
+
+            QVector<Entry> entries;
+            auto count = searchCells(rect, accurate, entries, [](QVector<Entry>& list, T* entity) { list.append(Entry{ entity->m_spatialGridDepth, entity }); }, f, userData);
+
+            //Each cell's entities are already in order, so the results are a few sorted runs that only need merging
+            QVector<qsizetype> runs;
+            for (qsizetype i = 0; i < entries.size(); ++i)
+            {
+                if (i == 0 || entries[i].depth < entries[i - 1].depth)
+                    runs.push_back(i);
+            }
+            runs.push_back(entries.size());
+
+            auto compare = [](const Entry& entry1, const Entry& entry2) { return entry1.depth < entry2.depth; };
+            while (runs.size() > 2)
+            {
+                QVector<qsizetype> merged;
+                for (qsizetype i = 0; i + 1 < runs.size(); i += 2)
+                {
+                    merged.push_back(runs[i]);
+                    if (i + 2 < runs.size())
+                        std::inplace_merge(entries.begin() + runs[i], entries.begin() + runs[i + 1], entries.begin() + runs[i + 2], compare);
+                }
+                merged.push_back(entries.size());
+                runs.swap(merged);
+            }
+
+            output.reserve(output.size() + entries.size());
+            for (auto& entry : entries)
+                output.append(entry.entity);
+            return count;
+        }
+
+        T* searchFirst(const QRectF& rect, bool accurate, bool (*f)(T*, void* userData), void* userData)
+        {
+            int left, top, right, bottom;
+            getCellRange(rect.x(), rect.y(), rect.width(), rect.height(), &left, &top, &right, &bottom);
+
+            for (int y = top; y < bottom; ++y)
+            {
+                for (int x = left; x < right; ++x)
+                {
+                    auto& cell = m_grid[y * m_hcount + x];
+                    for (qsizetype i = 0; i < cell.boxes.size(); ++i)
+                    {
+                        if (accurate && !cell.boxes[i].intersects(rect))
+                            continue;
+
+                        if (f == nullptr || f(cell.entities[i], userData))
+                            return cell.entities[i];
+                    }
+                }
+            }
+            return nullptr;
+        }
+
+        T* entityAt(const QPointF& point)
+        {
+            QRectF rect(point.x(), point.y(), 1, 1);
+
+            int left, top, right, bottom;
+            getCellRange(point.x(), point.y(), 1, 1, &left, &top, &right, &bottom);
+
+            if (left < right && top < bottom)
+            {
+                auto& cell = m_grid[top * m_hcount + left];
+                for (qsizetype i = 0; i < cell.boxes.size(); ++i)
+                {
+                    if (cell.boxes[i].intersects(rect))
+                        return cell.entities[i];
+                }
+            }
+            return nullptr;
+        }
+
+        void add(T* entity)
+        {
+            if (entity->m_spatialGridAdded) {
+                return;
+            }
+
+            auto boundingBox = entity->getBoundingBox();
+
+            entity->m_spatialGridAdded = true;
+            entity->m_spatialGridDepth = entity->getRealDepth();
+            getCellRange(boundingBox.x(), boundingBox.y(), boundingBox.width(), boundingBox.height(),
+                &entity->m_spacialGridLeft, &entity->m_spacialGridTop, &entity->m_spacialGridRight, &entity->m_spacialGridBottom);
+
+            insertIntoCells(entity, makeBox(boundingBox));
+        }
+
+        void remove(T* entity)
+        {
+            removeFromCells(entity);
+
+            entity->m_spacialGridTop = entity->m_spacialGridLeft = entity->m_spacialGridBottom = entity->m_spacialGridRight = 0;
+            entity->m_spatialGridAdded = false;
+        }
+
+        void updateEntity(T* entity)
+        {
+            if (!entity->m_spatialGridAdded)
+                return;
+
+            auto boundingBox = entity->getBoundingBox();
+            auto box = makeBox(boundingBox);
+
+            int left, top, right, bottom;
+            getCellRange(boundingBox.x(), boundingBox.y(), boundingBox.width(), boundingBox.height(), &left, &top, &right, &bottom);
+
+            auto depth = entity->getRealDepth();
+
+            if (left != entity->m_spacialGridLeft ||
+                top != entity->m_spacialGridTop ||
+                right != entity->m_spacialGridRight ||
+                bottom != entity->m_spacialGridBottom ||
+                depth != entity->m_spatialGridDepth)
+            {
+                //Remove then re-add
+                removeFromCells(entity);
+                entity->m_spacialGridLeft = left;
+                entity->m_spacialGridTop = top;
+                entity->m_spacialGridRight = right;
+                entity->m_spacialGridBottom = bottom;
+                entity->m_spatialGridDepth = depth;
+
+                insertIntoCells(entity, box);
+            }
+            else
+            {
+                //Same cells, but the stored bounding boxes still need updating
+                for (auto y = top; y < bottom; ++y)
+                {
+                    for (auto x = left; x < right; ++x)
+                    {
+                        auto& cell = m_grid[y * m_hcount + x];
+                        auto index = cell.entities.indexOf(entity);
+                        if (index >= 0)
+                            cell.boxes[index] = box;
+                    }
+                }
+            }
+        }
+    };
+}
+#endif
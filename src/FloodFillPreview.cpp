@@ -0,0 +1,271 @@
+#include <cmath>
+#include <algorithm>
+#include <QRegion>
+#include <QHash>
+#include "FloodFillPreview.h"
+#include "TileFloodFill.h"
+
+namespace TilesEditor
+{
+	FloodFillPreview::FloodFillPreview(QObject* parent):
+		QObject(parent), m_generation(0)
+	{
+		//Only the newest fill matters, so there is no point running more than one at a time
+		m_threadPool.setMaxThreadCount(1);
+	}
+
+	FloodFillPreview::~FloodFillPreview()
+	{
+		m_threadPool.clear();
+		m_threadPool.waitForDone();
+	}
+
+	QVector<FloodFillPreview::LevelSnapshot> FloodFillPreview::getLevelSnapshots(const QSet<Level*>& viewLevels, int layer)
+	{
+		QVector<LevelSnapshot> retval;
+		for (auto level : viewLevels)
+		{
+			auto tilemap = level->getTilemap(layer);
+			if (tilemap)
+				retval.push_back(LevelSnapshot{ level, tilemap, tilemap->getRevision(), nullptr });
+		}
+
+		//Sorted so two snapshots of the same levels compare equal
+		std::sort(retval.begin(), retval.end(), [](const LevelSnapshot& a, const LevelSnapshot& b) { return a.level < b.level; });
+		return retval;
+	}
+
+	bool FloodFillPreview::sameLevels(const QVector<LevelSnapshot>& a, const QVector<LevelSnapshot>& b)
+	{
+		if (a.size() != b.size())
+			return false;
+
+		for (auto i = 0; i < a.size(); ++i)
+		{
+			if (a[i].level != b[i].level || a[i].tilemap != b[i].tilemap || a[i].revision != b[i].revision)
+				return false;
+		}
+		return true;
+	}
+
+	Tilemap* FloodFillPreview::tilemapAt(const QVector<LevelSnapshot>& levels, int tileX, int tileY)
+	{
+		for (auto& snapshot : levels)
+		{
+			//Read the copied tiles when there are some (ie: on the worker thread)
+			auto tilemap = snapshot.tiles ? snapshot.tiles.get() : snapshot.tilemap;
+
+			auto originX = int(std::floor(tilemap->getX() / 16.0));
+			auto originY = int(std::floor(tilemap->getY() / 16.0));
+			if (tileX >= originX && tileX < originX + tilemap->getHCount() && tileY >= originY && tileY < originY + tilemap->getVCount())
+				return tilemap;
+		}
+		return nullptr;
+	}
+
+	QSet<int> FloodFillPreview::getStartTiles(const QVector<LevelSnapshot>& levels, int startTileX, int startTileY, const Tilemap* pattern)
+	{
+		QSet<int> retval;
+		for (auto y = 0; y < pattern->getVCount(); ++y)
+		{
+			for (auto x = 0; x < pattern->getHCount(); ++x)
+			{
+				auto tilemap = tilemapAt(levels, startTileX + x, startTileY + y);
+
+				int tile = 0;
+				if (tilemap && tilemap->tryGetTile(startTileX + x - int(std::floor(tilemap->getX() / 16.0)), startTileY + y - int(std::floor(tilemap->getY() / 16.0)), &tile))
+					retval.insert(tile);
+			}
+		}
+		return retval;
+	}
+
+	const FloodFillPreview::LevelRegion* FloodFillPreview::regionAt(int tileX, int tileY) const
+	{
+		for (auto& region : m_result->regions)
+		{
+			auto x = tileX - region.originX;
+			auto y = tileY - region.originY;
+			if (region.bounds.contains(x, y))
+				return region.filled.testBit(y * region.hcount + x) ? &region : nullptr;
+		}
+		return nullptr;
+	}
+
+	bool FloodFillPreview::resultUsable(int startTileX, int startTileY, int layer, quint64 patternRevision) const
+	{
+		if (!m_result || m_result->layer != layer || m_result->patternRevision != patternRevision)
+			return false;
+
+		//The pattern has to line up the same way it did for the cached start tile
+		auto hcount = m_result->pattern->getHCount();
+		auto vcount = m_result->pattern->getVCount();
+		if ((startTileX - m_result->startTileX) % hcount != 0 || (startTileY - m_result->startTileY) % vcount != 0)
+			return false;
+
+		return regionAt(startTileX, startTileY) != nullptr;
+	}
+
+	bool FloodFillPreview::resultMatches(int startTileX, int startTileY, int layer, quint64 patternRevision, const QVector<LevelSnapshot>& levels) const
+	{
+		if (!m_result || !sameLevels(m_result->levels, levels))
+			return false;
+
+		if (m_result->startTileX == startTileX && m_result->startTileY == startTileY)
+			return m_result->layer == layer && m_result->patternRevision == patternRevision;
+
+		//Filling from any tile inside the region with the same set of start tiles gives the same region
+		return resultUsable(startTileX, startTileY, layer, patternRevision) &&
+			getStartTiles(levels, startTileX, startTileY, m_result->pattern.get()) == m_result->startTiles;
+	}
+
+	void FloodFillPreview::update(int startTileX, int startTileY, int layer, const Tilemap* pattern, quint64 patternRevision, const QSet<Level*>& viewLevels)
+	{
+		auto levels = getLevelSnapshots(viewLevels, layer);
+		if (resultMatches(startTileX, startTileY, layer, patternRevision, levels))
+			return;
+
+		//Already being computed
+		if (m_pendingLayer == layer && m_pendingStartTileX == startTileX && m_pendingStartTileY == startTileY &&
+			m_pendingPatternRevision == patternRevision && sameLevels(m_pendingLevels, levels))
+			return;
+
+		m_pendingStartTileX = startTileX;
+		m_pendingStartTileY = startTileY;
+		m_pendingLayer = layer;
+		m_pendingPatternRevision = patternRevision;
+		m_pendingLevels = levels;
+
+		//The worker reads copies of the tilemaps. The chunks are shared so this doesn't copy any tiles
+		auto request = std::make_shared<Result>();
+		request->generation = ++m_generation;
+		request->startTileX = startTileX;
+		request->startTileY = startTileY;
+		request->layer = layer;
+		request->patternRevision = patternRevision;
+		request->pattern = std::make_shared<Tilemap>(*pattern);
+		request->levels = levels;
+		for (auto& snapshot : request->levels)
+			snapshot.tiles = std::make_shared<Tilemap>(*snapshot.tilemap);
+
+		m_threadPool.start([this, request]()
+		{
+			//A newer fill has been queued since this one
+			if (request->generation != m_generation)
+				return;
+
+			compute(request.get());
+			QMetaObject::invokeMethod(this, [this, request]() { applyResult(request); }, Qt::QueuedConnection);
+		});
+	}
+
+	void FloodFillPreview::compute(Result* request)
+	{
+		TileFloodFill floodFill([request](int tileX, int tileY) -> Tilemap*
+		{
+			return tilemapAt(request->levels, tileX, tileY);
+		});
+
+		floodFill.fill(request->startTileX, request->startTileY, request->pattern.get());
+
+		request->startTiles = floodFill.getStartTiles();
+		request->patternOffsetX = floodFill.getPatternOffsetX();
+		request->patternOffsetY = floodFill.getPatternOffsetY();
+
+		QHash<Tilemap*, int> regionIndexes;
+		for (auto& span : floodFill.getSpans())
+		{
+			auto it = regionIndexes.find(span.tilemap);
+			if (it == regionIndexes.end())
+			{
+				Level* level = nullptr;
+				for (auto& snapshot : request->levels)
+				{
+					if (snapshot.tiles.get() == span.tilemap)
+						level = snapshot.level;
+				}
+
+				LevelRegion region;
+				region.level = level;
+				region.originX = span.originX;
+				region.originY = span.originY;
+				region.hcount = span.tilemap->getHCount();
+				region.vcount = span.tilemap->getVCount();
+				region.filled.resize(region.hcount * region.vcount);
+
+				request->regions.push_back(region);
+				it = regionIndexes.insert(span.tilemap, request->regions.size() - 1);
+			}
+
+			auto& region = request->regions[it.value()];
+			region.filled.fill(true, span.tileY * region.hcount + span.left, span.tileY * region.hcount + span.right + 1);
+			region.bounds = region.bounds.united(QRect(span.left, span.tileY, span.right - span.left + 1, 1));
+		}
+
+		//Don't hold on to the tiles any longer than needed
+		for (auto& snapshot : request->levels)
+			snapshot.tiles.reset();
+	}
+
+	void FloodFillPreview::applyResult(std::shared_ptr<Result> result)
+	{
+		if (m_result && m_result->generation > result->generation)
+			return;
+
+		m_result = result;
+		if (result->generation == m_generation)
+			m_pendingLayer = -1;
+
+		emit ready();
+	}
+
+	void FloodFillPreview::renderOverlay(LevelRegion& region, Image* tilesetImage)
+	{
+		region.overlay = QImage(region.bounds.width() * 16, region.bounds.height() * 16, QImage::Format_ARGB32_Premultiplied);
+		region.overlay.fill(Qt::transparent);
+
+		QPainter painter(&region.overlay);
+		for (auto y = region.bounds.top(); y <= region.bounds.bottom(); ++y)
+		{
+			for (auto x = region.bounds.left(); x <= region.bounds.right(); ++x)
+			{
+				if (!region.filled.testBit(y * region.hcount + x))
+					continue;
+
+				auto patternTile = TileFloodFill::getPatternTile(m_result->pattern.get(), m_result->patternOffsetX, m_result->patternOffsetY, region.originX + x, region.originY + y);
+				region.level->drawTile((x - region.bounds.x()) * 16, (y - region.bounds.y()) * 16, tilesetImage, Tilemap::GetTileX(patternTile), Tilemap::GetTileY(patternTile), &painter);
+			}
+		}
+	}
+
+	void FloodFillPreview::draw(QPainter* painter, const QRectF& viewRect, const QRect& excludeRect, int startTileX, int startTileY, int layer, quint64 patternRevision, Image* tilesetImage)
+	{
+		//While a new fill is being computed keep showing the old one, but only if the mouse is still inside it
+		if (tilesetImage == nullptr || !resultUsable(startTileX, startTileY, layer, patternRevision))
+			return;
+
+		if (m_result->overlayTileset != tilesetImage)
+		{
+			m_result->overlayTileset = tilesetImage;
+			for (auto& region : m_result->regions)
+				region.overlay = QImage();
+		}
+
+		painter->save();
+		painter->setClipRegion(QRegion(viewRect.toAlignedRect()).subtracted(QRegion(excludeRect)));
+
+		for (auto& region : m_result->regions)
+		{
+			QRect rect((region.originX + region.bounds.x()) * 16, (region.originY + region.bounds.y()) * 16, region.bounds.width() * 16, region.bounds.height() * 16);
+			if (region.level == nullptr || !viewRect.intersects(rect))
+				continue;
+
+			if (region.overlay.isNull())
+				renderOverlay(region, tilesetImage);
+
+			painter->drawImage(rect.topLeft(), region.overlay);
+		}
+
+		painter->restore();
+	}
+};
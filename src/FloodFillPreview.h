@@ -0,0 +1,102 @@
+#ifndef FLOODFILLPREVIEWH
+#define FLOODFILLPREVIEWH
+
+#include <memory>
+#include <atomic>
+#include <QObject>
+#include <QThreadPool>
+#include <QPainter>
+#include <QBitArray>
+#include <QVector>
+#include <QSet>
+#include <QImage>
+#include "Level.h"
+#include "Tilemap.h"
+#include "Image.h"
+
+namespace TilesEditor
+{
+	//Caches the flood fill preview region (and the rendered overlay) for the tile under the mouse.
+	//The region is only recomputed (on a background thread) when the start tile leaves the cached
+	//region, or the layer, fill pattern or tiles change, so moving the mouse around is just a blit
+	class FloodFillPreview :
+		public QObject
+	{
+		Q_OBJECT
+
+	private:
+		//A level's tile layer as it was when the fill was queued
+		struct LevelSnapshot {
+			Level* level;
+			Tilemap* tilemap;
+			quint64 revision;
+			std::shared_ptr<Tilemap> tiles;
+		};
+
+		//Filled tiles within a single level
+		struct LevelRegion {
+			Level* level;
+			int originX;
+			int originY;
+			int hcount;
+			int vcount;
+			QRect bounds;
+			QBitArray filled;
+			QImage overlay;
+		};
+
+		struct Result {
+			quint64 generation = 0;
+			int startTileX = 0;
+			int startTileY = 0;
+			int layer = 0;
+			quint64 patternRevision = 0;
+			int patternOffsetX = 0;
+			int patternOffsetY = 0;
+			std::shared_ptr<Tilemap> pattern;
+			QVector<LevelSnapshot> levels;
+			QSet<int> startTiles;
+			QVector<LevelRegion> regions;
+			Image* overlayTileset = nullptr;
+		};
+
+		QThreadPool m_threadPool;
+		std::atomic<quint64> m_generation;
+
+		std::shared_ptr<Result> m_result;
+
+		//The fill that is currently being computed
+		int m_pendingStartTileX = 0;
+		int m_pendingStartTileY = 0;
+		int m_pendingLayer = -1;
+		quint64 m_pendingPatternRevision = 0;
+		QVector<LevelSnapshot> m_pendingLevels;
+
+		static QVector<LevelSnapshot> getLevelSnapshots(const QSet<Level*>& viewLevels, int layer);
+		static bool sameLevels(const QVector<LevelSnapshot>& a, const QVector<LevelSnapshot>& b);
+		static Tilemap* tilemapAt(const QVector<LevelSnapshot>& levels, int tileX, int tileY);
+		static QSet<int> getStartTiles(const QVector<LevelSnapshot>& levels, int startTileX, int startTileY, const Tilemap* pattern);
+		static void compute(Result* request);
+
+		const LevelRegion* regionAt(int tileX, int tileY) const;
+		bool resultUsable(int startTileX, int startTileY, int layer, quint64 patternRevision) const;
+		bool resultMatches(int startTileX, int startTileY, int layer, quint64 patternRevision, const QVector<LevelSnapshot>& levels) const;
+		void applyResult(std::shared_ptr<Result> result);
+		void renderOverlay(LevelRegion& region, Image* tilesetImage);
+
+	signals:
+		void ready();
+
+	public:
+		FloodFillPreview(QObject* parent = nullptr);
+		~FloodFillPreview();
+
+		//Make sure the cached region is for this start tile. Queues a background fill if it isn't
+		void update(int startTileX, int startTileY, int layer, const Tilemap* pattern, quint64 patternRevision, const QSet<Level*>& viewLevels);
+
+		//Draw the cached region (if it is for the current start tile), leaving out excludeRect
+		void draw(QPainter* painter, const QRectF& viewRect, const QRect& excludeRect, int startTileX, int startTileY, int layer, quint64 patternRevision, Image* tilesetImage);
+	};
+};
+
+#endif
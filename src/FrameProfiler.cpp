@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <QSaveFile>
+#include <QFontDatabase>
+#include <QFontMetrics>
+#include "FrameProfiler.h"
+
+namespace TilesEditor
+{
+	FrameProfiler::FrameProfiler()
+	{
+		m_timer.start();
+	}
+
+	const char* FrameProfiler::getCounterName(Counter counter)
+	{
+		switch (counter)
+		{
+		case COUNTER_DRAW_CALLS: return "draw calls";
+		case COUNTER_TILES_DRAWN: return "tiles drawn";
+		case COUNTER_ENTITIES_SORTED: return "entities sorted";
+		case COUNTER_LEVELS_LOADED: return "levels loaded";
+		default: return "";
+		}
+	}
+
+	void FrameProfiler::setEnabled(bool value)
+	{
+		s_enabled = value;
+		m_frame = Frame();
+		m_inFrame = false;
+	}
+
+	void FrameProfiler::clear()
+	{
+		m_frames.clear();
+		m_frame = Frame();
+	}
+
+	void FrameProfiler::beginFrame()
+	{
+		if (!s_enabled)
+			return;
+
+		m_frame.start = now();
+		m_inFrame = true;
+	}
+
+	void FrameProfiler::endFrame()
+	{
+		if (!s_enabled || !m_inFrame)
+			return;
+
+		m_frame.duration = now() - m_frame.start;
+		m_inFrame = false;
+
+		m_frames.push_back(m_frame);
+		if (m_frames.size() > MAX_FRAMES)
+			m_frames.removeFirst();
+
+		m_frame = Frame();
+	}
+
+	void FrameProfiler::addEvent(const char* name, qint64 start)
+	{
+		m_frame.events.push_back(Event{ name, start, now() - start });
+	}
+
+	void FrameProfiler::addEvent(const char* name, qint64 start, qint64 duration)
+	{
+		m_frame.events.push_back(Event{ name, start, duration });
+	}
+
+	void FrameProfiler::drawOverlay(QPainter* painter, const QRect& rect) const
+	{
+		if (m_frames.isEmpty())
+			return;
+
+		auto& frame = m_frames.last();
+
+		QStringList lines;
+		lines.push_back(QString("frame %1 ms").arg(frame.duration / 1000000.0, 0, 'f', 2));
+
+		//Events with the same name (like each entity drawn) are added together, in the order they first happened
+		QVector<QPair<const char*, qint64>> totals;
+		for (auto& event : frame.events)
+		{
+			auto it = std::find_if(totals.begin(), totals.end(), [&event](const QPair<const char*, qint64>& total) {
+				return qstrcmp(total.first, event.name) == 0;
+			});
+
+			if (it != totals.end())
+				it->second += event.duration;
+			else totals.push_back(QPair<const char*, qint64>(event.name, event.duration));
+		}
+
+		for (auto& total : totals)
+			lines.push_back(QString("%1 %2 ms").arg(total.first, -16).arg(total.second / 1000000.0, 0, 'f', 2));
+
+		for (int i = 0; i < COUNTER_COUNT; ++i)
+			lines.push_back(QString("%1 %2").arg(getCounterName(Counter(i)), -16).arg(frame.counters[i]));
+
+		painter->save();
+		painter->resetTransform();
+		painter->setOpacity(1.0);
+		painter->setCompositionMode(QPainter::CompositionMode_SourceOver);
+		painter->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+		QFontMetrics fm(painter->font());
+		int width = 0;
+		for (auto& line : lines)
+			width = qMax(width, fm.horizontalAdvance(line));
+
+		QRect background(rect.x() + 8, rect.y() + 8, width + 16, fm.height() * lines.size() + 12);
+		painter->fillRect(background, QColor(0, 0, 0, 180));
+		painter->setPen(QColorConstants::White);
+
+		auto y = background.y() + 6 + fm.ascent();
+		for (auto& line : lines)
+		{
+			painter->drawText(background.x() + 8, y, line);
+			y += fm.height();
+		}
+		painter->restore();
+	}
+
+	bool FrameProfiler::saveTrace(const QString& fileName) const
+	{
+		//Written by hand, since cJSON prints large numbers with too few digits for microsecond timestamps
+		QByteArray text = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		auto first = true;
+
+		auto addEvent = [&](const char* name, qint64 start, qint64 duration) {
+			if (!first)
+				text += ',';
+			first = false;
+
+			text += "{\"name\":\"";
+			text += name;
+			text += "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":";
+			text += QByteArray::number(start / 1000.0, 'f', 3);
+			text += ",\"dur\":";
+			text += QByteArray::number(duration / 1000.0, 'f', 3);
+			text += '}';
+		};
+
+		for (auto& frame : m_frames)
+		{
+			addEvent("frame", frame.start, frame.duration);
+			for (auto& event : frame.events)
+				addEvent(event.name, event.start, event.duration);
+
+			//One counter track per counter
+			for (int i = 0; i < COUNTER_COUNT; ++i)
+			{
+				text += ",{\"name\":\"";
+				text += getCounterName(Counter(i));
+				text += "\",\"ph\":\"C\",\"pid\":1,\"tid\":1,\"ts\":";
+				text += QByteArray::number(frame.start / 1000.0, 'f', 3);
+				text += ",\"args\":{\"value\":";
+				text += QByteArray::number(frame.counters[i]);
+				text += "}}";
+			}
+		}
+		text += "]}";
+
+		QSaveFile file(fileName);
+		if (!file.open(QIODevice::WriteOnly))
+			return false;
+
+		file.write(text);
+		return file.commit();
+	}
+};
@@ -0,0 +1,159 @@
+#ifndef FRAMEPROFILERH
+#define FRAMEPROFILERH
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QVector>
+#include <QString>
+#include <QPainter>
+#include <QRect>
+
+namespace TilesEditor
+{
+	//Times the parts of each frame drawn by EditorTabWidget::renderScene, and counts what they drew. The last few hundred
+	//frames can be saved as a Chrome trace (for chrome://tracing or ui.perfetto.dev). While turned off, scopes and
+	//counters only check a bool
+	class FrameProfiler
+	{
+	public:
+		enum Counter {
+			COUNTER_DRAW_CALLS,
+			COUNTER_TILES_DRAWN,
+			COUNTER_ENTITIES_SORTED,
+			COUNTER_LEVELS_LOADED,
+			COUNTER_COUNT
+		};
+
+		//Times from construction to destruction as an event called name, which must be a string literal
+		class Scope
+		{
+		private:
+			const char* m_name;
+			qint64 m_start;
+
+		public:
+			Scope(const char* name):
+				m_name(name), m_start(s_enabled ? instance()->now() : -1) {
+			}
+
+			~Scope() {
+				end();
+			}
+
+			//Stop timing before the scope ends
+			void end() {
+				if (m_start >= 0)
+					instance()->addEvent(m_name, m_start);
+				m_start = -1;
+			}
+		};
+
+		//Adds up the time between each resume and pause, for work done a piece at a time in a loop (like drawing each
+		//entity). It becomes one event, starting at the first resume
+		class Total
+		{
+		private:
+			const char* m_name;
+			qint64 m_first = -1;
+			qint64 m_start = -1;
+			qint64 m_duration = 0;
+
+		public:
+			Total(const char* name):
+				m_name(name) {
+			}
+
+			~Total() {
+				end();
+			}
+
+			void resume() {
+				if (s_enabled)
+				{
+					m_start = instance()->now();
+					if (m_first < 0)
+						m_first = m_start;
+				}
+			}
+
+			void pause() {
+				if (m_start >= 0)
+					m_duration += instance()->now() - m_start;
+				m_start = -1;
+			}
+
+			//Add the event before the total goes out of scope
+			void end() {
+				pause();
+				if (m_first >= 0)
+					instance()->addEvent(m_name, m_first, m_duration);
+				m_first = -1;
+			}
+		};
+
+	private:
+		static const int MAX_FRAMES = 600;
+
+		//Times are nanoseconds since the profiler was created
+		struct Event {
+			const char* name;
+			qint64 start;
+			qint64 duration;
+		};
+
+		struct Frame {
+			qint64 start = 0;
+			qint64 duration = 0;
+			QVector<Event> events;
+			qint64 counters[COUNTER_COUNT] = {};
+		};
+
+		inline static bool s_enabled = false;
+
+		QElapsedTimer m_timer;
+
+		//Events and counts made between frames go to the next one
+		Frame m_frame;
+		bool m_inFrame = false;
+
+		//Finished frames, oldest first
+		QList<Frame> m_frames;
+
+		FrameProfiler();
+		qint64 now() const { return m_timer.nsecsElapsed(); }
+		void addEvent(const char* name, qint64 start);
+		void addEvent(const char* name, qint64 start, qint64 duration);
+		static const char* getCounterName(Counter counter);
+
+	public:
+		static bool isEnabled() { return s_enabled; }
+
+		//Frames recorded so far are kept, so recording can be paused
+		void setEnabled(bool value);
+		void clear();
+
+		//Whether there are any finished frames, even while recording is paused
+		bool hasFrames() const { return !m_frames.isEmpty(); }
+
+		void beginFrame();
+		void endFrame();
+
+		static void count(Counter counter, qint64 amount = 1) {
+			if (s_enabled)
+				instance()->m_frame.counters[counter] += amount;
+		}
+
+		//Draw the times and counts of the last frame in the top left of rect (in device coordinates). Call it after endFrame,
+		//so drawing the overlay isn't timed
+		void drawOverlay(QPainter* painter, const QRect& rect) const;
+
+		bool saveTrace(const QString& fileName) const;
+
+		static FrameProfiler* instance() {
+			static auto retval = new FrameProfiler();
+			return retval;
+		}
+	};
+};
+
+#endif
@@ -10,6 +10,11 @@ namespace TilesEditor
 		emit renderView(painter, rect);
 	}
 
+	void GraphicsView::drawForeground(QPainter* painter, const QRectF& rect)
+	{
+		emit renderForeground(painter, rect);
+	}
+
 
 
 	void GraphicsView::keyPressEvent(QKeyEvent* event)
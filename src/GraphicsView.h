@@ -15,6 +15,7 @@ namespace TilesEditor
 
     signals:
         void renderView(QPainter* painter, const QRectF& rect);
+        void renderForeground(QPainter* painter, const QRectF& rect);
         void mousePress(QMouseEvent* event);
         void mouseRelease(QMouseEvent* event);
         void mouseMove(QMouseEvent* event);
@@ -62,6 +63,7 @@ namespace TilesEditor
         void mouseReleaseEvent(QMouseEvent* event) override;
         void mouseDoubleClickEvent(QMouseEvent* event) override;
         void drawBackground(QPainter* painter, const QRectF& rect) override;
+        void drawForeground(QPainter* painter, const QRectF& rect) override;
 
         void keyPressEvent(QKeyEvent* event) override;
         void wheelEvent(QWheelEvent* event) override;
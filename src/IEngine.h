@@ -10,11 +10,13 @@
 namespace TilesEditor
 {
 	class Level;
+	class ThumbnailDiskCache;
 	class IEngine
 	{
 	public:
 		virtual ObjectManager* getObjectManager() = 0;
 		virtual AbstractResourceManager* getResourceManager() = 0;
+		virtual ThumbnailDiskCache* getThumbnailDiskCache() = 0;
 		virtual QString parseInlineString(const QString& expression) = 0;
 		virtual QString parseExpression(const QString& expression) = 0;
 		virtual bool testCodeForErrors(const QString& code, QString* errorOutput, ScriptingLanguage language) = 0;
@@ -15,6 +15,9 @@ namespace TilesEditor
 		virtual int search(const QRectF& rect, bool accurate, QList<T*>& output, bool (*f)(T*, void* userData) = nullptr, void* userData = nullptr) = 0;
 		virtual int search(const QRectF& rect, bool accurate, QSet<T*>& output, bool (*f)(T*, void* userData) = nullptr, void* userData = nullptr) = 0;
 
+		//Same as search, but appends the entities in draw order (lowest getRealDepth first)
+		virtual int searchOrdered(const QRectF& rect, bool accurate, QList<T*>& output, bool (*f)(T*, void* userData) = nullptr, void* userData = nullptr) = 0;
+
 		virtual T* searchFirst(const QRectF& rect, bool accurate, bool (*f)(T*, void* userData) = nullptr, void* userData = nullptr) = 0;
 
 
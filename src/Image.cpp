@@ -1,8 +1,52 @@
+#include <atomic>
 #include <QPainter>
 #include "Image.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IMAGE_SSE2
+#endif
+
 namespace TilesEditor
 {
+    //Multiply the colour channels of premultiplied argb pixels by red, green and blue (0-255), rounding like QColor does.
+    //Alpha is multiplied by 255, so it stays the same
+    static void modulateRow(QRgb* pixels, int count, int red, int green, int blue)
+    {
+        int i = 0;
+
+#ifdef IMAGE_SSE2
+        //4 pixels at a time, as 16 bit lanes (b, g, r, a in memory order)
+        auto zero = _mm_setzero_si128();
+        auto factors = _mm_setr_epi16(blue, green, red, 255, blue, green, red, 255);
+        auto half = _mm_set1_epi16(128);
+
+        auto modulate = [&](__m128i channels) {
+            auto x = _mm_add_epi16(_mm_mullo_epi16(channels, factors), half);
+            return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+        };
+
+        for (; i + 4 <= count; i += 4)
+        {
+            auto data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i));
+            auto low = modulate(_mm_unpacklo_epi8(data, zero));
+            auto high = modulate(_mm_unpackhi_epi8(data, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i), _mm_packus_epi16(low, high));
+        }
+#endif
+
+        auto multiply = [](int channel, int factor) {
+            auto x = channel * factor + 128;
+            return (x + (x >> 8)) >> 8;
+        };
+
+        for (; i < count; ++i)
+        {
+            auto pixel = pixels[i];
+            pixels[i] = qRgba(multiply(qRed(pixel), red), multiply(qGreen(pixel), green), multiply(qBlue(pixel), blue), qAlpha(pixel));
+        }
+    }
+
     char Image::getColourIndex(QRgb colour) const
     {
         for (int i = 0; i < m_image.colorCount(); ++i)
@@ -22,13 +66,19 @@ namespace TilesEditor
         m_bodyColourIndex[BODY_SHOES] = getColourIndex(qRgb(206, 24, 41));
     }
 
+    quint64 Image::nextVersion()
+    {
+        static std::atomic<quint64> version = 0;
+        return ++version;
+    }
+
     Image::Image(const QString& assetName):
-        Resource(assetName)
+        Resource(assetName), m_version(nextVersion())
     {
     }
 
     Image::Image(const QString& assetName, QImage image):
-        Resource(assetName)
+        Resource(assetName), m_version(nextVersion())
     {
         m_image = image;
         m_pixmap = QPixmap::fromImage(image);
@@ -37,34 +87,27 @@ namespace TilesEditor
 
     QPixmap Image::colorMod(const QColor& modColor, const QRect& srcRect)
     {
-        // Check if the source rectangle (srcRect) is null (empty or invalid).
-        // If it is null, use the entire image (m_pixmap) and convert it to a QImage.
-        // Otherwise, copy the specified region (srcRect) from m_pixmap and convert it to a QImage.
-        QImage image = srcRect.isNull() ? m_pixmap.toImage() : m_pixmap.copy(m_image.rect().intersected(srcRect)).toImage();
+        auto rect = srcRect.isNull() ? m_image.rect() : m_image.rect().intersected(srcRect);
+        ColorModKey key{ rect, modColor.rgb() };
 
-        // Loop through each pixel in the image row by row (y-axis).
-        for (int y = 0; y < image.height(); ++y)
+        auto it = m_colorMods.constFind(key);
+        if (it != m_colorMods.cend())
+            return it.value();
+
+        auto image = premultipliedImage().copy(rect);
+        if (!image.isNull())
         {
-            // Loop through each pixel in the current row column by column (x-axis).
-            for (int x = 0; x < image.width(); ++x)
-            {
-                // Get the color of the current pixel at (x, y).
-                QColor color(image.pixelColor(x, y));
-
-                // Modify the pixel's red, green, and blue components by multiplying them
-                // with the corresponding normalized (0.0 to 1.0) components of modColor.
-                // This effectively applies a color filter to the pixel.
-                color.setRedF(color.redF() * modColor.redF());    // Adjust red component
-                color.setGreenF(color.greenF() * modColor.greenF()); // Adjust green component
-                color.setBlueF(color.blueF() * modColor.blueF());   // Adjust blue component
-
-                // Set the modified color back to the pixel at (x, y).
-                image.setPixelColor(x, y, color);
-            }
+            for (int y = 0; y < image.height(); ++y)
+                modulateRow(reinterpret_cast<QRgb*>(image.scanLine(y)), image.width(), modColor.red(), modColor.green(), modColor.blue());
         }
 
-        // Convert the modified QImage back to a QPixmap and return it.
-        return QPixmap::fromImage(image);
+        //Effects are usually a handful of colours per image, so when there are too many just start over
+        if (m_colorMods.size() >= MAX_COLOR_MODS)
+            m_colorMods.clear();
+
+        auto retval = QPixmap::fromImage(image);
+        m_colorMods.insert(key, retval);
+        return retval;
     }
 
     void Image::replace(QIODevice* stream, AbstractResourceManager* resourceManager)
@@ -72,11 +115,32 @@ namespace TilesEditor
         QImage image;
 
         if (image.loadFromData(stream->readAll()))
-        {
-            m_image = image;
-            m_pixmap = QPixmap::fromImage(m_image);
-            calculateBodyColourIndexes();
-        }
+            setImage(image);
+    }
+
+    void Image::setImage(const QImage& image)
+    {
+        m_image = image;
+        m_pixmap = QPixmap::fromImage(m_image);
+        m_premultipliedImage = QImage();
+        m_colorMods.clear();
+        m_version = nextVersion();
+        calculateBodyColourIndexes();
+    }
+
+    const QImage& Image::premultipliedImage()
+    {
+        if (m_premultipliedImage.isNull() && !m_image.isNull())
+            m_premultipliedImage = m_image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        return m_premultipliedImage;
+    }
+
+    qint64 Image::getMemoryUsage() const
+    {
+        auto retval = m_image.sizeInBytes() + m_premultipliedImage.sizeInBytes() + qint64(m_pixmap.width()) * m_pixmap.height() * (m_pixmap.depth() / 8);
+        for (auto& pixmap : m_colorMods)
+            retval += qint64(pixmap.width()) * pixmap.height() * (pixmap.depth() / 8);
+        return retval;
     }
 
     void Image::draw(QPainter* painter, double x, double y)
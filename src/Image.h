@@ -4,6 +4,8 @@
 #include <QImage>
 #include <QPixmap>
 #include <QByteArray>
+#include <QHash>
+#include <QRect>
 #include "Resource.h"
 #include "ResourceType.h"
 
@@ -22,6 +24,24 @@ namespace TilesEditor
 	private:
 		QImage	m_image;
 		QPixmap m_pixmap;
+
+		//m_image converted for TileBlitter, made the first time it is needed
+		QImage m_premultipliedImage;
+
+		//colorMod results, shared by everything drawing this image with the same colour. Cleared when the image changes
+		struct ColorModKey {
+			QRect rect;
+			QRgb colour;
+
+			bool operator==(const ColorModKey& other) const { return rect == other.rect && colour == other.colour; }
+		};
+		friend size_t qHash(const ColorModKey& key, size_t seed) { return qHashMulti(seed, key.rect.x(), key.rect.y(), key.rect.width(), key.rect.height(), key.colour); }
+
+		static const int MAX_COLOR_MODS = 64;
+		QHash<ColorModKey, QPixmap> m_colorMods;
+
+		quint64 m_version;
+		static quint64 nextVersion();
 	
 		char m_bodyColourIndex[5];
 
@@ -40,6 +60,15 @@ namespace TilesEditor
 			return m_image;
 		}
 
+		const QImage& premultipliedImage();
+
+		//Changes whenever the image does, and is never the same for two images. For caches of things drawn with it
+		quint64 getVersion() const { return m_version; }
+
+		//Replace the image (pixmap and body colours too). Must be called on the main thread
+		void setImage(const QImage& image);
+
+		//The image (or srcRect of it) with its colour channels multiplied by modColor's. Alpha is left alone
 		QPixmap colorMod(const QColor& modColor, const QRect& srcRect = QRect());
 		ResourceType getResourceType() const override {
 			return ResourceType::RESOURCE_IMAGE;
@@ -58,6 +87,7 @@ namespace TilesEditor
 		}
 
 		void replace(QIODevice* stream, AbstractResourceManager* resourceManager) override;
+		qint64 getMemoryUsage() const override;
 		void draw(QPainter* painter, double x, double y);
 		void draw(QPainter* painter, double x, double y, int left, int top, int width, int height);
 		void drawColourMod(QPainter* painter, double x, double y, int left, int top, int width, int height, const QColor& color);
@@ -0,0 +1,375 @@
+#include <cstring>
+#include "JsonStreamReader.h"
+
+namespace TilesEditor
+{
+	JsonStreamReader::JsonStreamReader(QIODevice* device):
+		m_device(device)
+	{
+	}
+
+	bool JsonStreamReader::fill()
+	{
+		if (m_pos < m_buffer.size())
+			return true;
+
+		m_buffer = m_device->read(BLOCK_SIZE);
+		m_pos = 0;
+		return !m_buffer.isEmpty();
+	}
+
+	int JsonStreamReader::peekChar()
+	{
+		if (!fill())
+			return -1;
+		return (unsigned char)m_buffer[m_pos];
+	}
+
+	void JsonStreamReader::skipWhitespace()
+	{
+		while (fill())
+		{
+			auto c = (unsigned char)m_buffer[m_pos];
+			if (c > ' ')
+				return;
+			++m_pos;
+		}
+	}
+
+	JsonStreamReader::Token JsonStreamReader::setError()
+	{
+		m_token = Token::Error;
+		return m_token;
+	}
+
+	bool JsonStreamReader::readString()
+	{
+		//Opening quote
+		++m_pos;
+		m_string.clear();
+
+		for (;;)
+		{
+			if (!fill())
+				return false;
+
+			//Copy everything up to the next quote or escape in one go
+			auto start = m_pos;
+			auto size = m_buffer.size();
+			auto data = m_buffer.constData();
+			while (m_pos < size && data[m_pos] != '"' && data[m_pos] != '\\')
+				++m_pos;
+			m_string.append(data + start, m_pos - start);
+
+			if (m_pos >= size)
+				continue;
+
+			if (data[m_pos++] == '"')
+				return true;
+
+			auto c = peekChar();
+			if (c < 0)
+				return false;
+			++m_pos;
+
+			switch (c)
+			{
+			case 'b': m_string.append('\b'); break;
+			case 'f': m_string.append('\f'); break;
+			case 'n': m_string.append('\n'); break;
+			case 'r': m_string.append('\r'); break;
+			case 't': m_string.append('\t'); break;
+			case 'u':
+			{
+				auto readHex = [this](uint* retval) -> bool {
+					*retval = 0;
+					for (int i = 0; i < 4; ++i)
+					{
+						auto c = peekChar();
+						if (c < 0)
+							return false;
+						++m_pos;
+
+						*retval <<= 4;
+						if (c >= '0' && c <= '9') *retval |= c - '0';
+						else if (c >= 'a' && c <= 'f') *retval |= c - 'a' + 10;
+						else if (c >= 'A' && c <= 'F') *retval |= c - 'A' + 10;
+						else return false;
+					}
+					return true;
+				};
+
+				uint code = 0;
+				if (!readHex(&code))
+					return false;
+
+				//Surrogate pair
+				if (code >= 0xD800 && code <= 0xDBFF)
+				{
+					uint low = 0;
+					if (peekChar() != '\\')
+						return false;
+					++m_pos;
+					if (peekChar() != 'u')
+						return false;
+					++m_pos;
+					if (!readHex(&low) || low < 0xDC00 || low > 0xDFFF)
+						return false;
+					code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+				}
+
+				//Utf8 encode
+				if (code < 0x80)
+					m_string.append(char(code));
+				else if (code < 0x800)
+				{
+					m_string.append(char(0xC0 | (code >> 6)));
+					m_string.append(char(0x80 | (code & 0x3F)));
+				}
+				else if (code < 0x10000)
+				{
+					m_string.append(char(0xE0 | (code >> 12)));
+					m_string.append(char(0x80 | ((code >> 6) & 0x3F)));
+					m_string.append(char(0x80 | (code & 0x3F)));
+				}
+				else {
+					m_string.append(char(0xF0 | (code >> 18)));
+					m_string.append(char(0x80 | ((code >> 12) & 0x3F)));
+					m_string.append(char(0x80 | ((code >> 6) & 0x3F)));
+					m_string.append(char(0x80 | (code & 0x3F)));
+				}
+				break;
+			}
+
+			//Covers \" \\ and \/
+			default: m_string.append(char(c)); break;
+			}
+		}
+	}
+
+	bool JsonStreamReader::readNumber()
+	{
+		char text[64];
+		int length = 0;
+
+		for (;;)
+		{
+			auto c = peekChar();
+			if (!((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E'))
+				break;
+
+			if (length == sizeof(text) - 1)
+				return false;
+			text[length++] = char(c);
+			++m_pos;
+		}
+
+		bool ok = false;
+		m_number = QByteArray::fromRawData(text, length).toDouble(&ok);
+		return ok;
+	}
+
+	bool JsonStreamReader::readLiteral(const char* literal)
+	{
+		for (; *literal; ++literal)
+		{
+			if (peekChar() != *literal)
+				return false;
+			++m_pos;
+		}
+		return true;
+	}
+
+	JsonStreamReader::Token JsonStreamReader::readNext()
+	{
+		if (m_token == Token::Error || m_token == Token::EndOfDocument)
+			return m_token;
+
+		//Skip the utf-8 byte order mark
+		if (m_token == Token::None && fill() && m_buffer.startsWith("\xEF\xBB\xBF"))
+			m_pos += 3;
+
+		m_isKey = false;
+		skipWhitespace();
+		auto c = peekChar();
+
+		//End of the container we are in
+		if (!m_stack.isEmpty() && (c == '}' || c == ']') && !m_haveKey)
+		{
+			if (m_stack.last() != (c == '}' ? '{' : '['))
+				return setError();
+
+			++m_pos;
+			m_stack.removeLast();
+			m_needSeparator = true;
+			m_token = c == '}' ? Token::EndObject : Token::EndArray;
+			return m_token;
+		}
+
+		if (m_needSeparator)
+		{
+			//The root value is done. Anything after it is ignored, like cJSON_Parse does
+			if (m_stack.isEmpty())
+			{
+				m_token = Token::EndOfDocument;
+				return m_token;
+			}
+
+			if (c != ',')
+				return setError();
+			++m_pos;
+			m_needSeparator = false;
+
+			skipWhitespace();
+			c = peekChar();
+		}
+
+		if (c < 0)
+			return setError();
+
+		//Object key, and the colon after it
+		if (!m_stack.isEmpty() && m_stack.last() == '{' && !m_haveKey)
+		{
+			if (c != '"' || !readString())
+				return setError();
+
+			skipWhitespace();
+			if (peekChar() != ':')
+				return setError();
+			++m_pos;
+
+			m_haveKey = true;
+			m_isKey = true;
+			m_token = Token::String;
+			return m_token;
+		}
+
+		m_haveKey = false;
+		m_needSeparator = true;
+		switch (c)
+		{
+		case '{':
+			++m_pos;
+			m_stack.append('{');
+			m_needSeparator = false;
+			m_token = Token::BeginObject;
+			break;
+
+		case '[':
+			++m_pos;
+			m_stack.append('[');
+			m_needSeparator = false;
+			m_token = Token::BeginArray;
+			break;
+
+		case '"':
+			if (!readString())
+				return setError();
+			m_token = Token::String;
+			break;
+
+		case 't':
+			if (!readLiteral("true"))
+				return setError();
+			m_token = Token::True;
+			break;
+
+		case 'f':
+			if (!readLiteral("false"))
+				return setError();
+			m_token = Token::False;
+			break;
+
+		case 'n':
+			if (!readLiteral("null"))
+				return setError();
+			m_token = Token::Null;
+			break;
+
+		default:
+			if (!((c >= '0' && c <= '9') || c == '-') || !readNumber())
+				return setError();
+			m_token = Token::Number;
+			break;
+		}
+		return m_token;
+	}
+
+	bool JsonStreamReader::keyEquals(const char* key) const
+	{
+		if (!isKey() || qsizetype(strlen(key)) != m_string.size())
+			return false;
+		return qstrnicmp(m_string.constData(), key, m_string.size()) == 0;
+	}
+
+	void JsonStreamReader::skipValue()
+	{
+		if (isKey())
+			readNext();
+
+		if (m_token == Token::BeginObject || m_token == Token::BeginArray)
+		{
+			auto depth = m_stack.size();
+			while (m_stack.size() >= depth)
+			{
+				auto token = readNext();
+				if (token == Token::Error || token == Token::EndOfDocument)
+					return;
+			}
+		}
+	}
+
+	cJSON* JsonStreamReader::readValue()
+	{
+		if (isKey())
+			readNext();
+
+		switch (m_token)
+		{
+		case Token::String: return cJSON_CreateString(m_string.constData());
+		case Token::Number: return cJSON_CreateNumber(m_number);
+		case Token::True: return cJSON_CreateTrue();
+		case Token::False: return cJSON_CreateFalse();
+		case Token::Null: return cJSON_CreateNull();
+
+		case Token::BeginArray:
+		{
+			auto retval = cJSON_CreateArray();
+			while (readNext() != Token::EndArray)
+			{
+				auto item = m_token != Token::Error ? readValue() : nullptr;
+				if (item == nullptr)
+				{
+					cJSON_Delete(retval);
+					return nullptr;
+				}
+				cJSON_AddItemToArray(retval, item);
+			}
+			return retval;
+		}
+
+		case Token::BeginObject:
+		{
+			auto retval = cJSON_CreateObject();
+			while (readNext() != Token::EndObject)
+			{
+				QByteArray key = m_string;
+				cJSON* item = nullptr;
+				if (isKey() && readNext() != Token::Error)
+					item = readValue();
+
+				if (item == nullptr)
+				{
+					cJSON_Delete(retval);
+					return nullptr;
+				}
+				cJSON_AddItemToObject(retval, key.constData(), item);
+			}
+			return retval;
+		}
+
+		default:
+			return nullptr;
+		}
+	}
+};
@@ -0,0 +1,88 @@
+#ifndef JSONSTREAMREADERH
+#define JSONSTREAMREADERH
+
+#include <QIODevice>
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include "cJSON/cJSON.h"
+
+namespace TilesEditor
+{
+	//Reads json one token at a time from a device, without building a tree. Only the block of the file being
+	//read and the current string are held in memory. Values that are easier to handle as a tree
+	//(like a single entity) can still be read as one with readValue
+	class JsonStreamReader
+	{
+	public:
+		enum class Token {
+			None,
+			BeginObject,
+			EndObject,
+			BeginArray,
+			EndArray,
+			String,
+			Number,
+			True,
+			False,
+			Null,
+			EndOfDocument,
+			Error
+		};
+
+	private:
+		static const qint64 BLOCK_SIZE = 64 * 1024;
+
+		QIODevice* m_device;
+		QByteArray m_buffer;
+		qsizetype m_pos = 0;
+
+		Token m_token = Token::None;
+		QByteArray m_string;
+		double m_number = 0.0;
+		bool m_isKey = false;
+
+		//'{' or '[' for each container we are in
+		QVector<char> m_stack;
+		bool m_needSeparator = false;
+		bool m_haveKey = false;
+
+		bool fill();
+		int peekChar();
+		void skipWhitespace();
+
+		Token setError();
+		bool readString();
+		bool readNumber();
+		bool readLiteral(const char* literal);
+
+	public:
+		JsonStreamReader(QIODevice* device);
+
+		Token readNext();
+		Token token() const { return m_token; }
+		bool hasError() const { return m_token == Token::Error; }
+
+		//Containers the current token is inside of (a BeginObject token counts its own object)
+		int depth() const { return m_stack.size(); }
+
+		//True if the current string is an object key. The next token is its value
+		bool isKey() const { return m_token == Token::String && m_isKey; }
+
+		//Matches keys the same way cJSON_GetObjectItem does (ignoring case)
+		bool keyEquals(const char* key) const;
+
+		const QByteArray& stringValue() const { return m_string; }
+		QString toString() const { return QString::fromUtf8(m_string); }
+		double numberValue() const { return m_number; }
+		int intValue() const { return int(m_number); }
+
+		//Skip past the current value. On a key, skips the value that follows it
+		void skipValue();
+
+		//The current value as a tree, or nullptr on a syntax error. The caller owns it
+		cJSON* readValue();
+	};
+};
+
+#endif
@@ -2,7 +2,6 @@
 #include <QTextStream>
 #include <QStringBuilder>
 #include <QFile>
-#include <QThread>
 #include <QBuffer>
 #include "Level.h"
 #include "ImageDimensions.h"
@@ -18,6 +17,9 @@
 #include "cJSON/JsonHelper.h"
 #include "FileFormatManager.h"
 #include "StringHash.h"
+#include "TileBlitter.h"
+#include "LevelSnapshotCache.h"
+#include "FrameProfiler.h"
 
 namespace TilesEditor
 {
@@ -79,7 +81,7 @@ namespace TilesEditor
         m_mainTileLayer = nullptr;
         if (!m_overworld)
         {
-            m_entitySpatialMap = new EntitySpatialGrid<AbstractLevelEntity>(getX(), getY(), getWidth(), getHeight());
+            m_entitySpatialMap = new FlatEntitySpatialGrid<AbstractLevelEntity>(getX(), getY(), getWidth(), getHeight());
 
         }
 
@@ -108,6 +110,39 @@ namespace TilesEditor
         }
 
         removeTileDefs();
+
+        for (auto tilemap : m_tileLayers)
+            tilemap->releaseRenderCache();
+    }
+
+    void Level::unload()
+    {
+        release();
+
+        for (auto entity : m_objects)
+        {
+            removeEntityFromSpatialMap(entity);
+            delete entity;
+        }
+        m_objects.clear();
+        m_links.clear();
+        m_signs.clear();
+
+        for (auto tilemap : m_tileLayers)
+            tilemap->decrementAndDelete();
+        m_tileLayers.clear();
+        m_mainTileLayer = nullptr;
+
+        setLoadState(LoadState::STATE_NOT_LOADED);
+    }
+
+    qint64 Level::getMemoryUsage() const
+    {
+        //Entities are only a rough guess. Their images are shared through the resource manager
+        qint64 retval = sizeof(Level) + m_objects.size() * 256;
+        for (auto tilemap : m_tileLayers)
+            retval += tilemap->getMemoryUsage();
+        return retval;
     }
 
 
@@ -124,25 +159,44 @@ namespace TilesEditor
     {
 
         setLoadState(LoadState::STATE_LOADING);
-        if (threaded)
+        //Overworld levels are queued on the overworld's loader. Everything else loads straight away
+        if (threaded && m_overworld)
         {
-
-            QThread* thread = new QThread();
-            auto fileLoader = new FileDataLoader(m_world->getResourceManager(), m_fileName);
-
-            fileLoader->moveToThread(thread);
-            QObject::connect(thread, &QThread::started, fileLoader, &FileDataLoader::start);
-            QObject::connect(fileLoader, &FileDataLoader::finished, this, &Level::loadFileData);
-            QObject::connect(thread, &QThread::finished, thread, &QThread::deleteLater);
-            QObject::connect(thread, &QThread::finished, fileLoader, &FileDataLoader::deleteLater);
-            thread->start();
+            m_overworld->getLoadScheduler()->requestLoad(this);
             return true;
         }
         else {
+            auto formats = FileFormatManager::instance();
+            auto canParse = formats->canParseLevel(m_name);
+
+            //Unchanged levels are read from their snapshot without parsing
+            auto snapshots = LevelSnapshotCache::instance();
+            auto tilesetHash = canParse && snapshots->isEnabled() ? LevelSnapshotCache::getTilesetHash(m_defaultTileset) : QByteArray();
+
+            LevelModel model;
+            if (canParse && snapshots->load(m_fileName, tilesetHash, &model))
+            {
+                loadModel(model);
+                return true;
+            }
+
             auto stream = m_world->getResourceManager()->openStreamFullPath(m_fileName, QIODeviceBase::ReadOnly);
             if (stream)
             {
-                loadStream(stream);
+                if (canParse)
+                {
+                    auto fileData = stream->readAll();
+                    QBuffer dataStream(&fileData);
+                    dataStream.open(QIODeviceBase::ReadOnly);
+
+                    if (formats->parseLevel(m_name, &model, m_defaultTileset, &dataStream))
+                    {
+                        snapshots->save(m_fileName, tilesetHash, fileData, model);
+                        loadModel(model);
+                    }
+                    else loadFileData(fileData);
+                }
+                else loadStream(stream);
                 delete stream;
             }
             else setLoadState(LoadState::STATE_FAILED);
@@ -161,6 +215,81 @@ namespace TilesEditor
         return loaded;
     }
 
+    void Level::loadModel(const LevelModel& model)
+    {
+        FileFormatManager::instance()->applyFormat(this);
+        applyModel(model);
+
+        setLoadState(LoadState::STATE_LOADED);
+        getWorld()->getEngine()->applyTileDefs(this);
+
+        m_world->redrawScene(QRectF(this->getX(), this->getY(), this->getWidth(), this->getHeight()));
+    }
+
+    void Level::applyModel(const LevelModel& model)
+    {
+        if (model.hasTilesetName)
+            setTilesetName(model.tilesetName);
+
+        if (model.hasTilesetImageName)
+            setTilesetImageName(model.tilesetImageName);
+
+        setSize(model.width, model.height);
+
+        for (auto it = model.tileLayers.begin(); it != model.tileLayers.end(); ++it)
+        {
+            auto& tileLayer = it.value();
+            getOrMakeTilemap(it.key())->setTiles(tileLayer.tiles, tileLayer.hcount, tileLayer.vcount);
+        }
+
+        for (auto& link : model.links)
+        {
+            auto levelLink = new LevelLink(m_world, getX() + link.x, getY() + link.y, link.width, link.height, link.possibleEdgeLink);
+            levelLink->setLevel(this);
+            levelLink->setNextLevel(link.nextLevel);
+            levelLink->setNextX(link.nextX);
+            levelLink->setNextY(link.nextY);
+            levelLink->setNextLayer(link.nextLayer);
+            levelLink->setLayerIndex(link.layerIndex);
+
+            addObject(levelLink);
+        }
+
+        for (auto& chest : model.chests)
+        {
+            auto levelChest = new LevelChest(m_world, getX() + chest.x, getY() + chest.y, chest.itemName, chest.signIndex);
+            levelChest->setLayerIndex(chest.layerIndex);
+            levelChest->setLevel(this);
+
+            addObject(levelChest);
+        }
+
+        for (auto& baddy : model.baddies)
+        {
+            auto levelBaddy = new LevelGraalBaddy(m_world, getX() + baddy.x, getY() + baddy.y, baddy.type);
+            levelBaddy->setLayerIndex(baddy.layerIndex);
+            levelBaddy->setLevel(this);
+
+            for (int i = 0; i < baddy.verses.size(); ++i)
+                levelBaddy->setBaddyVerse(i, baddy.verses[i]);
+
+            addObject(levelBaddy);
+        }
+
+        for (auto& sign : model.signs)
+        {
+            auto levelSign = new LevelSign(m_world, getX() + sign.x, getY() + sign.y, 32, 16);
+            levelSign->setLayerIndex(sign.layerIndex);
+            levelSign->setLevel(this);
+            levelSign->setText(sign.text);
+
+            addObject(levelSign);
+        }
+
+        for (auto& npc : model.npcs)
+            AbstractLevelFormat::createNPC(this, npc.image, npc.x, npc.y, npc.code);
+    }
+
     bool Level::saveFile(IFileRequester* requester)
     {
         auto stream = m_world->getResourceManager()->openStreamFullPath(m_fileName, QIODevice::WriteOnly);
@@ -187,7 +316,7 @@ namespace TilesEditor
 
         if (m_entitySpatialMap) {
             delete m_entitySpatialMap;
-            m_entitySpatialMap = new EntitySpatialGrid<AbstractLevelEntity>(getX(), getY(), getWidth(), getHeight());
+            m_entitySpatialMap = new FlatEntitySpatialGrid<AbstractLevelEntity>(getX(), getY(), getWidth(), getHeight());
         }
     }
 
@@ -336,6 +465,9 @@ namespace TilesEditor
             getWorld()->getResourceManager()->freeResource(pair.second);
         }
         m_tileDefs.clear();
+
+        rebuildTileDefLookup();
+        invalidateTileRenderCache();
     }
 
 
@@ -359,115 +491,289 @@ namespace TilesEditor
         {
             m_tileDefs.push_back(QPair<QRect, Image*>(QRect(tileDef.x, tileDef.y, image->width(), image->height()), image));
         }
+
+        rebuildTileDefLookup();
+        invalidateTileRenderCache();
+    }
+
+    void Level::rebuildTileDefLookup()
+    {
+        ++m_tileDefsRevision;
+        m_tileDefLookupBounds = QRect();
+        m_tileDefLookup.clear();
+
+        //Tileset tiles that lie completely inside each tile def (tile x/y are 10 bits in the tile encoding)
+        auto getTileRange = [](const QRect& rect) -> QRect {
+            int left = qMax((rect.x() + 15) / 16, 0);
+            int top = qMax((rect.y() + 15) / 16, 0);
+            int right = qMin((rect.x() + rect.width()) / 16, 0x400);
+            int bottom = qMin((rect.y() + rect.height()) / 16, 0x400);
+
+            if (right <= left || bottom <= top)
+                return QRect();
+            return QRect(left, top, right - left, bottom - top);
+        };
+
+        for (auto& pair : m_tileDefs)
+        {
+            if (pair.second)
+                m_tileDefLookupBounds = m_tileDefLookupBounds.united(getTileRange(pair.first));
+        }
+
+        if (m_tileDefLookupBounds.isEmpty())
+        {
+            m_tileDefLookupBounds = QRect();
+            return;
+        }
+
+        m_tileDefLookup.fill(-1, m_tileDefLookupBounds.width() * m_tileDefLookupBounds.height());
+
+        //Later tile defs take priority over earlier ones
+        for (auto i = 0; i < m_tileDefs.size(); ++i)
+        {
+            if (!m_tileDefs[i].second)
+                continue;
+
+            auto range = getTileRange(m_tileDefs[i].first);
+            for (auto y = range.top(); y <= range.bottom(); ++y)
+            {
+                auto row = (y - m_tileDefLookupBounds.y()) * m_tileDefLookupBounds.width() - m_tileDefLookupBounds.x();
+                for (auto x = range.left(); x <= range.right(); ++x)
+                    m_tileDefLookup[row + x] = i;
+            }
+        }
+    }
+
+    void Level::invalidateTileRenderCache()
+    {
+        for (auto tilemap : m_tileLayers)
+            tilemap->invalidateRenderCache();
     }
 
     void Level::drawTile(double x, double y, Image* tilesetImage, int tileLeft, int tileTop, QPainter* painter)
     {
         QRect srcRect(tileLeft * 16, tileTop * 16, 16, 16);
-        if (m_tileDefs.size() > 0)
+
+        auto tileDef = getTileDef(tileLeft, tileTop);
+        if (tileDef)
+        {
+            srcRect.moveTo(srcRect.x() - tileDef->first.x(), srcRect.y() - tileDef->first.y());
+            painter->drawPixmap(QPoint(x, y), tileDef->second->pixmap(), srcRect);
+            return;
+        }
+
+        painter->drawPixmap(QPoint(x, y), tilesetImage->pixmap(), srcRect);
+    }
+
+    void Level::drawTilemap(Tilemap* tilemap, Image* tilesetImage, double x, double y, QPainter* painter, const QRectF& viewRect)
+    {
+        if (tilesetImage == nullptr)
+            return;
+
+        //Tilemaps that don't belong to this level (selections, tile objects, patterns) are drawn tile-by-tile
+        if (tilemap->getLevel() != this)
         {
-            for (auto it = m_tileDefs.rbegin(); it != m_tileDefs.rend(); ++it)
+            int tileWidth = 16;
+            int tileHeight = 16;
+
+            int left = qAbs((int)qFloor((qMax((int)(viewRect.x() - x), 0) / tileWidth)));
+            int top = qAbs((int)qFloor((qMax((int)(viewRect.y() - y), 0) / tileHeight)));
+            int right = qMin((int)qCeil((viewRect.right() - x) / tileWidth), (int)tilemap->getHCount());
+            int bottom = qMin((int)qCeil((viewRect.bottom() - y) / tileWidth), (int)tilemap->getVCount());
+
+
+            //keep within map dimensions
+            left = left > tilemap->getHCount() - 1 ? tilemap->getHCount() - 1 : left;
+            top = top > tilemap->getVCount() - 1 ? tilemap->getVCount() - 1 : top;
+            right = right > tilemap->getHCount() - 1 ? tilemap->getHCount() - 1 : right;
+            bottom = bottom > tilemap->getVCount() - 1 ? tilemap->getVCount() - 1 : bottom;
+
+            drawTilemapTiles(tilemap, tilesetImage, x, y, painter, left, top, right, bottom);
+            return;
+        }
+
+        int chunkWidth = Tilemap::RENDER_CHUNK_SIZE * 16;
+        int chunkHeight = Tilemap::RENDER_CHUNK_SIZE * 16;
+
+        int left = qMax(qFloor((viewRect.x() - x) / chunkWidth), 0);
+        int top = qMax(qFloor((viewRect.y() - y) / chunkHeight), 0);
+        int right = qMin(qCeil((viewRect.right() - x) / chunkWidth), tilemap->getRenderChunksHCount());
+        int bottom = qMin(qCeil((viewRect.bottom() - y) / chunkHeight), tilemap->getRenderChunksVCount());
+
+        for (int chunkY = top; chunkY < bottom; ++chunkY)
+        {
+            for (int chunkX = left; chunkX < right; ++chunkX)
             {
-                auto& pair = *it;
-                if (pair.second && pair.first.contains(srcRect))
+                auto chunk = tilemap->getRenderChunk(chunkX, chunkY, tilesetImage);
+                if (chunk->dirty)
+                    renderTilemapChunk(tilemap, tilesetImage, chunkX, chunkY, chunk);
+
+                if (!chunk->empty)
                 {
-                    srcRect.moveTo(srcRect.x() - pair.first.x(), srcRect.y() - pair.first.y());
-                    painter->drawPixmap(QPoint(x, y), pair.second->pixmap(), srcRect);
-                    return;
+                    painter->drawImage(QPoint(x + (chunkX * chunkWidth), y + (chunkY * chunkHeight)), chunk->image);
+
+                    FrameProfiler::count(FrameProfiler::COUNTER_DRAW_CALLS);
+                    FrameProfiler::count(FrameProfiler::COUNTER_TILES_DRAWN, qMin(Tilemap::RENDER_CHUNK_SIZE, (int)tilemap->getHCount() - chunkX * Tilemap::RENDER_CHUNK_SIZE) * qMin(Tilemap::RENDER_CHUNK_SIZE, (int)tilemap->getVCount() - chunkY * Tilemap::RENDER_CHUNK_SIZE));
                 }
             }
         }
+    }
 
-        painter->drawPixmap(QPoint(x, y), tilesetImage->pixmap(), srcRect);
+    void Level::compositeTilemap(Tilemap* tilemap, Image* tilesetImage, double x, double y, QPainter* painter, const QRectF& viewRect)
+    {
+        if (tilesetImage == nullptr)
+            return;
+
+        int left = qMax(qFloor((viewRect.x() - x) / 16), 0);
+        int top = qMax(qFloor((viewRect.y() - y) / 16), 0);
+        int right = qMin(qCeil((viewRect.right() - x) / 16), (int)tilemap->getHCount()) - 1;
+        int bottom = qMin(qCeil((viewRect.bottom() - y) / 16), (int)tilemap->getVCount()) - 1;
+
+        if (right < left || bottom < top)
+            return;
+
+        QImage image((right - left + 1) * 16, (bottom - top + 1) * 16, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+
+        blitTilemapTiles(tilemap, tilesetImage, -left * 16, -top * 16, &image, left, top, right, bottom);
+        painter->drawImage(QPointF(x + left * 16, y + top * 16), image);
     }
 
-    void Level::drawTilemap(Tilemap* tilemap, Image* tilesetImage, double x, double y, QPainter* painter, const QRectF& viewRect)
+    void Level::renderTilemapChunk(Tilemap* tilemap, Image* tilesetImage, int chunkX, int chunkY, Tilemap::RenderChunk* chunk)
     {
-        qreal startOpacity = painter->opacity();
+        int left = chunkX * Tilemap::RENDER_CHUNK_SIZE;
+        int top = chunkY * Tilemap::RENDER_CHUNK_SIZE;
+        int hcount = qMin(Tilemap::RENDER_CHUNK_SIZE, (int)tilemap->getHCount() - left);
+        int vcount = qMin(Tilemap::RENDER_CHUNK_SIZE, (int)tilemap->getVCount() - top);
 
-        int tileWidth = 16;
-        int tileHeight = 16;
+        chunk->dirty = false;
+        chunk->empty = true;
+
+        //Skip allocating an image for chunks with nothing to draw (common on upper layers)
+        for (int y = top; y < top + vcount && chunk->empty; ++y)
+        {
+            for (int x = left; x < left + hcount; ++x)
+            {
+                //Whole blocks of the shared invisible chunk can be skipped without looking at their tiles
+                if (tilemap->isInvisibleChunk(x, y))
+                {
+                    x += Tilemap::TILE_CHUNK_SIZE - 1 - (x % Tilemap::TILE_CHUNK_SIZE);
+                    continue;
+                }
+
+                auto tile = tilemap->getTile(x, y);
+                if (!Tilemap::IsInvisibleTile(tile) || Tilemap::GetTileTranslucency(tile) == 15)
+                {
+                    chunk->empty = false;
+                    break;
+                }
+            }
+        }
 
+        if (chunk->empty)
+        {
+            chunk->image = QImage();
+            return;
+        }
 
-        int left = qAbs((int)qFloor((qMax((int)(viewRect.x() - x), 0) / tileWidth)));
-        int top = qAbs((int)qFloor((qMax((int)(viewRect.y() - y), 0) / tileHeight)));
-        int right = qMin((int)qCeil((viewRect.right() - x) / tileWidth), (int)tilemap->getHCount());
-        int bottom = qMin((int)qCeil((viewRect.bottom() - y) / tileWidth), (int)tilemap->getVCount());
+        if (chunk->image.width() != hcount * 16 || chunk->image.height() != vcount * 16)
+            chunk->image = QImage(hcount * 16, vcount * 16, QImage::Format_ARGB32_Premultiplied);
 
+        chunk->image.fill(Qt::transparent);
 
-        //keep within map dimensions
-        left = left > tilemap->getHCount() - 1 ? tilemap->getHCount() - 1 : left;
-        top = top > tilemap->getVCount() - 1 ? tilemap->getVCount() - 1 : top;
-        right = right > tilemap->getHCount() - 1 ? tilemap->getHCount() - 1 : right;
-        bottom = bottom > tilemap->getVCount() - 1 ? tilemap->getVCount() - 1 : bottom;
+        blitTilemapTiles(tilemap, tilesetImage, -left * 16, -top * 16, &chunk->image, left, top, left + hcount - 1, top + vcount - 1);
+    }
 
+    void Level::blitTilemapTiles(Tilemap* tilemap, Image* tilesetImage, int x, int y, QImage* dest, int left, int top, int right, int bottom)
+    {
+        //Same as drawTilemapTiles, but written straight into dest (which has to be transparent)
+        TileBlitter blitter(dest);
+        auto& tileset = tilesetImage->premultipliedImage();
 
-        if (tilesetImage != nullptr)
+        for (int y2 = top; y2 <= bottom; ++y2)
         {
-            int currentTranslucency = 0;
-            auto& pixmap = tilesetImage->pixmap();
+            for (int x2 = left; x2 <= right; ++x2)
+            {
+                int tile = 0;
+                if (tilemap->tryGetTile(x2, y2, &tile))
+                {
+                    auto tileX = Tilemap::GetTileX(tile);
+                    auto tileY = Tilemap::GetTileY(tile);
+                    auto translucency = Tilemap::GetTileTranslucency(tile);
+
+                    auto tileDef = getTileDef(tileX, tileY);
+                    if (tileDef)
+                        blitter.drawTile(x + (x2 * 16), y + (y2 * 16), tileDef->second->premultipliedImage(), tileX * 16 - tileDef->first.x(), tileY * 16 - tileDef->first.y(), translucency);
+                    else blitter.drawTile(x + (x2 * 16), y + (y2 * 16), tileset, tileX * 16, tileY * 16, translucency);
+                }
+            }
+        }
+    }
+
+    void Level::drawTilemapTiles(Tilemap* tilemap, Image* tilesetImage, double x, double y, QPainter* painter, int left, int top, int right, int bottom)
+    {
+        qreal startOpacity = painter->opacity();
+
+        int tileWidth = 16;
+        int tileHeight = 16;
+
+        int currentTranslucency = 0;
+        auto& pixmap = tilesetImage->pixmap();
+        int tilesDrawn = 0;
 
-            QRect srcRect(0, 0, tileWidth, tileHeight);
+        QRect srcRect(0, 0, tileWidth, tileHeight);
 
-            for (int y2 = top; y2 <= bottom; ++y2)
+        for (int y2 = top; y2 <= bottom; ++y2)
+        {
+            for (int x2 = left; x2 <= right; ++x2)
             {
-                for (int x2 = left; x2 <= right; ++x2)
+                int tile = 0;
+
+
+                if (tilemap->tryGetTile(x2, y2, &tile))
                 {
-                    int tile = 0;
+                    ++tilesDrawn;
+                    auto translucency = Tilemap::GetTileTranslucency(tile);
+                    if (translucency != currentTranslucency) {
+                        currentTranslucency = translucency;
+
+                        //If completely invisible
+                        if (currentTranslucency != 15)
+                            painter->setOpacity(startOpacity * (1.0 - (translucency / 15.0)));
+                        else painter->setOpacity(0.05);
+                    }
 
+                    auto tileLeft = Tilemap::GetTileX(tile) * tileWidth;
+                    auto tileTop = Tilemap::GetTileY(tile) * tileHeight;
 
-                    if (tilemap->tryGetTile(x2, y2, &tile))
+                    auto tileDef = getTileDef(Tilemap::GetTileX(tile), Tilemap::GetTileY(tile));
+                    if (tileDef)
                     {
-                        auto translucency = Tilemap::GetTileTranslucency(tile);
-                        if (translucency != currentTranslucency) {
-                            currentTranslucency = translucency;
-
-                            //If completely invisible
-                            if (currentTranslucency != 15)
-                                painter->setOpacity(startOpacity * (1.0 - (translucency / 15.0)));
-                            else painter->setOpacity(0.05);
-                        }
-
-                        auto tileLeft = Tilemap::GetTileX(tile) * tileWidth;
-                        auto tileTop = Tilemap::GetTileY(tile) * tileHeight;
+                        srcRect.moveTo(tileLeft - tileDef->first.x(), tileTop - tileDef->first.y());
+                        painter->drawPixmap(QPoint(x + (x2 * tileWidth), y + (y2 * tileHeight)), tileDef->second->pixmap(), srcRect);
+                    }
+                    else {
                         srcRect.moveTo(tileLeft, tileTop);
+                        painter->drawPixmap(QPoint(x + (x2 * tileWidth), y + (y2 * tileHeight)), pixmap, srcRect);
+                    }
+
 
-                        bool foundDef = false;
-
-                        if (m_tileDefs.size() > 0)
-                        {
-                            for(auto it = m_tileDefs.rbegin(); it != m_tileDefs.rend(); ++it)
-                            {
-                                auto& pair = *it;
-                                if (pair.second && pair.first.contains(srcRect))
-                                {
-
-                                    foundDef = true;
-                                    srcRect.moveTo(tileLeft - pair.first.x(), tileTop - pair.first.y());
-                                    painter->drawPixmap(QPoint(x + (x2 * tileWidth), y + (y2 * tileHeight)), pair.second->pixmap(), srcRect);
-                                    break;
-                                }
-                            }
-                        }
-
-                        if (!foundDef)
-                            painter->drawPixmap(QPoint(x + (x2 * tileWidth), y + (y2 * tileHeight)), pixmap, srcRect);
-
-
-                        if (currentTranslucency == 15) {
-                            auto oldOpacity = painter->opacity();
-                            auto oldPen = painter->pen();
-                            painter->setOpacity(1.0);
-                            painter->setPen(QColor(255, 0, 0));
-                            painter->drawLine(QPoint(x + (x2 * tileWidth), y + (y2 * tileHeight)), QPoint(x + (x2 * tileWidth) + 16, y + (y2 * tileHeight) + 16));
-                            painter->setOpacity(oldOpacity);
-                            painter->setPen(oldPen);
-                        }
+                    if (currentTranslucency == 15) {
+                        auto oldOpacity = painter->opacity();
+                        auto oldPen = painter->pen();
+                        painter->setOpacity(1.0);
+                        painter->setPen(QColor(255, 0, 0));
+                        painter->drawLine(QPoint(x + (x2 * tileWidth), y + (y2 * tileHeight)), QPoint(x + (x2 * tileWidth) + 16, y + (y2 * tileHeight) + 16));
+                        painter->setOpacity(oldOpacity);
+                        painter->setPen(oldPen);
                     }
                 }
             }
-            painter->setOpacity(startOpacity);
         }
+        painter->setOpacity(startOpacity);
+
+        FrameProfiler::count(FrameProfiler::COUNTER_DRAW_CALLS, tilesDrawn);
+        FrameProfiler::count(FrameProfiler::COUNTER_TILES_DRAWN, tilesDrawn);
     }
 
     void Level::drawTileset(Image* image, const QColor& backColour, QPainter* painter, const QRectF& rect)
@@ -476,6 +782,10 @@ namespace TilesEditor
 
         for (auto& pair : m_tileDefs)
         {
+            //Only the visible part of the tileset needs to be drawn
+            if (!rect.intersects(pair.first))
+                continue;
+
             painter->fillRect(pair.first, backColour);
 
             if (pair.second)
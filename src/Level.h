@@ -9,7 +9,7 @@
 #include <QByteArray>
 #include "AbstractSpatialGridItem.h"
 #include "AbstractResourceManager.h"
-#include "EntitySpatialGrid.h"
+#include "FlatEntitySpatialGrid.h"
 #include "Tilemap.h"
 #include "AbstractLevelEntity.h"
 #include "LevelNPC.h"
@@ -23,6 +23,7 @@
 #include "LoadState.h"
 #include "sgscript/sgscript.h"
 #include "TileDefs.h"
+#include "LevelModel.h"
 
 namespace TilesEditor
 {
@@ -51,11 +52,18 @@ namespace TilesEditor
 		template <typename T>
 		friend class EntitySpatialGrid;
 
+		template <typename T>
+		friend class FlatEntitySpatialGrid;
+
 		static sgs_Variable sgs_classMembers;
 		static QMap<QString, int> m_imageDimensionsCache;
 
 		static bool getImageDimensions(AbstractResourceManager* resourceManager, const QString& imageName, int* w, int* h);
 
+		void drawTilemapTiles(Tilemap* tilemap, Image* tilesetImage, double x, double y, QPainter* painter, int left, int top, int right, int bottom);
+		void blitTilemapTiles(Tilemap* tilemap, Image* tilesetImage, int x, int y, QImage* dest, int left, int top, int right, int bottom);
+		void renderTilemapChunk(Tilemap* tilemap, Image* tilesetImage, int chunkX, int chunkY, Tilemap::RenderChunk* chunk);
+
 		IWorld* m_world;
 		sgs_Variable m_thisObject;
 		sgs_Variable m_sgsUserTable;
@@ -64,6 +72,9 @@ namespace TilesEditor
 
 		ScriptingLanguage m_defaultObjectLanguage = ScriptingLanguage::SCRIPT_UNDEFINED;
 		bool m_modified;
+
+		//Set the first time the level is modified and never cleared. Undo commands may still point at its entities
+		bool m_edited = false;
 		LevelFlags m_levelFlags;
 		Overworld* m_overworld;
 		
@@ -86,6 +97,22 @@ namespace TilesEditor
 		IEntitySpatialMap<AbstractLevelEntity>* m_entitySpatialMap;
 		QList<QPair<QRect, Image*>> m_tileDefs;
 
+		//Index into m_tileDefs of the tile def that replaces each tileset tile, or -1.
+		//Only covers the bounding box (in tiles) of all the tile defs
+		QRect m_tileDefLookupBounds;
+		QVector<int> m_tileDefLookup;
+		quint64 m_tileDefsRevision = 0;
+
+		void rebuildTileDefLookup();
+
+		const QPair<QRect, Image*>* getTileDef(int tileX, int tileY) const {
+			if (!m_tileDefLookupBounds.contains(tileX, tileY))
+				return nullptr;
+
+			auto index = m_tileDefLookup.at((tileY - m_tileDefLookupBounds.y()) * m_tileDefLookupBounds.width() + (tileX - m_tileDefLookupBounds.x()));
+			return index >= 0 ? &m_tileDefs.at(index) : nullptr;
+		}
+
 	public:
 
 		Level(IWorld* world, double x, double y, int width, int height, Overworld* overworld, const QString& name);
@@ -94,6 +121,11 @@ namespace TilesEditor
 		Tileset* getDefaultTileset() { return m_defaultTileset; }
 		void setDefaultTileset(Tileset* tileset) { m_defaultTileset = tileset; }
 		void release();
+
+		//Release and delete the tiles and entities, going back to STATE_NOT_LOADED so the level is loaded again next time it is needed
+		void unload();
+		bool canUnload() const { return m_loadState == LoadState::STATE_LOADED && !m_modified && !m_edited; }
+		qint64 getMemoryUsage() const;
 		IWorld* getWorld() { return m_world; }
 		Overworld* getOverworld() { return m_overworld; }
 		const QString& getTilesetName() const { return m_tilesetName; }
@@ -118,6 +150,10 @@ namespace TilesEditor
 
 		bool loadStream(QIODevice* stream);
 
+		//Build the level from a model that was parsed on another thread (see LevelLoadScheduler)
+		void loadModel(const LevelModel& model);
+		void applyModel(const LevelModel& model);
+
 		bool saveFile(IFileRequester* requester);
 		bool saveStream(QIODevice* stream);
 
@@ -137,7 +173,7 @@ namespace TilesEditor
 		int getTileHeight() const { return 16; }
 
 		AbstractLevelEntity* getObjectAt(double x, double y, LevelEntityType type);
-		void setModified(bool value) { m_modified = value; }
+		void setModified(bool value) { m_modified = value; m_edited = m_edited || value; }
 		bool getModified() const { return m_modified; }
 		const QVector<LevelLink*>& getLinks()const { return m_links; }
 		const QVector<LevelSign*>& getSigns() const { return m_signs; }
@@ -161,10 +197,20 @@ namespace TilesEditor
 		QRectF clampEntity(AbstractLevelEntity* entity);
 		void setTileLayer(int index, Tilemap* tilemap);
 
+		const QList<QPair<QRect, Image*>>& getTileDefs() const { return m_tileDefs; }
+		quint64 getTileDefsRevision() const { return m_tileDefsRevision; }
+
+		//The table behind getTileDef, for copying to threads that render the tiles
+		const QRect& getTileDefLookupBounds() const { return m_tileDefLookupBounds; }
+		const QVector<int>& getTileDefLookup() const { return m_tileDefLookup; }
 		void removeTileDefs();
 		void addTileDef(const TileDef& tileDef);
+		void invalidateTileRenderCache();
 		void drawTile(double x, double y, Image* tilesetImage, int tileLeft, int tileTop, QPainter* painter);
 		void drawTilemap(Tilemap* tilemap, Image* tilesetImage, double x, double y, QPainter* painter, const QRectF& viewRect);
+
+		//Like drawTilemap, but the tiles are composited into a temporary image instead of the render cache (for screenshots)
+		void compositeTilemap(Tilemap* tilemap, Image* tilesetImage, double x, double y, QPainter* painter, const QRectF& viewRect);
 		void drawTileset(Image* image, const QColor& backColour, QPainter* painter, const QRectF& rect);
 
 		static int convertFromGraalTile(int graalTileIndex, Tileset* defaultTileset) {
@@ -0,0 +1,45 @@
+#ifndef LEVELENTRYH
+#define LEVELENTRYH
+
+#include <QString>
+#include "AbstractSpatialGridItem.h"
+#include "LoadState.h"
+#include "Level.h"
+
+namespace TilesEditor
+{
+	//A level in an overworld's index. Only the name and where it goes are kept until the level is needed
+	//(drawn, edited or searched), which is when the overworld creates the Level itself
+	class LevelEntry :
+		public AbstractSpatialGridItem
+	{
+	private:
+		QString m_name;
+		QString m_fileName;
+		Level* m_level = nullptr;
+
+	public:
+		LevelEntry(const QString& name, double x, double y, int width, int height):
+			m_name(name)
+		{
+			setX(x);
+			setY(y);
+			setWidth(width);
+			setHeight(height);
+		}
+
+		const QString& getName() const { return m_name; }
+
+		//Full path of the level file, once it has been located
+		const QString& getFileName() const { return m_fileName; }
+		void setFileName(const QString& fileName) { m_fileName = fileName; }
+
+		//Null until the level is created
+		Level* getLevel() const { return m_level; }
+		void setLevel(Level* level) { m_level = level; }
+
+		LoadState getLoadState() const { return m_level ? m_level->getLoadState() : LoadState::STATE_NOT_LOADED; }
+	};
+};
+
+#endif
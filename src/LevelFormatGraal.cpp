@@ -1,4 +1,7 @@
+#include <cstring>
+#include <string_view>
 #include <QBuffer>
+#include <QtEndian>
 #include "LevelFormatGraal.h"
 #include "Level.h"
 #include "LevelLink.h"
@@ -12,10 +15,101 @@ namespace TilesEditor
 {
     bool LevelFormatGraal::loadLevel(Level* level, QIODevice* stream)
     {
+        LevelModel model;
+        if (!parseLevel(&model, level->getDefaultTileset(), stream))
+            return false;
+
+        applyFormat(level);
+        level->applyModel(model);
+        return true;
+    }
+
+    //Reads the bytes of a level file without copying them. Reading past the end gives zeros
+    class GraalReader
+    {
+    private:
+        const uchar* m_data;
+        qint64 m_size;
+        qint64 m_pos = 0;
+
+    public:
+        GraalReader(const QByteArray& data) :
+            m_data(reinterpret_cast<const uchar*>(data.constData())), m_size(data.size()) {}
+
+        bool atEnd() const { return m_pos >= m_size; }
+        qint64 pos() const { return m_pos; }
+        void seek(qint64 pos) { m_pos = qMin(pos, m_size); }
+
+        const uchar* data() const { return m_data + m_pos; }
+        qint64 bytesAvailable() const { return m_size - m_pos; }
+
+        uchar readByte() { return m_pos < m_size ? m_data[m_pos++] : 0; }
+
+        //Up to (not including) end, which is skipped
+        std::string_view readString(char end)
+        {
+            auto start = reinterpret_cast<const char*>(m_data + m_pos);
+            auto found = static_cast<const char*>(std::memchr(start, end, m_size - m_pos));
+            auto length = found ? found - start : m_size - m_pos;
+
+            m_pos += found ? length + 1 : length;
+            return std::string_view(start, length);
+        }
+    };
+
+    //Pulls 12 or 13 bit tile codes out of a layer, a 32 bit word at a time. The bytes it has used are the bytes
+    //a byte by byte reader would have read so far, so the end of the data is reached at the same code
+    class GraalBitReader
+    {
+    private:
+        const uchar* m_data;
+        qint64 m_size;
+        qint64 m_bitPos = 0;
+
+    public:
+        GraalBitReader(const uchar* data, qint64 size) :
+            m_data(data), m_size(size) {}
+
+        qint64 getBytesUsed() const { return (m_bitPos + 7) / 8; }
+        bool atEnd() const { return getBytesUsed() >= m_size; }
+
+        unsigned int read(int bits)
+        {
+            auto byte = m_bitPos / 8;
+
+            quint32 word = 0;
+            if (byte + 4 <= m_size)
+                word = qFromLittleEndian<quint32>(m_data + byte);
+            else {
+                for (auto i = 0; i < 4 && byte + i < m_size; ++i)
+                    word |= quint32(m_data[byte + i]) << (i * 8);
+            }
+
+            auto code = (word >> (m_bitPos % 8)) & ((1u << bits) - 1);
+            m_bitPos += bits;
+            return code;
+        }
+    };
+
+    bool LevelFormatGraal::parseLevel(LevelModel* model, Tileset* defaultTileset, QIODevice* stream)
+    {
+        //Levels loaded from memory are parsed in place
+        QByteArray data;
+        auto buffer = qobject_cast<QBuffer*>(stream);
+        if (buffer && buffer->pos() == 0)
+        {
+            data = buffer->data();
+            buffer->seek(data.size());
+        }
+        else data = stream->readAll();
+
+        GraalReader reader(data);
+
         int v = -1;
-        QString fileVersion = stream->read(8);
+        auto fileVersion = std::string_view(data.constData(), qMin(data.size(), qsizetype(8)));
+        reader.seek(8);
 
-        bool isZelda = fileVersion.startsWith("Z3");
+        bool isZelda = fileVersion.starts_with("Z3");
 
         if (fileVersion == "GR-V1.00" || fileVersion == "Z3-V1.03" || fileVersion == "Z3-V1.04") v = 0;
         else if (fileVersion == "GR-V1.01") v = 1;
@@ -25,69 +119,44 @@ namespace TilesEditor
 
         if (v == -1) return false;
 
-        auto readString = [](QIODevice* base, char end) -> QString {
-            QString retval = "";
-            unsigned char byte;
-            while (base->read((char*)&byte, 1) > 0 && byte != end) {
-                retval.append((char)byte);
-            }
-            return retval;
+        //Text in graal levels is one byte per character
+        auto readString = [&reader](char end) -> QString {
+            auto text = reader.readString(end);
+            return QString::fromLatin1(text.data(), text.size());
         };
 
         // Load tiles.
         {
-            applyFormat(level);
-            level->setSize(64 * 16, 64 * 16);
-
-            auto setTileIndex = [](Tilemap* tilemap, int boardIndex, int graalTile, Tileset* defaultTileset) {
-                auto tileX = boardIndex % 64;
-                auto tileY = boardIndex / 64;
-
-                auto tile = graalTile == 0xFFF ? Tilemap::MakeInvisibleTile(0) : Level::convertFromGraalTile(graalTile, defaultTileset);
+            model->width = 64 * 16;
+            model->height = 64 * 16;
 
-                tilemap->setTile(tileX, tileY, tile);
+            auto convertTile = [](int graalTile, Tileset* defaultTileset) {
+                return graalTile == 0xFFF ? Tilemap::MakeInvisibleTile(0) : Level::convertFromGraalTile(graalTile, defaultTileset);
             };
 
             int layers = 1;
             if (v >= 5)
-            {
-                unsigned char byte;
-                stream->read((char*)&byte, 1);
-                layers = int(byte - 32);
-            }
+                layers = int(reader.readByte()) - 32;
 
             int bits = (v > 1 ? 13 : 12);
             for (int currentLayer = 0; currentLayer < layers; ++currentLayer)
             {
-                int read = 0;
-                unsigned int buffer = 0;
+                GraalBitReader bitReader(reader.data(), reader.bytesAvailable());
                 unsigned short code = 0;
                 short tiles[2] = { -1,-1 };
                 int boardIndex = 0;
                 int count = 1;
                 bool doubleMode = false;
 
-                auto tilemap = level->getOrMakeTilemap(currentLayer);
-
+                //Layers are always 64x64, so tiles are written straight into the board
+                auto& tileLayer = model->getOrMakeTileLayer(currentLayer);
+                auto board = tileLayer.tiles.data();
 
                 // Read the tiles.
-                while (boardIndex < 64 * 64 && !stream->atEnd())
+                while (boardIndex < 64 * 64 && !bitReader.atEnd())
                 {
-                    // Every control code/tile is either 12 or 13 bits.  WTF.
-                    // Read in the bits.
-                    while (read < bits)
-                    {
-                        unsigned char byte;
-                        stream->read((char*)&byte, 1);
-
-                        buffer += byte << read;
-                        read += 8;
-                    }
-
-                    // Pull out a single 12/13 bit code from the buffer.
-                    code = buffer & (bits == 12 ? 0xFFF : 0x1FFF);
-                    buffer >>= bits;
-                    read -= bits;
+                    // Every control code/tile is either 12 or 13 bits.
+                    code = bitReader.read(bits);
 
                     // See if we have an RLE control code.
                     // Control codes determine how the RLE scheme works.
@@ -105,7 +174,7 @@ namespace TilesEditor
                     // If our count is 1, just read in a tile.  This is the default mode.
                     if (count == 1)
                     {
-                        setTileIndex(tilemap, boardIndex++, code, level->getDefaultTileset());
+                        board[boardIndex++] = convertTile(code, defaultTileset);
                         continue;
                     }
 
@@ -124,10 +193,12 @@ namespace TilesEditor
                         tiles[1] = (short)code;
 
                         // Add the tiles now.
+                        auto tile0 = convertTile(tiles[0], defaultTileset);
+                        auto tile1 = convertTile(tiles[1], defaultTileset);
                         for (int i = 0; i < count && boardIndex < 64 * 64 - 1; ++i)
                         {
-                            setTileIndex(tilemap, boardIndex++, tiles[0], level->getDefaultTileset());
-                            setTileIndex(tilemap, boardIndex++, tiles[1], level->getDefaultTileset());
+                            board[boardIndex++] = tile0;
+                            board[boardIndex++] = tile1;
                         }
 
                         // Clean up.
@@ -138,19 +209,22 @@ namespace TilesEditor
                     // Regular RLE scheme.
                     else
                     {
+                        auto tile = convertTile(code, defaultTileset);
                         for (int i = 0; i < count && boardIndex < 64 * 64; ++i)
-                            setTileIndex(tilemap, boardIndex++, code, level->getDefaultTileset());
+                            board[boardIndex++] = tile;
                         count = 1;
                     }
                 }
+
+                reader.seek(reader.pos() + bitReader.getBytesUsed());
             }
         }
 
         // Load the links.
         {
-            while (!stream->atEnd())
+            while (!reader.atEnd())
             {
-                auto line = readString(stream, '\n');
+                auto line = readString('\n');
                 if (line.length() == 0 || line == "#") break;
 
                 auto words = line.split(' ');
@@ -170,44 +244,35 @@ namespace TilesEditor
                     else if ((y == 0 || y == 63 * 16) && height == 16)
                         possibleEdgeLink = true;
 
-                    auto levelLink = new LevelLink(level->getWorld(), level->getX() + x, level->getY() + y, width, height, possibleEdgeLink);
-                    levelLink->setLevel(level);
-                    levelLink->setNextLevel(words[0]);
-                    levelLink->setNextX(nextX);
-                    levelLink->setNextY(nextY);
-
-                    level->addObject(levelLink);
+                    model->links.push_back(LevelModel::Link{ x, y, width, height, possibleEdgeLink, words[0], nextX, nextY, 0, 0 });
                 }
             }
         }
 
         // Load the baddies.
         {
-            while (!stream->atEnd())
+            while (!reader.atEnd())
             {
-                signed char x = stream->read(1).data()[0];
-                signed char y = stream->read(1).data()[0];
-                signed char type = stream->read(1).data()[0];
+                signed char x = reader.readByte();
+                signed char y = reader.readByte();
+                signed char type = reader.readByte();
 
                 // Ends with an invalid baddy.
                 if (x == -1 && y == -1 && type == -1)
                 {
-                    readString(stream, '\n');
+                    reader.readString('\n');
                     break;
                 }
 
 
-                auto baddy = new LevelGraalBaddy(level->getWorld(), (x * 16) + level->getX(), (y * 16) + level->getY(), type);
-                baddy->setLevel(level);
+                LevelModel::Baddy baddy{ x * 16.0, y * 16.0, type, 0 };
 
-                int verseIndex = 0;
-
-                auto verses = readString(stream, '\n').split('\\');
+                auto verses = readString('\n').split('\\');
                 for (int i = 0; i < verses.size(); ++i)
                 {
-                    baddy->setBaddyVerse(verseIndex++, verses[i].trimmed());
+                    baddy.verses.push_back(verses[i].trimmed());
                 }
-                level->addObject(baddy);
+                model->baddies.push_back(baddy);
             }
         }
 
@@ -215,9 +280,9 @@ namespace TilesEditor
         {
             // Load NPCs.
             {
-                while (!stream->atEnd())
+                while (!reader.atEnd())
                 {
-                    auto line = readString(stream, '\n');
+                    auto line = readString('\n');
                     if (line.length() == 0 || line == "#") break;
 
                     auto x = (line[0].unicode() - 32) * 16;
@@ -233,16 +298,16 @@ namespace TilesEditor
 
                     auto code = line.mid(lineIndex + 1).replace('\xa7', '\n');
 
-                    createNPC(level, image, x, y, code);
+                    model->npcs.push_back(LevelModel::NPC{ image, double(x), double(y), code });
                 }
             }
 
             // Load chests.
             if (v > 0)
             {
-                while (!stream->atEnd())
+                while (!reader.atEnd())
                 {
-                    auto line = readString(stream, '\n');
+                    auto line = readString('\n');
                     if (line.length() == 0 || line == "#") break;
 
                     auto x = (line[0].unicode() - 32) * 16;
@@ -281,10 +346,7 @@ namespace TilesEditor
 
                     if (item >= 0 && item < sizeof(itemNames) / sizeof(itemNames[0]))
                     {
-                        auto chest = new LevelChest(level->getWorld(), x + level->getX(), y + level->getY(), itemNames[item], signindex);
-                        chest->setLevel(level);
-
-                        level->addObject(chest);
+                        model->chests.push_back(LevelModel::Chest{ double(x), double(y), itemNames[item], signindex, 0 });
                     }
                 }
             }
@@ -339,26 +401,16 @@ namespace TilesEditor
 
         // Load signs.
         {
-            while (!stream->atEnd())
+            while (!reader.atEnd())
             {
-                auto line = readString(stream, '\n');
+                auto line = readString('\n');
                 if (line.length() == 0) break;
 
                 auto x = (line[0].unicode() - 32) * 16;
                 auto y = (line[1].unicode() - 32) * 16;
                 auto encodedText = line.mid(2);
 
-                auto sign = new LevelSign(level->getWorld(),
-                    level->getX() + x,
-                    level->getY() + y,
-                    32,
-                    16);
-
-                sign->setLevel(level);
-
-                sign->setText(decodeSign(encodedText));
-
-                level->addObject(sign);
+                model->signs.push_back(LevelModel::Sign{ double(x), double(y), 0, decodeSign(encodedText) });
             }
         }
         return true;
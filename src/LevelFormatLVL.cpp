@@ -1,161 +1,355 @@
+#include <cstring>
+#include <array>
+#include <QBuffer>
 #include "LevelFormatLVL.h"
 #include "Level.h"
 #include "LevelLink.h"
 #include "LevelSign.h"
 #include "ObjectFactory.h"
+#include "JsonStreamReader.h"
 #include "cJSON/JsonHelper.h"
 
 namespace TilesEditor
 {
-    bool LevelFormatLVL::loadLevel(Level* level, QIODevice* stream)
+    //Base64 digit values, -1 for anything else
+    static const std::array<qint8, 256> LVLBase64Values = []() {
+        std::array<qint8, 256> retval;
+        retval.fill(-1);
+
+        const char* digits = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (int i = 0; i < 64; ++i)
+            retval[(unsigned char)digits[i]] = qint8(i);
+        return retval;
+    }();
+
+    //A chunk's tiles are base64 numbers separated by spaces
+    static void decodeLVLChunk(Tilemap* tilemap, int left, int top, const char* data, qsizetype size)
     {
-        static const QString base64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        auto end = data + size;
+        int x = 0;
+        while (data < end)
+        {
+            if (*data == ' ')
+            {
+                ++data;
+                continue;
+            }
 
-        QTextStream textStream(stream);
+            auto partEnd = data;
+            while (partEnd < end && *partEnd != ' ')
+                ++partEnd;
 
-        QString text = textStream.readAll();
-        if (!text.isEmpty())
-        {
-            auto jsonRoot = cJSON_Parse(text.toLocal8Bit().data());
+            int tile = 0;
+            int bitcount = 0;
+            for (auto c = partEnd - 1; c >= data; --c)
+            {
+                tile |= LVLBase64Values[(unsigned char)*c] << bitcount;
+                bitcount += 6;
+            }
+            tilemap->setTile(left + x, top, tile);
+
+            ++x;
+            data = partEnd;
+        }
+    }
 
-            if (jsonRoot)
+    //Chunks are [left, top, "tiles"]. Only used when a layer's chunks come before its index
+    static void decodeLVLChunks(Tilemap* tilemap, cJSON* jsonChunks)
+    {
+        for (int i = 0; i < cJSON_GetArraySize(jsonChunks); ++i)
+        {
+            auto jsonChunk = cJSON_GetArrayItem(jsonChunks, i);
+            if (jsonChunk)
             {
-                auto type = jsonGetChildString(jsonRoot, "type");
-                auto version = jsonGetChildString(jsonRoot, "version");
+                auto left = jsonGetArrayInt(jsonChunk, 0);
+                auto top = jsonGetArrayInt(jsonChunk, 1);
 
+                auto jsonLine = cJSON_GetArrayItem(jsonChunk, 2);
+                if (jsonLine && jsonLine->type == cJSON_String)
+                    decodeLVLChunk(tilemap, left, top, jsonLine->valuestring, qsizetype(strlen(jsonLine->valuestring)));
+            }
+        }
+    }
 
-                if (type == "level" && version == "1.0")
-                {
+    //The same, read straight from the file
+    static void readLVLChunks(JsonStreamReader& reader, Tilemap* tilemap)
+    {
+        using Token = JsonStreamReader::Token;
 
-                    auto hcount = jsonGetChildInt(jsonRoot, "hcount", 1);
-                    auto vcount = jsonGetChildInt(jsonRoot, "vcount", 1);
+        if (reader.token() != Token::BeginArray)
+        {
+            reader.skipValue();
+            return;
+        }
 
-                    applyFormat(level);
+        while (reader.readNext() != Token::EndArray && !reader.hasError())
+        {
+            if (reader.token() != Token::BeginArray)
+            {
+                reader.skipValue();
+                continue;
+            }
 
-                    level->setSize(hcount * 16, vcount * 16);
-                    level->setTilesetName(jsonGetChildString(jsonRoot, "tileset", ""));
-                    level->setTilesetImageName(jsonGetChildString(jsonRoot, "tilesetImage", ""));
+            int left = 0, top = 0;
+            for (int i = 0; reader.readNext() != Token::EndArray && !reader.hasError(); ++i)
+            {
+                if (i == 0 && reader.token() == Token::Number)
+                    left = reader.intValue();
+                else if (i == 1 && reader.token() == Token::Number)
+                    top = reader.intValue();
+                else if (i == 2 && reader.token() == Token::String)
+                    decodeLVLChunk(tilemap, left, top, reader.stringValue().constData(), reader.stringValue().size());
+                else reader.skipValue();
+            }
+        }
+    }
 
+    static void readLVLTileLayers(JsonStreamReader& reader, Level* level, int hcount, int vcount)
+    {
+        using Token = JsonStreamReader::Token;
 
+        if (reader.token() != Token::BeginArray)
+        {
+            reader.skipValue();
+            return;
+        }
 
-                    auto jsonLayers = cJSON_GetObjectItem(jsonRoot, "tileLayers");
-                    if (jsonLayers)
-                    {
-                        for (int i = 0; i < cJSON_GetArraySize(jsonLayers); ++i)
-                        {
-                            auto jsonLayer = cJSON_GetArrayItem(jsonLayers, i);
+        while (reader.readNext() != Token::EndArray && !reader.hasError())
+        {
+            if (reader.token() != Token::BeginObject)
+            {
+                reader.skipValue();
+                continue;
+            }
 
-                            if (jsonLayer)
-                            {
-                                auto index = jsonGetChildInt(jsonLayer, "index");
+            int index = 0;
+            bool hasIndex = false;
+            Tilemap* tilemap = nullptr;
+            cJSON* jsonChunks = nullptr;
 
+            while (reader.readNext() != Token::EndObject && !reader.hasError())
+            {
+                if (reader.keyEquals("index") && !hasIndex)
+                {
+                    reader.readNext();
+                    index = reader.token() == Token::Number ? reader.intValue() : 0;
+                    hasIndex = true;
+                    reader.skipValue();
+                }
+                else if (reader.keyEquals("chunks") && !tilemap && !jsonChunks)
+                {
+                    reader.readNext();
+
+                    //The tilemap can't be made until we know which layer it is
+                    if (!hasIndex)
+                        jsonChunks = reader.readValue();
+                    else {
+                        tilemap = new Tilemap(level->getWorld(), level->getX(), level->getY(), hcount, vcount, index);
+                        tilemap->clear(Tilemap::MakeInvisibleTile(0));
+                        readLVLChunks(reader, tilemap);
+                    }
+                }
+                else reader.skipValue();
+            }
 
-                                auto jsonChunks = cJSON_GetObjectItem(jsonLayer, "chunks");
-                                if (jsonChunks)
-                                {
-                                    auto tilemap = new Tilemap(level->getWorld(), level->getX(), level->getY(), hcount, vcount, index);
-                                    
-                                    tilemap->clear(Tilemap::MakeInvisibleTile(0));
-                                    for (int ii = 0; ii < cJSON_GetArraySize(jsonChunks); ++ii)
-                                    {
-                                        auto jsonChunk = cJSON_GetArrayItem(jsonChunks, ii);
+            if (jsonChunks)
+            {
+                tilemap = new Tilemap(level->getWorld(), level->getX(), level->getY(), hcount, vcount, index);
+                tilemap->clear(Tilemap::MakeInvisibleTile(0));
+                decodeLVLChunks(tilemap, jsonChunks);
+                cJSON_Delete(jsonChunks);
+            }
 
-                                        if (jsonChunk)
-                                        {
-                                            auto left = jsonGetArrayInt(jsonChunk, 0);
-                                            auto top = jsonGetArrayInt(jsonChunk, 1);
+            if (tilemap)
+                level->setTileLayer(index, tilemap);
+        }
+    }
 
-                                            auto line = jsonGetArrayString(jsonChunk, 2, "");
+    //Each entity is read as its own small json tree, as that's what the constructors take.
+    //When type is empty, each entity's "type" is used
+    static void readLVLEntities(JsonStreamReader& reader, Level* level, const QString& type)
+    {
+        using Token = JsonStreamReader::Token;
 
-                                            auto parts = line.split(' ', Qt::SkipEmptyParts);
-                                            for (auto x = 0U; x < parts.size(); ++x)
-                                            {
-                                                int tile = 0;
-                                                auto& part = parts[x];
-                                                int bitcount = 0;
+        if (reader.token() != Token::BeginArray)
+        {
+            reader.skipValue();
+            return;
+        }
 
+        while (reader.readNext() != Token::EndArray && !reader.hasError())
+        {
+            auto jsonEntity = reader.readValue();
+            if (!jsonEntity)
+                return;
 
-                                                for (auto i = part.length() - 1; i >= 0; --i) {
-                                                    auto value = base64.indexOf(part[i]);
+            auto entity = ObjectFactory::createObject(level->getWorld(), type.isEmpty() ? jsonGetChildString(jsonEntity, "type") : type, jsonEntity);
+            if (entity)
+            {
+                entity->setX(level->getX() + entity->getX());
+                entity->setY(level->getY() + entity->getY());
+                level->addObject(entity);
+            }
+            cJSON_Delete(jsonEntity);
+        }
+    }
 
-                                                    tile |= value << bitcount;
-                                                    bitcount += 6;
-                                                }
-                                                tilemap->setTile(left + x, top, tile);
-                                            }
+    bool LevelFormatLVL::loadLevel(Level* level, QIODevice* stream)
+    {
+        using Token = JsonStreamReader::Token;
 
-                                        }
-                                    }
+        //The level is read as it is parsed, so the whole file (and a json tree of it) never has to be in memory
+        JsonStreamReader reader(stream);
+        if (reader.readNext() != Token::BeginObject)
+            return false;
 
-                                    level->setTileLayer(index, tilemap);
-                                }
-                            }
-                        }
-                    }
+        QString type, version, tilesetName, tilesetImageName;
+        int hcount = 1, vcount = 1;
+        bool hasType = false, hasVersion = false, hasHCount = false, hasVCount = false, hasTileset = false, hasTilesetImage = false;
+        bool started = false;
 
-                    auto jsonSigns = cJSON_GetObjectItem(jsonRoot, "signs");
-                    if (jsonSigns)
-                    {
-                        for (int i = 0; i < cJSON_GetArraySize(jsonSigns); ++i)
-                        {
-                            auto jsonSign = cJSON_GetArrayItem(jsonSigns, i);
+        //Sections that come before the header is complete are kept until the end
+        cJSON* jsonDeferred = cJSON_CreateObject();
 
-                            if (jsonSign)
-                            {
-                                auto sign = ObjectFactory::createObject(level->getWorld(), "levelSign", jsonSign);
-                                sign->setX(level->getX() + sign->getX());
-                                sign->setY(level->getY() + sign->getY());
-                                
+        auto start = [&]() -> bool
+        {
+            if (!started)
+            {
+                if (type != "level" || version != "1.0")
+                    return false;
+
+                applyFormat(level);
+                level->setSize(hcount * 16, vcount * 16);
+                level->setTilesetName(tilesetName);
+                level->setTilesetImageName(tilesetImageName);
+                started = true;
+            }
+            return true;
+        };
 
-                                level->addObject(sign);
+        auto readSection = [&](JsonStreamReader& reader, const char* name)
+        {
+            if (!strcmp(name, "tileLayers"))
+                readLVLTileLayers(reader, level, hcount, vcount);
+            else if (!strcmp(name, "signs"))
+                readLVLEntities(reader, level, "levelSign");
+            else if (!strcmp(name, "links"))
+                readLVLEntities(reader, level, "levelLink");
+            else readLVLEntities(reader, level, "");
+        };
 
-                            }
-                        }
-                    }
+        static const char* sections[] = { "tileLayers", "signs", "links", "objects" };
+        bool failed = false;
+        while (reader.readNext() != Token::EndObject && !reader.hasError())
+        {
+            if (reader.keyEquals("type") && !hasType)
+            {
+                reader.readNext();
+                type = reader.token() == Token::String ? reader.toString() : QString();
+                hasType = true;
+                reader.skipValue();
+            }
+            else if (reader.keyEquals("version") && !hasVersion)
+            {
+                reader.readNext();
+                version = reader.token() == Token::String ? reader.toString() : QString();
+                hasVersion = true;
+                reader.skipValue();
+            }
+            else if (reader.keyEquals("hcount") && !hasHCount)
+            {
+                reader.readNext();
+                hcount = reader.token() == Token::Number ? reader.intValue() : 1;
+                hasHCount = true;
+                reader.skipValue();
+            }
+            else if (reader.keyEquals("vcount") && !hasVCount)
+            {
+                reader.readNext();
+                vcount = reader.token() == Token::Number ? reader.intValue() : 1;
+                hasVCount = true;
+                reader.skipValue();
+            }
+            else if (reader.keyEquals("tileset") && !hasTileset)
+            {
+                reader.readNext();
+                tilesetName = reader.token() == Token::String ? reader.toString() : QString();
+                hasTileset = true;
+                reader.skipValue();
+                if (started)
+                    level->setTilesetName(tilesetName);
+            }
+            else if (reader.keyEquals("tilesetImage") && !hasTilesetImage)
+            {
+                reader.readNext();
+                tilesetImageName = reader.token() == Token::String ? reader.toString() : QString();
+                hasTilesetImage = true;
+                reader.skipValue();
+                if (started)
+                    level->setTilesetImageName(tilesetImageName);
+            }
+            else {
+                const char* section = nullptr;
+                for (auto name : sections)
+                {
+                    if (reader.keyEquals(name))
+                        section = name;
+                }
 
-                    auto jsonLinks = cJSON_GetObjectItem(jsonRoot, "links");
-                    if (jsonLinks)
+                //Only the first of each section is used
+                if (section && !cJSON_GetObjectItem(jsonDeferred, section))
+                {
+                    reader.readNext();
+                    if (hasType && hasVersion && hasHCount && hasVCount)
                     {
-                        for (int i = 0; i < cJSON_GetArraySize(jsonLinks); ++i)
+                        if (!start())
                         {
-                            auto jsonLink = cJSON_GetArrayItem(jsonLinks, i);
-
-                            if (jsonLink)
-                            {
-                                auto link = ObjectFactory::createObject(level->getWorld(), "levelLink", jsonLink);
-                                link->setX(level->getX() + link->getX());
-                                link->setY(level->getY() + link->getY());
-                                level->addObject(link);
-
-                            }
+                            failed = true;
+                            break;
                         }
+                        readSection(reader, section);
                     }
+                    else if (auto jsonSection = reader.readValue())
+                        cJSON_AddItemToObject(jsonDeferred, section, jsonSection);
+                    else break;
 
-                    auto jsonObjects = cJSON_GetObjectItem(jsonRoot, "objects");
-                    if (jsonObjects)
-                    {
-                        for (int i = 0; i < cJSON_GetArraySize(jsonObjects); ++i)
-                        {
-                            auto jsonObject = cJSON_GetArrayItem(jsonObjects, i);
+                    //Mark it as read
+                    if (!cJSON_GetObjectItem(jsonDeferred, section))
+                        cJSON_AddItemToObject(jsonDeferred, section, cJSON_CreateNull());
+                }
+                else reader.skipValue();
+            }
+        }
 
-                            auto objectType = jsonGetChildString(jsonObject, "type");
-                            auto entity = ObjectFactory::createObject(level->getWorld(), objectType, jsonObject);
+        if (!failed && !reader.hasError() && start())
+        {
+            //Put the sections that came too early through the same reader
+            for (auto name : sections)
+            {
+                auto jsonSection = cJSON_GetObjectItem(jsonDeferred, name);
+                if (jsonSection && jsonSection->type != cJSON_NULL)
+                {
+                    auto text = cJSON_PrintUnformatted(jsonSection);
+                    QByteArray sectionData(text);
+                    free(text);
 
-                            if (entity)
-                            {
-                                entity->setX(level->getX() + entity->getX());
-                                entity->setY(level->getY() + entity->getY());
-                                level->addObject(entity);
-                            }
+                    QBuffer buffer(&sectionData);
+                    buffer.open(QIODevice::ReadOnly);
 
-                        }
-                    }
-                    cJSON_Delete(jsonRoot);
-                    return true;
+                    JsonStreamReader sectionReader(&buffer);
+                    sectionReader.readNext();
+                    readSection(sectionReader, name);
                 }
-                cJSON_Delete(jsonRoot);
             }
+            cJSON_Delete(jsonDeferred);
+            return true;
         }
+
+        cJSON_Delete(jsonDeferred);
+
+        //Don't leave half a level behind
+        if (started)
+            level->unload();
         return false;
     }
 
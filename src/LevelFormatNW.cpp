@@ -1,3 +1,8 @@
+#include <cstring>
+#include <array>
+#include <string_view>
+#include <QBuffer>
+#include <QVarLengthArray>
 #include "LevelFormatNW.h"
 #include "Level.h"
 #include "LevelLink.h"
@@ -6,16 +11,168 @@
 #include "LevelGraalBaddy.h"
 #include "LevelObjectInstance.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LEVELFORMATNW_SSE2
+#endif
+
 namespace TilesEditor
 {
-    static bool isNumeric(const QString& s) {
+    //Splits the file into lines without copying it. Lines end at \n, and a \r before it is dropped (the same as QTextStream::readLine)
+    class NWLineReader
+    {
+    private:
+        const char* m_pos;
+        const char* m_end;
+
+    public:
+        NWLineReader(const QByteArray& data) :
+            m_pos(data.constData()), m_end(data.constData() + data.size())
+        {
+            //Skip the utf-8 byte order mark
+            if (data.startsWith("\xEF\xBB\xBF"))
+                m_pos += 3;
+        }
+
+        bool readLine(std::string_view* line)
+        {
+            if (m_pos >= m_end)
+                return false;
+
+            auto newLine = static_cast<const char*>(std::memchr(m_pos, '\n', m_end - m_pos));
+            auto lineEnd = newLine ? newLine : m_end;
+
+            *line = std::string_view(m_pos, lineEnd - m_pos);
+            if (!line->empty() && line->back() == '\r')
+                line->remove_suffix(1);
+
+            m_pos = newLine ? newLine + 1 : m_end;
+            return true;
+        }
+    };
+
+    //The words of a line, split on every space like QString::split(' '). Only the first few are kept
+    class NWWords
+    {
+    private:
+        static const unsigned int MAX_WORDS = 12;
+        std::string_view m_words[MAX_WORDS];
+        unsigned int m_count = 0;
+
+    public:
+        NWWords(std::string_view line)
+        {
+            size_t start = 0;
+            for (;;)
+            {
+                auto end = line.find(' ', start);
+                if (m_count < MAX_WORDS)
+                    m_words[m_count] = line.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+                ++m_count;
+
+                if (end == std::string_view::npos)
+                    break;
+                start = end + 1;
+            }
+        }
+
+        unsigned int size() const { return m_count; }
+        std::string_view operator[](unsigned int index) const { return index < MAX_WORDS ? m_words[index] : std::string_view(); }
+    };
+
+    static int toInt(std::string_view text) {
+        return QByteArrayView(text.data(), text.size()).toInt();
+    }
+
+    static double toDouble(std::string_view text) {
+        return QByteArrayView(text.data(), text.size()).toDouble();
+    }
+
+    static bool isNumeric(std::string_view text) {
         bool ok;
-        s.toDouble(&ok); // or toInt(&ok), depending on what you expect
+        QByteArrayView(text.data(), text.size()).toDouble(&ok);
         return ok;
     }
 
+    static QString toString(std::string_view text) {
+        return QString::fromUtf8(text.data(), text.size());
+    }
+
+    //Value of each base64 digit, or -1 (the same as indexOf in the alphabet)
+    static const qint8* getBase64Values()
+    {
+        static const auto values = []() {
+            static const char base64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+            std::array<qint8, 256> retval;
+            retval.fill(-1);
+            for (auto i = 0; i < 64; ++i)
+                retval[uchar(base64[i])] = qint8(i);
+            return retval;
+        }();
+        return values.data();
+    }
+
+    //Decode width graal tile indexes from pairs of base64 digits
+    static void decodeBoardRow(const char* data, unsigned int width, int* graalTiles)
+    {
+        auto values = getBase64Values();
+        unsigned int i = 0;
+
+#ifdef LEVELFORMATNW_SSE2
+        //8 tiles at a time. Blocks with anything that isn't base64 are left to the table
+        auto zero = _mm_setzero_si128();
+        auto inRange = [](__m128i chars, char low, char high) {
+            return _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8(low - 1)), _mm_cmplt_epi8(chars, _mm_set1_epi8(high + 1)));
+        };
+
+        for (; i + 8 <= width; i += 8)
+        {
+            auto chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 2));
+
+            auto upper = inRange(chars, 'A', 'Z');
+            auto lower = inRange(chars, 'a', 'z');
+            auto digit = inRange(chars, '0', '9');
+            auto plus = _mm_cmpeq_epi8(chars, _mm_set1_epi8('+'));
+            auto slash = _mm_cmpeq_epi8(chars, _mm_set1_epi8('/'));
+
+            auto valid = _mm_or_si128(_mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, plus)), slash);
+            if (_mm_movemask_epi8(valid) != 0xFFFF)
+                break;
+
+            auto digits = _mm_and_si128(upper, _mm_sub_epi8(chars, _mm_set1_epi8('A')));
+            digits = _mm_or_si128(digits, _mm_and_si128(lower, _mm_sub_epi8(chars, _mm_set1_epi8('a' - 26))));
+            digits = _mm_or_si128(digits, _mm_and_si128(digit, _mm_add_epi8(chars, _mm_set1_epi8(52 - '0'))));
+            digits = _mm_or_si128(digits, _mm_and_si128(plus, _mm_set1_epi8(62)));
+            digits = _mm_or_si128(digits, _mm_and_si128(slash, _mm_set1_epi8(63)));
+
+            //Each 16 bit lane holds a tile's two digits, the high one in the low byte
+            auto high = _mm_slli_epi16(_mm_and_si128(digits, _mm_set1_epi16(0xFF)), 6);
+            auto low = _mm_srli_epi16(digits, 8);
+            auto tiles = _mm_or_si128(high, low);
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(graalTiles + i), _mm_unpacklo_epi16(tiles, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(graalTiles + i + 4), _mm_unpackhi_epi16(tiles, zero));
+        }
+#endif
+
+        for (; i < width; ++i)
+            graalTiles[i] = (values[uchar(data[i * 2])] << 6) + values[uchar(data[i * 2 + 1])];
+    }
+
 	bool LevelFormatNW::loadLevel(Level* level, QIODevice* stream)
 	{
+        LevelModel model;
+        if (!parseLevel(&model, level->getDefaultTileset(), stream))
+            return false;
+
+        applyFormat(level);
+        level->applyModel(model);
+        return true;
+	}
+
+	bool LevelFormatNW::parseLevel(LevelModel* model, Tileset* defaultTileset, QIODevice* stream)
+	{
         static QStringList itemNames = {
             "greenrupee",        // 0
             "bluerupee",        // 1
@@ -58,225 +215,157 @@ namespace TilesEditor
             "dragon"
         };
 
-        QStringList lines;
+        //Levels loaded from memory are parsed in place
+        QByteArray data;
+        auto buffer = qobject_cast<QBuffer*>(stream);
+        if (buffer && buffer->pos() == 0)
+        {
+            data = buffer->data();
+            buffer->seek(data.size());
+        }
+        else data = stream->readAll();
 
-        QTextStream textStream(stream);
-        for (QString line = textStream.readLine(); !line.isNull(); line = textStream.readLine())
-            lines.push_back(line);
+        NWLineReader reader(data);
 
-        if (lines.size() > 0)
-        {
-            auto& version = lines[0];
+        std::string_view version;
+        if (!reader.readLine(&version) || version != "GLEVNW01")
+            return false;
 
-            static const QString base64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-            static const QString validVersions[] = {
-                "GLEVNW01"
-            };
+        if (defaultTileset) {
+            model->setTilesetName(defaultTileset->text());
+            model->setTilesetImageName(defaultTileset->getImageName());
+        }
 
-            bool valid = false;
-            for (auto i = 0U; i < sizeof(validVersions) / sizeof(validVersions[0]); ++i)
-            {
-                if (validVersions[i] == version) {
-                    valid = true;
-                    break;
-                }
-            }
+        model->width = 64 * 16;
+        model->height = 64 * 16;
 
+        QVarLengthArray<int, 64> graalTiles;
 
+        std::string_view line;
+        while (reader.readLine(&line))
+        {
+            NWWords words(line);
+            auto wordCount = words.size();
 
-            if (valid)
+            if (words[0] == "BOARD" && wordCount >= 6)
             {
-                if (level->getDefaultTileset()) {
-                    level->setTilesetName(level->getDefaultTileset()->text());
-                    level->setTilesetImageName(level->getDefaultTileset()->getImageName());
-                }
-
-                applyFormat(level);
-                level->setSize(64 * 16, 64 * 16);
+                unsigned int x = toInt(words[1]);
+                unsigned int y = toInt(words[2]);
+                unsigned int width = toInt(words[3]);
+                unsigned int layer = toInt(words[4]);
 
-                QVector<Tilemap*> tilemaps;
+                auto& tileLayer = model->getOrMakeTileLayer(layer);
+                auto tileData = words[5];
 
-                auto lineCount = lines.size();
-                for (size_t i = 1; i < lineCount; ++i)
+                if (tileData.length() >= size_t(width) * 2)
                 {
-                    auto wordCount = 0U;
-                    QStringList words = lines[i].split(' ');
-
-                    wordCount = words.size();
-                    if (wordCount > 0)
-                    {
-                        if (words[0] == "BOARD" && wordCount >= 6)
-                        {
-                            unsigned int x = words[1].toInt();
-                            unsigned int y = words[2].toInt();
-                            unsigned int width = words[3].toInt();
-                            unsigned int layer = words[4].toInt();
-
-                            auto tilemap = level->getOrMakeTilemap(layer);
-                            auto& tileData = words[5];
-
-
-                            if (tileData.length() >= width * 2)
-                            {
-                                for (size_t ii = 0u; ii < width; ++ii)
-                                {
-                                    char byte1 = tileData[ii * 2].unicode();
-                                    char byte2 = tileData[1 + ii * 2].unicode();
+                    graalTiles.resize(width);
+                    decodeBoardRow(tileData.data(), width, graalTiles.data());
 
-                                    auto graalTile = (int)((base64.indexOf(byte1) << 6) + base64.indexOf(byte2));
-                                    auto tile = Level::convertFromGraalTile(graalTile, level->getDefaultTileset());
-                                    tilemap->setTile(x + ii, y, tile);
-
-                                }
-                            }
-                            
-                        }
-                        else if (words[0] == "TILESET" && wordCount >= 2)
-                        {
-                            level->setTilesetName(words[1]);
-                        }
-                        else if (words[0] == "TILESETIMAGE" && wordCount >= 2)
-                        {
-                            level->setTilesetImageName(words[1]);
-                        }
-                        else if (words[0] == "LINK" && wordCount >= 8)
-                        {
-                            auto x = words[2].toDouble() * 16;
-                            auto y = words[3].toDouble() * 16;
-                            auto width = words[4].toInt() * 16;
-                            auto height = words[5].toInt() * 16;
-
-                            auto& nextX = words[6];
-                            auto& nextY = words[7];
-
-                            bool possibleEdgeLink = false;
-                            if ((x == 0 || x == 63 * 16) && width == 16)
-                                possibleEdgeLink = true;
-                            else if ((y == 0 || y == 63 * 16) && height == 16)
-                                possibleEdgeLink = true;
-
-                            auto nextLayer = wordCount >= 9 ? words[8].toInt() : 0;
-                            auto layerIndex = wordCount >= 10 ? words[9].toInt() : 0;
-                            
-                            auto levelLink = new LevelLink(level->getWorld(), level->getX() + x, level->getY() + y, width, height, possibleEdgeLink);
-                            
-                            levelLink->setLevel(level);
-                            levelLink->setNextLevel(words[1]);
-                            levelLink->setNextX(nextX);
-                            levelLink->setNextY(nextY);
-                            levelLink->setNextLayer(nextLayer);
-                            levelLink->setLayerIndex(layerIndex);
-
-                            level->addObject(levelLink);
-                        }
-                        else if (words[0] == "CHEST" && wordCount >= 5)
-                        {
-                            auto& itemName = words[3];
-
-                            if (isNumeric(itemName)) {
-                                auto index = itemName.toInt();
-                                if (index >= 0 && index < int(itemNames.size()))
-                                {
-                                    itemName = itemNames[index];
-                                }
-                            }
-
-                            auto x = words[1].toDouble() * 16;
-                            auto y = words[2].toDouble() * 16;
-
-
-                            auto signIndex = words[4].toInt();
-                            auto layerIndex = wordCount >= 6 ? words[5].toInt() : 0;
-                            auto chest = new LevelChest(level->getWorld(), x + level->getX(), y + level->getY(), itemName, signIndex);
-                            chest->setLayerIndex(layerIndex);
-                            chest->setLevel(level);
-
-                            level->addObject(chest);
-
-                        }
-                        else if (words[0] == "BADDY" && wordCount >= 4)
-                        {
-                            auto x = words[1].toDouble() * 16;
-                            auto y = words[2].toDouble() * 16;
-                            auto baddyName = words[3];
-
-                            int baddyIndex = 0;
-                            if (!isNumeric(baddyName))
-                            {
-                                auto index = baddyNames.indexOf(baddyName);
-                                if (index >= 0)
-                                    baddyIndex = index;
-                            }
-                            else baddyIndex = baddyName.toInt();
-
-                            auto layerIndex = wordCount >= 5 ? words[4].toInt() : 0;
-
-                            auto baddy = new LevelGraalBaddy(level->getWorld(), x + level->getX(), y + level->getY(), baddyIndex);
-                            baddy->setLayerIndex(layerIndex);
-                            baddy->setLevel(level);
-
-                            int verseIndex = 0;
-                            for (++i; i < lineCount && lines[i] != "BADDYEND"; ++i)
-                            {
-                                baddy->setBaddyVerse(verseIndex++, lines[i].trimmed());
-                            }
-
-                            level->addObject(baddy);
-
-                        }
-                        else if (words[0] == "SIGN" && wordCount >= 3)
-                        {
+                    for (size_t ii = 0u; ii < width; ++ii)
+                        LevelModel::setTile(tileLayer, x + ii, y, Level::convertFromGraalTile(graalTiles[ii], defaultTileset));
+                }
+            }
+            else if (words[0] == "TILESET" && wordCount >= 2)
+            {
+                model->setTilesetName(toString(words[1]));
+            }
+            else if (words[0] == "TILESETIMAGE" && wordCount >= 2)
+            {
+                model->setTilesetImageName(toString(words[1]));
+            }
+            else if (words[0] == "LINK" && wordCount >= 8)
+            {
+                auto x = toDouble(words[2]) * 16;
+                auto y = toDouble(words[3]) * 16;
+                auto width = toInt(words[4]) * 16;
+                auto height = toInt(words[5]) * 16;
 
-                            auto sign = new LevelSign(level->getWorld(),
-                                level->getX() + words[1].toDouble() * 16,
-                                level->getY() + words[2].toDouble() * 16,
-                                32,
-                                16);
+                bool possibleEdgeLink = false;
+                if ((x == 0 || x == 63 * 16) && width == 16)
+                    possibleEdgeLink = true;
+                else if ((y == 0 || y == 63 * 16) && height == 16)
+                    possibleEdgeLink = true;
 
-                            auto layerIndex = wordCount >= 4 ? words[3].toInt() : 0;
-                            sign->setLayerIndex(layerIndex);
+                auto nextLayer = wordCount >= 9 ? toInt(words[8]) : 0;
+                auto layerIndex = wordCount >= 10 ? toInt(words[9]) : 0;
 
-                            sign->setLevel(level);
+                model->links.push_back(LevelModel::Link{ x, y, width, height, possibleEdgeLink, toString(words[1]), toString(words[6]), toString(words[7]), nextLayer, layerIndex });
+            }
+            else if (words[0] == "CHEST" && wordCount >= 5)
+            {
+                auto itemName = toString(words[3]);
 
-                            QString text = "";
-                            for (++i; i < lineCount && lines[i] != "SIGNEND"; ++i)
-                                text += lines[i] + '\n';
-                            sign->setText(text);
+                if (isNumeric(words[3])) {
+                    auto index = toInt(words[3]);
+                    if (index >= 0 && index < int(itemNames.size()))
+                    {
+                        itemName = itemNames[index];
+                    }
+                }
 
+                auto x = toDouble(words[1]) * 16;
+                auto y = toDouble(words[2]) * 16;
 
-                            level->addObject(sign);
+                auto signIndex = toInt(words[4]);
+                auto layerIndex = wordCount >= 6 ? toInt(words[5]) : 0;
+                model->chests.push_back(LevelModel::Chest{ x, y, itemName, signIndex, layerIndex });
+            }
+            else if (words[0] == "BADDY" && wordCount >= 4)
+            {
+                auto x = toDouble(words[1]) * 16;
+                auto y = toDouble(words[2]) * 16;
 
-                        }
-                        else if (words[0] == "NPC" && wordCount >= 4)
-                        {
-                            QString image = (words[1] == "-" ? "" : words[1]),
-                                code;
+                int baddyIndex = 0;
+                if (!isNumeric(words[3]))
+                {
+                    auto index = baddyNames.indexOf(toString(words[3]));
+                    if (index >= 0)
+                        baddyIndex = index;
+                }
+                else baddyIndex = toInt(words[3]);
 
-                            double x = words[2].toDouble() * 16.0,
-                                y = words[3].toDouble() * 16.0;
+                auto layerIndex = wordCount >= 5 ? toInt(words[4]) : 0;
 
-                            auto layerIndex = wordCount >= 5 ? words[4].toInt() : 0;
+                LevelModel::Baddy baddy{ x, y, baddyIndex, layerIndex };
+                while (reader.readLine(&line) && line != "BADDYEND")
+                    baddy.verses.push_back(toString(line).trimmed());
 
-                            int width = 48, height = 48;
+                model->baddies.push_back(baddy);
+            }
+            else if (words[0] == "SIGN" && wordCount >= 3)
+            {
+                auto x = toDouble(words[1]) * 16;
+                auto y = toDouble(words[2]) * 16;
+                auto layerIndex = wordCount >= 4 ? toInt(words[3]) : 0;
 
-                           
+                QByteArray text = "";
+                while (reader.readLine(&line) && line != "SIGNEND")
+                {
+                    text.append(line.data(), line.size());
+                    text.append('\n');
+                }
 
-                            for (++i; i < lineCount && lines[i] != "NPCEND"; ++i)
-                            {
-                                auto& line = lines[i];
-                                code += line + "\n";
-                            }
+                model->signs.push_back(LevelModel::Sign{ x, y, layerIndex, QString::fromUtf8(text) });
+            }
+            else if (words[0] == "NPC" && wordCount >= 4)
+            {
+                QString image = (words[1] == "-" ? "" : toString(words[1]));
 
-                            createNPC(level, image, x, y, code);
+                double x = toDouble(words[2]) * 16.0,
+                    y = toDouble(words[3]) * 16.0;
 
-                            
-                        }
-                    }
+                QByteArray code;
+                while (reader.readLine(&line) && line != "NPCEND")
+                {
+                    code.append(line.data(), line.size());
+                    code.append('\n');
                 }
-                return true;
+
+                model->npcs.push_back(LevelModel::NPC{ image, x, y, QString::fromUtf8(code) });
             }
         }
-        return false;
+        return true;
 	}
 
 	bool LevelFormatNW::saveLevel(Level* level, QIODevice* _stream)
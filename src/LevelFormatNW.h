@@ -10,6 +10,7 @@ namespace TilesEditor
 	{
 	public:
 		bool loadLevel(Level* level, QIODevice* stream) override;
+		bool parseLevel(LevelModel* model, Tileset* defaultTileset, QIODevice* stream) override;
 		bool saveLevel(Level* level, QIODevice* stream) override;
 
 		//Apply the format to this level.
@@ -17,6 +18,7 @@ namespace TilesEditor
 
 		bool canSave() const override { return true; }
 		bool canLoad() const override { return true; }
+		bool canParse() const override { return true; }
 
 		bool customLevelSizes() const override { return false; }
 		void filterLevelSize(int* hcount, int* vcount) override { *hcount = 64, *vcount = 64; }
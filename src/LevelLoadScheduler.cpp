@@ -0,0 +1,184 @@
+#include <iterator>
+#include <QLineF>
+#include <QThread>
+#include <QBuffer>
+#include "LevelLoadScheduler.h"
+#include "Level.h"
+#include "FileFormatManager.h"
+#include "LevelSnapshotCache.h"
+
+namespace TilesEditor
+{
+	LevelLoadScheduler::LevelLoadScheduler(AbstractResourceManager* resourceManager, QObject* parent):
+		QObject(parent), m_resourceManager(resourceManager)
+	{
+		m_resourceManager->incrementRef();
+
+		//Loading is mostly waiting on the disk, so a few threads is plenty
+		m_threadPool.setMaxThreadCount(qBound(1, QThread::idealThreadCount(), 4));
+	}
+
+	LevelLoadScheduler::~LevelLoadScheduler()
+	{
+		cancelAll();
+		m_threadPool.waitForDone();
+
+		m_resourceManager->decrementAndDelete();
+	}
+
+	double LevelLoadScheduler::getDistance(Level* level) const
+	{
+		if (!m_hasViewRect)
+			return 0.0;
+
+		auto levelRect = QRectF(level->getX(), level->getY(), level->getWidth(), level->getHeight());
+		return QLineF(levelRect.center(), m_viewRect.center()).length();
+	}
+
+	void LevelLoadScheduler::requestLoad(Level* level, bool cancellable)
+	{
+		if (m_running.contains(level))
+			return;
+
+		auto it = m_pending.find(level);
+		if (it != m_pending.end())
+		{
+			//A preload request for a level that was queued because it was in view
+			it->cancellable = it->cancellable && cancellable;
+			return;
+		}
+
+		std::shared_ptr<Tileset> defaultTileset;
+		if (level->getDefaultTileset())
+		{
+			defaultTileset = std::make_shared<Tileset>();
+			*defaultTileset = *level->getDefaultTileset();
+		}
+
+		//Hashed here rather than on the worker, since tile types are edited on this thread
+		auto tilesetHash = LevelSnapshotCache::instance()->isEnabled() ? LevelSnapshotCache::getTilesetHash(level->getDefaultTileset()) : QByteArray();
+		m_pending.insert(level, Request{ level, level->getFileName(), level->getName(), defaultTileset, tilesetHash, cancellable });
+		dispatch();
+	}
+
+	bool LevelLoadScheduler::cancel(Level* level)
+	{
+		//A running load can't be stopped, but its result will be ignored
+		return m_pending.remove(level) > 0 || m_running.remove(level);
+	}
+
+	void LevelLoadScheduler::cancelAll()
+	{
+		m_pending.clear();
+		m_running.clear();
+		m_threadPool.clear();
+	}
+
+	void LevelLoadScheduler::setViewRect(const QRectF& rect)
+	{
+		m_viewRect = rect;
+		m_hasViewRect = true;
+
+		auto margin = qMax(rect.width(), rect.height()) + 2048.0;
+		auto keepRect = rect.adjusted(-margin, -margin, margin, margin);
+
+		for (auto it = m_pending.begin(); it != m_pending.end();)
+		{
+			auto level = it->level;
+			if (it->cancellable && !keepRect.intersects(QRectF(level->getX(), level->getY(), level->getWidth(), level->getHeight())))
+			{
+				level->setLoadState(LoadState::STATE_NOT_LOADED);
+				it = m_pending.erase(it);
+			}
+			else ++it;
+		}
+	}
+
+	void LevelLoadScheduler::dispatch()
+	{
+		//Only hand out as many levels as there are threads, so the order is decided as late as possible
+		while (!m_pending.isEmpty() && m_running.size() < m_threadPool.maxThreadCount())
+		{
+			auto nearest = m_pending.begin();
+			auto nearestDistance = getDistance(nearest->level);
+			for (auto it = std::next(m_pending.begin()); it != m_pending.end(); ++it)
+			{
+				auto distance = getDistance(it->level);
+				if (distance < nearestDistance)
+				{
+					nearest = it;
+					nearestDistance = distance;
+				}
+			}
+
+			auto request = nearest.value();
+			m_pending.erase(nearest);
+			m_running.insert(request.level);
+
+			auto resourceManager = m_resourceManager;
+			m_threadPool.start([this, resourceManager, request]()
+			{
+				QByteArray fileData;
+				std::shared_ptr<LevelModel> model;
+				bool success = false;
+
+				auto formats = FileFormatManager::instance();
+				auto snapshots = LevelSnapshotCache::instance();
+				auto canParse = formats->canParseLevel(request.levelName);
+
+				//Unchanged levels are read from their snapshot without parsing
+				if (canParse)
+				{
+					model = std::make_shared<LevelModel>();
+					if (snapshots->load(request.fileName, request.tilesetHash, model.get()))
+						success = true;
+					else model.reset();
+				}
+
+				if (!success)
+				{
+					auto stream = resourceManager->openStreamFullPath(request.fileName, QIODeviceBase::ReadOnly);
+					if (stream)
+					{
+						fileData = stream->readAll();
+						success = true;
+						delete stream;
+					}
+
+					if (success && canParse)
+					{
+						QBuffer dataStream(&fileData);
+						dataStream.open(QIODeviceBase::ReadOnly);
+
+						model = std::make_shared<LevelModel>();
+						if (formats->parseLevel(request.levelName, model.get(), request.defaultTileset.get(), &dataStream))
+						{
+							snapshots->save(request.fileName, request.tilesetHash, fileData, *model);
+							fileData.clear();
+						}
+						else model.reset();
+					}
+				}
+
+				QMetaObject::invokeMethod(this, [this, request, fileData, model, success]() {
+					loadFinished(request.level, fileData, model, success);
+				}, Qt::QueuedConnection);
+			});
+		}
+	}
+
+	void LevelLoadScheduler::loadFinished(Level* level, QByteArray fileData, std::shared_ptr<LevelModel> model, bool success)
+	{
+		//Levels cancelled while they were loading are left alone
+		if (m_running.remove(level))
+		{
+			if (model)
+				level->loadModel(*model);
+			else if (success)
+				level->loadFileData(fileData);
+			else level->setLoadState(LoadState::STATE_FAILED);
+		}
+
+		dispatch();
+	}
+};
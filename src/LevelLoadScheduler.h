@@ -0,0 +1,72 @@
+#ifndef LEVELLOADSCHEDULERH
+#define LEVELLOADSCHEDULERH
+
+#include <QObject>
+#include <QThreadPool>
+#include <QHash>
+#include <QSet>
+#include <QRectF>
+#include <QByteArray>
+#include <memory>
+#include "AbstractResourceManager.h"
+#include "LevelModel.h"
+#include "Tileset.h"
+
+namespace TilesEditor
+{
+	class Level;
+
+	//Loads overworld levels on a small pool of worker threads. Formats that can parse into a LevelModel
+	//are parsed on the worker too (or read from their snapshot), leaving only the entities and tiles to be committed on the main thread.
+	//Queued levels are started nearest to the view first, and queued levels that scroll
+	//far out of view are dropped (they go back to STATE_NOT_LOADED and get requested again when visible)
+	class LevelLoadScheduler :
+		public QObject
+	{
+		Q_OBJECT
+
+	private:
+		struct Request {
+			Level* level;
+			QString fileName;
+			QString levelName;
+
+			//A copy of the level's default tileset, since the one in the editor can be changed (or deleted) while the worker parses
+			std::shared_ptr<Tileset> defaultTileset;
+			QByteArray tilesetHash;
+			bool cancellable;
+		};
+
+		AbstractResourceManager* m_resourceManager;
+		QThreadPool m_threadPool;
+
+		QHash<Level*, Request> m_pending;
+		QSet<Level*> m_running;
+
+		QRectF m_viewRect;
+		bool m_hasViewRect = false;
+
+		double getDistance(Level* level) const;
+		void dispatch();
+		void loadFinished(Level* level, QByteArray fileData, std::shared_ptr<LevelModel> model, bool success);
+
+	public:
+		LevelLoadScheduler(AbstractResourceManager* resourceManager, QObject* parent = nullptr);
+		~LevelLoadScheduler();
+
+		//Queue level to be loaded from its file name. Requests for levels already queued or loading are merged
+		void requestLoad(Level* level, bool cancellable = true);
+
+		//Stop loading level. Returns false if it wasn't queued or loading
+		bool cancel(Level* level);
+		void cancelAll();
+
+		//Re-prioritize the queue around the current view and drop queued levels that are now far away
+		void setViewRect(const QRectF& rect);
+
+		int getPendingCount() const { return m_pending.size(); }
+		int getRunningCount() const { return m_running.size(); }
+	};
+};
+
+#endif
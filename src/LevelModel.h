@@ -0,0 +1,104 @@
+#ifndef LEVELMODELH
+#define LEVELMODELH
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QMap>
+#include "Tilemap.h"
+
+namespace TilesEditor
+{
+	//A level as read from a file, without any entities or resources.
+	//Level formats fill this in on worker threads, then Level::applyModel builds the real level on the main thread.
+	//Positions are relative to the level
+	class LevelModel
+	{
+	public:
+		struct TileLayer {
+			int hcount;
+			int vcount;
+			QVector<int> tiles;
+		};
+
+		struct Link {
+			double x;
+			double y;
+			int width;
+			int height;
+			bool possibleEdgeLink;
+			QString nextLevel;
+			QString nextX;
+			QString nextY;
+			int nextLayer;
+			int layerIndex;
+		};
+
+		struct Chest {
+			double x;
+			double y;
+			QString itemName;
+			int signIndex;
+			int layerIndex;
+		};
+
+		struct Baddy {
+			double x;
+			double y;
+			int type;
+			int layerIndex;
+			QStringList verses;
+		};
+
+		struct Sign {
+			double x;
+			double y;
+			int layerIndex;
+			QString text;
+		};
+
+		struct NPC {
+			QString image;
+			double x;
+			double y;
+			QString code;
+		};
+
+		int width = 64 * 16;
+		int height = 64 * 16;
+
+		bool hasTilesetName = false;
+		QString tilesetName;
+		bool hasTilesetImageName = false;
+		QString tilesetImageName;
+
+		QMap<int, TileLayer> tileLayers;
+		QVector<Link> links;
+		QVector<Chest> chests;
+		QVector<Baddy> baddies;
+		QVector<Sign> signs;
+		QVector<NPC> npcs;
+
+		void setTilesetName(const QString& name) { tilesetName = name; hasTilesetName = true; }
+		void setTilesetImageName(const QString& name) { tilesetImageName = name; hasTilesetImageName = true; }
+
+		//New layers are the size of the level and start off invisible
+		TileLayer& getOrMakeTileLayer(int layer) {
+			auto it = tileLayers.find(layer);
+			if (it == tileLayers.end())
+			{
+				auto hcount = width / 16;
+				auto vcount = height / 16;
+				it = tileLayers.insert(layer, TileLayer{ hcount, vcount, QVector<int>(hcount * vcount, Tilemap::MakeInvisibleTile(0)) });
+			}
+			return it.value();
+		}
+
+		static void setTile(TileLayer& tileLayer, unsigned int x, unsigned int y, int tile) {
+			if (x < (unsigned int)tileLayer.hcount && y < (unsigned int)tileLayer.vcount)
+				tileLayer.tiles[y * tileLayer.hcount + x] = tile;
+		}
+	};
+};
+
+#endif
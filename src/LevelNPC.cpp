@@ -163,9 +163,8 @@ namespace TilesEditor
 						image->draw(painter, x + drawWidth / 2 - imageWidth / 2, y + drawHeight / 2 - imageHeight / 2, imageLeft, imageTop, imageWidth, imageHeight);
 					else
 					{
-						if (m_cachedColorMod.isNull())
-							m_cachedColorMod = image->colorMod(m_drawColour);
-						painter->drawPixmap(x + drawWidth / 2 - imageWidth / 2, y + drawHeight / 2 - imageHeight / 2, m_cachedColorMod, imageLeft, imageTop, imageWidth, imageHeight);
+						//Shared with every other npc drawing this image in the same colour
+						painter->drawPixmap(x + drawWidth / 2 - imageWidth / 2, y + drawHeight / 2 - imageHeight / 2, image->colorMod(m_drawColour), imageLeft, imageTop, imageWidth, imageHeight);
 					}
 				}
 				break;
@@ -310,9 +309,6 @@ namespace TilesEditor
 
 	void LevelNPC::setColourEffect(double r, double g, double b, double a)
 	{
-		QPixmap blank;
-		m_cachedColorMod.swap(blank);
-
 		m_drawAsLight = true;
 		m_drawColour = QColor(int(r * 255), int(g * 255), int(b * 255), int(a * 255));
 	}
@@ -434,7 +430,9 @@ namespace TilesEditor
 
 	void LevelNPC::fileReady(const QString& fileName, AbstractResourceManager* resourceManager)
 	{
+		//The image may have been decoded in the background after the blank npc was drawn
 		calculateDimensions();
+		getWorld()->redrawScene(toQRectF());
 	}
 
 	void LevelNPC::fileWritten(const QString& fileName, AbstractResourceManager* resourceManager)
@@ -37,7 +37,6 @@ namespace TilesEditor
 		QString m_imageName;
 		QString m_code;
 		Image* m_image;
-		QPixmap m_cachedColorMod;
 
 
 		bool m_hasResized = false;
@@ -0,0 +1,385 @@
+#include <cstring>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QSaveFile>
+#include <QCryptographicHash>
+#include "LevelSnapshotCache.h"
+
+namespace TilesEditor
+{
+	namespace
+	{
+		const quint32 SNAPSHOT_MAGIC = 0x504E5354; //"TSNP"
+
+		struct SnapshotHeader {
+			quint32 magic;
+			quint32 version;
+			qint64 sourceSize;
+			qint64 sourceModified;
+			char sourceHash[20];
+			char tilesetHash[20];
+		};
+
+		class SnapshotWriter
+		{
+		private:
+			QByteArray& m_data;
+
+		public:
+			SnapshotWriter(QByteArray& data): m_data(data) {}
+
+			template <typename T>
+			void write(T value) { m_data.append(reinterpret_cast<const char*>(&value), sizeof(T)); }
+
+			void writeString(const QString& text) {
+				write<qint32>(text.size());
+				m_data.append(reinterpret_cast<const char*>(text.constData()), text.size() * sizeof(QChar));
+			}
+
+			void writeStringList(const QStringList& list) {
+				write<qint32>(list.size());
+				for (auto& text : list)
+					writeString(text);
+			}
+
+			void writeInts(const QVector<int>& values) {
+				m_data.append(reinterpret_cast<const char*>(values.constData()), values.size() * sizeof(int));
+			}
+		};
+
+		//Reads from the mapped file. Anything past the end marks the snapshot as bad rather than reading out of bounds
+		class SnapshotReader
+		{
+		private:
+			const uchar* m_data;
+			qint64 m_size;
+			qint64 m_pos = 0;
+			bool m_ok = true;
+
+			bool canRead(qint64 bytes) {
+				if (bytes < 0 || bytes > m_size - m_pos)
+					m_ok = false;
+				return m_ok;
+			}
+
+		public:
+			SnapshotReader(const uchar* data, qint64 size): m_data(data), m_size(size) {}
+
+			bool isOk() const { return m_ok; }
+			bool atEnd() const { return m_pos == m_size; }
+
+			template <typename T>
+			T read() {
+				T value{};
+				if (canRead(sizeof(T)))
+				{
+					std::memcpy(&value, m_data + m_pos, sizeof(T));
+					m_pos += sizeof(T);
+				}
+				return value;
+			}
+
+			QString readString() {
+				auto length = read<qint32>();
+				if (!canRead(qint64(length) * sizeof(QChar)))
+					return QString();
+
+				QString retval(length, Qt::Uninitialized);
+				std::memcpy(retval.data(), m_data + m_pos, length * sizeof(QChar));
+				m_pos += length * sizeof(QChar);
+				return retval;
+			}
+
+			QStringList readStringList() {
+				QStringList retval;
+				auto count = read<qint32>();
+				for (auto i = 0; i < count && m_ok; ++i)
+					retval.push_back(readString());
+				return retval;
+			}
+
+			void readInts(QVector<int>& values, qint64 count) {
+				if (!canRead(count * sizeof(int)))
+					return;
+
+				values.resize(count);
+				std::memcpy(values.data(), m_data + m_pos, count * sizeof(int));
+				m_pos += count * sizeof(int);
+			}
+		};
+
+		//A bad count just runs the reader out of data
+		qint32 readCount(SnapshotReader& reader)
+		{
+			auto count = reader.read<qint32>();
+			return count < 0 ? 0 : count;
+		}
+	}
+
+	void LevelSnapshotCache::setDirectory(const QString& directory)
+	{
+		m_directory = directory;
+		if (!m_directory.isEmpty())
+			QDir().mkpath(m_directory);
+	}
+
+	QString LevelSnapshotCache::getSnapshotFileName(const QString& fileName) const
+	{
+		auto hash = QCryptographicHash::hash(QDir::cleanPath(fileName).toUtf8(), QCryptographicHash::Sha1).toHex();
+		return QDir(m_directory).filePath(QString::fromLatin1(hash) + ".snap");
+	}
+
+	QByteArray LevelSnapshotCache::getTilesetHash(Tileset* tileset)
+	{
+		//Tile types are baked into the tiles of nw and graal levels, so they are part of the snapshot
+		if (tileset)
+			return tileset->getHash();
+		return QCryptographicHash::hash(QByteArray(), QCryptographicHash::Sha1);
+	}
+
+	bool LevelSnapshotCache::load(const QString& fileName, const QByteArray& tilesetHash, LevelModel* model)
+	{
+		if (!isEnabled())
+			return false;
+
+		QFileInfo sourceInfo(fileName);
+		if (!sourceInfo.exists())
+			return false;
+
+		QFile file(getSnapshotFileName(fileName));
+		if (!file.open(QIODevice::ReadOnly) || file.size() < qint64(sizeof(SnapshotHeader)))
+			return false;
+
+		auto data = file.map(0, file.size());
+		if (!data)
+			return false;
+
+		SnapshotHeader header;
+		std::memcpy(&header, data, sizeof(header));
+
+		if (header.magic != SNAPSHOT_MAGIC || header.version != VERSION || header.sourceSize != sourceInfo.size())
+			return false;
+
+		if (tilesetHash != QByteArray(header.tilesetHash, sizeof(header.tilesetHash)))
+			return false;
+
+		//The file was touched, so check it still has the same contents
+		auto touched = header.sourceModified != sourceInfo.lastModified().toMSecsSinceEpoch();
+		QByteArray sourceData;
+		if (touched)
+		{
+			QFile source(fileName);
+			if (!source.open(QIODevice::ReadOnly))
+				return false;
+
+			sourceData = source.readAll();
+			if (QCryptographicHash::hash(sourceData, QCryptographicHash::Sha1) != QByteArray(header.sourceHash, sizeof(header.sourceHash)))
+				return false;
+		}
+
+		SnapshotReader reader(data + sizeof(header), file.size() - sizeof(header));
+
+		LevelModel retval;
+		retval.width = reader.read<qint32>();
+		retval.height = reader.read<qint32>();
+
+		if (reader.read<quint8>())
+			retval.setTilesetName(reader.readString());
+
+		if (reader.read<quint8>())
+			retval.setTilesetImageName(reader.readString());
+
+		auto layerCount = readCount(reader);
+		for (auto i = 0; i < layerCount && reader.isOk(); ++i)
+		{
+			LevelModel::TileLayer tileLayer;
+			auto layerIndex = reader.read<qint32>();
+			tileLayer.hcount = qMax(0, reader.read<qint32>());
+			tileLayer.vcount = qMax(0, reader.read<qint32>());
+			reader.readInts(tileLayer.tiles, qint64(tileLayer.hcount) * tileLayer.vcount);
+			retval.tileLayers.insert(layerIndex, tileLayer);
+		}
+
+		auto linkCount = readCount(reader);
+		for (auto i = 0; i < linkCount && reader.isOk(); ++i)
+		{
+			LevelModel::Link link;
+			link.x = reader.read<double>();
+			link.y = reader.read<double>();
+			link.width = reader.read<qint32>();
+			link.height = reader.read<qint32>();
+			link.possibleEdgeLink = reader.read<quint8>() != 0;
+			link.nextLevel = reader.readString();
+			link.nextX = reader.readString();
+			link.nextY = reader.readString();
+			link.nextLayer = reader.read<qint32>();
+			link.layerIndex = reader.read<qint32>();
+			retval.links.push_back(link);
+		}
+
+		auto chestCount = readCount(reader);
+		for (auto i = 0; i < chestCount && reader.isOk(); ++i)
+		{
+			LevelModel::Chest chest;
+			chest.x = reader.read<double>();
+			chest.y = reader.read<double>();
+			chest.itemName = reader.readString();
+			chest.signIndex = reader.read<qint32>();
+			chest.layerIndex = reader.read<qint32>();
+			retval.chests.push_back(chest);
+		}
+
+		auto baddyCount = readCount(reader);
+		for (auto i = 0; i < baddyCount && reader.isOk(); ++i)
+		{
+			LevelModel::Baddy baddy;
+			baddy.x = reader.read<double>();
+			baddy.y = reader.read<double>();
+			baddy.type = reader.read<qint32>();
+			baddy.layerIndex = reader.read<qint32>();
+			baddy.verses = reader.readStringList();
+			retval.baddies.push_back(baddy);
+		}
+
+		auto signCount = readCount(reader);
+		for (auto i = 0; i < signCount && reader.isOk(); ++i)
+		{
+			LevelModel::Sign sign;
+			sign.x = reader.read<double>();
+			sign.y = reader.read<double>();
+			sign.layerIndex = reader.read<qint32>();
+			sign.text = reader.readString();
+			retval.signs.push_back(sign);
+		}
+
+		auto npcCount = readCount(reader);
+		for (auto i = 0; i < npcCount && reader.isOk(); ++i)
+		{
+			LevelModel::NPC npc;
+			npc.image = reader.readString();
+			npc.x = reader.read<double>();
+			npc.y = reader.read<double>();
+			npc.code = reader.readString();
+			retval.npcs.push_back(npc);
+		}
+
+		if (!reader.isOk() || !reader.atEnd())
+			return false;
+
+		*model = std::move(retval);
+
+		//Same contents as before, so save it again with the new modified time. The snapshot is replaced as a whole
+		//(other threads may be reading it), and if that fails the hash check still finds it next time
+		if (touched)
+		{
+			file.unmap(data);
+			file.close();
+			save(fileName, tilesetHash, sourceData, *model);
+		}
+		return true;
+	}
+
+	void LevelSnapshotCache::save(const QString& fileName, const QByteArray& tilesetHash, const QByteArray& fileData, const LevelModel& model)
+	{
+		if (!isEnabled())
+			return;
+
+		//Changed again since it was read
+		QFileInfo sourceInfo(fileName);
+		if (!sourceInfo.exists() || sourceInfo.size() != fileData.size())
+			return;
+
+		SnapshotHeader header;
+		header.magic = SNAPSHOT_MAGIC;
+		header.version = VERSION;
+		header.sourceSize = fileData.size();
+		header.sourceModified = sourceInfo.lastModified().toMSecsSinceEpoch();
+
+		auto sourceHash = QCryptographicHash::hash(fileData, QCryptographicHash::Sha1);
+		std::memcpy(header.sourceHash, sourceHash.constData(), sizeof(header.sourceHash));
+		std::memcpy(header.tilesetHash, tilesetHash.constData(), sizeof(header.tilesetHash));
+
+		QByteArray data;
+		data.append(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		SnapshotWriter writer(data);
+		writer.write<qint32>(model.width);
+		writer.write<qint32>(model.height);
+
+		writer.write<quint8>(model.hasTilesetName);
+		if (model.hasTilesetName)
+			writer.writeString(model.tilesetName);
+
+		writer.write<quint8>(model.hasTilesetImageName);
+		if (model.hasTilesetImageName)
+			writer.writeString(model.tilesetImageName);
+
+		writer.write<qint32>(model.tileLayers.size());
+		for (auto it = model.tileLayers.begin(); it != model.tileLayers.end(); ++it)
+		{
+			writer.write<qint32>(it.key());
+			writer.write<qint32>(it->hcount);
+			writer.write<qint32>(it->vcount);
+			writer.writeInts(it->tiles);
+		}
+
+		writer.write<qint32>(model.links.size());
+		for (auto& link : model.links)
+		{
+			writer.write<double>(link.x);
+			writer.write<double>(link.y);
+			writer.write<qint32>(link.width);
+			writer.write<qint32>(link.height);
+			writer.write<quint8>(link.possibleEdgeLink);
+			writer.writeString(link.nextLevel);
+			writer.writeString(link.nextX);
+			writer.writeString(link.nextY);
+			writer.write<qint32>(link.nextLayer);
+			writer.write<qint32>(link.layerIndex);
+		}
+
+		writer.write<qint32>(model.chests.size());
+		for (auto& chest : model.chests)
+		{
+			writer.write<double>(chest.x);
+			writer.write<double>(chest.y);
+			writer.writeString(chest.itemName);
+			writer.write<qint32>(chest.signIndex);
+			writer.write<qint32>(chest.layerIndex);
+		}
+
+		writer.write<qint32>(model.baddies.size());
+		for (auto& baddy : model.baddies)
+		{
+			writer.write<double>(baddy.x);
+			writer.write<double>(baddy.y);
+			writer.write<qint32>(baddy.type);
+			writer.write<qint32>(baddy.layerIndex);
+			writer.writeStringList(baddy.verses);
+		}
+
+		writer.write<qint32>(model.signs.size());
+		for (auto& sign : model.signs)
+		{
+			writer.write<double>(sign.x);
+			writer.write<double>(sign.y);
+			writer.write<qint32>(sign.layerIndex);
+			writer.writeString(sign.text);
+		}
+
+		writer.write<qint32>(model.npcs.size());
+		for (auto& npc : model.npcs)
+		{
+			writer.writeString(npc.image);
+			writer.write<double>(npc.x);
+			writer.write<double>(npc.y);
+			writer.writeString(npc.code);
+		}
+
+		//Written to a temporary file first, so other threads never map half a snapshot
+		QSaveFile file(getSnapshotFileName(fileName));
+		if (file.open(QIODevice::WriteOnly) && file.write(data) == data.size())
+			file.commit();
+	}
+};
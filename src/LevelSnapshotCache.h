@@ -0,0 +1,48 @@
+#ifndef LEVELSNAPSHOTCACHEH
+#define LEVELSNAPSHOTCACHEH
+
+#include <QString>
+#include <QByteArray>
+#include "LevelModel.h"
+#include "Tileset.h"
+
+namespace TilesEditor
+{
+	//Binary copies of parsed levels, so level files that haven't changed can be loaded again without parsing them.
+	//A snapshot is only used if the level file has the same size and contents (checked by modified time, or a hash
+	//of the file when that differs) and was parsed with the same default tileset.
+	//Used from the loader threads, so the directory must only be set before any levels are loaded
+	class LevelSnapshotCache
+	{
+	private:
+		//Increase this whenever a level format parses anything differently
+		static const quint32 VERSION = 1;
+
+		QString m_directory;
+
+		QString getSnapshotFileName(const QString& fileName) const;
+
+	public:
+		//Snapshots are turned off when directory is empty
+		void setDirectory(const QString& directory);
+		const QString& getDirectory() const { return m_directory; }
+		bool isEnabled() const { return !m_directory.isEmpty(); }
+
+		//Hash of everything in the default tileset that a parsed level depends on. Tile types can be edited,
+		//so this is worked out on the main thread and passed to the loader threads
+		static QByteArray getTilesetHash(Tileset* tileset);
+
+		//Fill model from the snapshot of the level file fileName. Returns false if there isn't a valid one
+		bool load(const QString& fileName, const QByteArray& tilesetHash, LevelModel* model);
+
+		//Save model as the snapshot of fileName. fileData is the level file's contents, as parsed
+		void save(const QString& fileName, const QByteArray& tilesetHash, const QByteArray& fileData, const LevelModel& model);
+
+		static LevelSnapshotCache* instance() {
+			static auto retval = new LevelSnapshotCache();
+			return retval;
+		}
+	};
+};
+
+#endif
@@ -0,0 +1,290 @@
+#include <cmath>
+#include <algorithm>
+#include <QThread>
+#include "LevelThumbnails.h"
+#include "TileBlitter.h"
+
+namespace TilesEditor
+{
+	qint64 LevelThumbnails::memoryBudget = 256 * 1024 * 1024;
+
+	LevelThumbnails::LevelThumbnails(QObject* parent):
+		QObject(parent)
+	{
+		m_threadPool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+	}
+
+	LevelThumbnails::~LevelThumbnails()
+	{
+		m_threadPool.clear();
+		m_threadPool.waitForDone();
+	}
+
+	int LevelThumbnails::getMipLevel(double scale)
+	{
+		if (scale <= 0.0 || scale >= 0.5)
+			return 0;
+
+		return qBound(1, int(std::floor(std::log2(1.0 / scale))), MAX_MIP_LEVEL);
+	}
+
+	LevelThumbnails::Key LevelThumbnails::makeKey(Level* level, Image* tilesetImage, const QVector<int>& layers)
+	{
+		Key retval;
+		retval.tileset = tilesetImage;
+		retval.tileDefsRevision = level->getTileDefsRevision();
+
+		for (auto index : layers)
+		{
+			auto tilemap = level->getTileLayers().value(index);
+			if (tilemap)
+				retval.layers.push_back(QPair<int, quint64>(index, tilemap->getRevision()));
+		}
+		return retval;
+	}
+
+	bool LevelThumbnails::draw(QPainter* painter, Level* level, Image* tilesetImage, const QVector<int>& layers, int mipLevel)
+	{
+		auto key = makeKey(level, tilesetImage, layers);
+
+		auto it = m_entries.find(level);
+		if (it == m_entries.end())
+			it = m_entries.insert(level, Entry());
+
+		auto& entry = it.value();
+		entry.lastUsed = ++m_useCounter;
+
+		//Remake it if it is out of date, or doesn't go down to this mip level
+		auto upToDate = entry.key == key && !entry.mips.isEmpty() && entry.firstMip <= mipLevel;
+		auto queued = entry.pending && entry.pendingKey == key && entry.pendingFirstMip <= mipLevel;
+		if (!upToDate && !queued)
+			queueRender(level, tilesetImage, layers, key, mipLevel);
+
+		//Nothing rendered yet, so use the one saved on disk if there is one
+		if (entry.mips.isEmpty())
+		{
+			if (layers.size() != level->getTileLayers().size())
+				return false;
+
+			auto status = drawSaved(painter, level, tilesetImage);
+			return status == ThumbnailDiskCache::Status::Fresh || status == ThumbnailDiskCache::Status::Stale;
+		}
+
+		//Don't hold on to the bigger mip levels when zoomed out further than they are needed
+		if (upToDate && !entry.pending && entry.firstMip < mipLevel - 1)
+			setMips(entry, mipLevel - 1, entry.mips.mid((mipLevel - 1) - entry.firstMip));
+
+		auto index = qBound(0, mipLevel - entry.firstMip, int(entry.mips.size()) - 1);
+		painter->drawImage(QRectF(level->getX(), level->getY(), level->getWidth(), level->getHeight()), entry.mips[index]);
+		return true;
+	}
+
+	ThumbnailDiskCache::Status LevelThumbnails::drawSaved(QPainter* painter, Level* level, Image* tilesetImage)
+	{
+		return drawSaved(painter, level->getFileName(), QRectF(level->getX(), level->getY(), level->getWidth(), level->getHeight()), tilesetImage);
+	}
+
+	ThumbnailDiskCache::Status LevelThumbnails::drawSaved(QPainter* painter, const QString& fileName, const QRectF& rect, Image* tilesetImage)
+	{
+		if (!m_diskCache || fileName.isEmpty())
+			return ThumbnailDiskCache::Status::Missing;
+
+		m_diskCache->trim(getDiskBudget());
+
+		QImage image;
+		auto status = m_diskCache->find(fileName, tilesetImage->getName(), &image);
+		if (!image.isNull())
+			painter->drawImage(rect, image);
+		return status;
+	}
+
+	void LevelThumbnails::queueRender(Level* level, Image* tilesetImage, const QVector<int>& layers, const Key& key, int firstMip)
+	{
+		auto& entry = m_entries[level];
+		entry.pending = true;
+		entry.pendingKey = key;
+		entry.pendingFirstMip = firstMip;
+
+		auto job = std::make_shared<Job>();
+		job->level = level;
+		job->serial = m_nextSerial++;
+		job->key = key;
+		job->firstMip = firstMip;
+		job->width = level->getWidth();
+		job->height = level->getHeight();
+		job->tileset = tilesetImage->premultipliedImage();
+
+		for (auto index : layers)
+		{
+			auto tilemap = level->getTileLayers().value(index);
+			if (tilemap)
+				job->layers.push_back(std::make_shared<Tilemap>(*tilemap));
+		}
+
+		for (auto& tileDef : level->getTileDefs())
+			job->tileDefs.push_back(QPair<QRect, QImage>(tileDef.first, tileDef.second ? tileDef.second->premultipliedImage() : QImage()));
+		job->tileDefLookupBounds = level->getTileDefLookupBounds();
+		job->tileDefLookup = level->getTileDefLookup();
+
+		//Only thumbnails of every layer, as they are in the level file, are saved to disk
+		if (m_diskCache && !level->getFileName().isEmpty() && !level->getModified() && layers.size() == level->getTileLayers().size())
+		{
+			job->fileName = level->getFileName();
+			job->tilesetName = tilesetImage->getName();
+		}
+
+		m_threadPool.start([this, job]()
+		{
+			render(job.get());
+			QMetaObject::invokeMethod(this, [this, job]() { applyJob(job); }, Qt::QueuedConnection);
+		});
+	}
+
+	void LevelThumbnails::render(Job* job)
+	{
+		QImage image(job->width, job->height, QImage::Format_ARGB32_Premultiplied);
+		image.fill(Qt::transparent);
+
+		//Each layer is blitted on its own (the blitter only writes to transparent pixels) then drawn over the layers below
+		QImage layerImage;
+		QPainter painter(&image);
+		for (auto& tilemap : job->layers)
+		{
+			auto target = &image;
+			if (tilemap != job->layers.first())
+			{
+				if (layerImage.isNull())
+					layerImage = QImage(job->width, job->height, QImage::Format_ARGB32_Premultiplied);
+				layerImage.fill(Qt::transparent);
+				target = &layerImage;
+			}
+
+			TileBlitter blitter(target);
+			for (auto y = 0; y < tilemap->getVCount(); ++y)
+			{
+				for (auto x = 0; x < tilemap->getHCount(); ++x)
+				{
+					auto tile = tilemap->getTile(x, y);
+					if (Tilemap::IsInvisibleTile(tile) && Tilemap::GetTileTranslucency(tile) != 15)
+						continue;
+
+					auto tileX = Tilemap::GetTileX(tile);
+					auto tileY = Tilemap::GetTileY(tile);
+					auto translucency = Tilemap::GetTileTranslucency(tile);
+
+					//Same as Level::getTileDef
+					const QPair<QRect, QImage>* tileDef = nullptr;
+					auto& bounds = job->tileDefLookupBounds;
+					if (bounds.contains(tileX, tileY))
+					{
+						auto index = job->tileDefLookup.at((tileY - bounds.y()) * bounds.width() + (tileX - bounds.x()));
+						if (index >= 0)
+							tileDef = &job->tileDefs.at(index);
+					}
+
+					if (tileDef)
+						blitter.drawTile(x * 16, y * 16, tileDef->second, tileX * 16 - tileDef->first.x(), tileY * 16 - tileDef->first.y(), translucency);
+					else blitter.drawTile(x * 16, y * 16, job->tileset, tileX * 16, tileY * 16, translucency);
+				}
+			}
+
+			if (target == &layerImage)
+				painter.drawImage(0, 0, layerImage);
+		}
+		painter.end();
+
+		//Halve the size for each mip level
+		for (auto mipLevel = 1; mipLevel <= MAX_MIP_LEVEL && image.width() > 1 && image.height() > 1; ++mipLevel)
+		{
+			image = image.scaled(image.width() / 2, image.height() / 2, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+			if (mipLevel >= job->firstMip)
+				job->mips.push_back(image);
+
+			if (mipLevel == DISK_MIP_LEVEL && !job->fileName.isEmpty())
+				job->diskImage = image;
+		}
+
+		if (!job->diskImage.isNull())
+			job->diskSource = ThumbnailDiskCache::getSource(job->fileName, job->tilesetName);
+
+		//Don't hold on to the tiles any longer than needed
+		job->layers.clear();
+		job->tileDefs.clear();
+		job->tileDefLookup.clear();
+		job->tileset = QImage();
+	}
+
+	void LevelThumbnails::applyJob(std::shared_ptr<Job> job)
+	{
+		//The level was removed (or a newer render has already finished)
+		auto it = m_entries.find(job->level);
+		if (it == m_entries.end() || it->serial > job->serial || job->mips.isEmpty())
+			return;
+
+		if (!job->diskImage.isNull() && job->diskSource.size >= 0 && !m_diskCache->contains(job->diskSource))
+			m_diskCache->insert(job->diskSource, job->diskImage);
+
+		auto& entry = it.value();
+		entry.key = job->key;
+		entry.serial = job->serial;
+		setMips(entry, job->firstMip, job->mips);
+
+		if (entry.pendingKey == job->key && entry.pendingFirstMip == job->firstMip)
+			entry.pending = false;
+
+		evict(job->level);
+		emit ready();
+	}
+
+	void LevelThumbnails::setMips(Entry& entry, int firstMip, const QVector<QImage>& mips)
+	{
+		m_bytes -= entry.bytes;
+
+		entry.firstMip = firstMip;
+		entry.mips = mips;
+		entry.bytes = 0;
+		for (auto& mip : mips)
+			entry.bytes += mip.sizeInBytes();
+
+		m_bytes += entry.bytes;
+	}
+
+	void LevelThumbnails::evict(Level* keep)
+	{
+		auto budget = memoryBudget - getDiskBudget();
+		if (memoryBudget <= 0 || m_bytes <= budget)
+			return;
+
+		//Thumbnails still being rendered are left alone, since their render would only add them back
+		QList<QPair<quint64, Level*>> candidates;
+		for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it)
+		{
+			if (it.key() != keep && !it->pending && it->bytes > 0)
+				candidates.push_back(QPair<quint64, Level*>(it->lastUsed, it.key()));
+		}
+
+		std::sort(candidates.begin(), candidates.end());
+		for (auto& candidate : candidates)
+		{
+			if (m_bytes <= budget)
+				break;
+			remove(candidate.second);
+		}
+	}
+
+	void LevelThumbnails::remove(Level* level)
+	{
+		auto it = m_entries.find(level);
+		if (it != m_entries.end())
+		{
+			m_bytes -= it->bytes;
+			m_entries.erase(it);
+		}
+	}
+
+	void LevelThumbnails::clear()
+	{
+		m_entries.clear();
+		m_bytes = 0;
+	}
+};
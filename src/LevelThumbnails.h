@@ -0,0 +1,133 @@
+#ifndef LEVELTHUMBNAILSH
+#define LEVELTHUMBNAILSH
+
+#include <memory>
+#include <QObject>
+#include <QThreadPool>
+#include <QPainter>
+#include <QHash>
+#include <QVector>
+#include <QPair>
+#include <QImage>
+#include "Level.h"
+#include "Tilemap.h"
+#include "Image.h"
+#include "ThumbnailDiskCache.h"
+
+namespace TilesEditor
+{
+	//Downsampled renders (1/2, 1/4, 1/8...) of each level's tile layers, for drawing levels when zoomed far out.
+	//Thumbnails are rendered on background threads, and remade when the tiles, tile defs or tileset change.
+	//The least recently drawn thumbnails are dropped when they use more than memoryBudget
+	class LevelThumbnails :
+		public QObject
+	{
+		Q_OBJECT
+
+	public:
+		//Mip level 1 is half size, 2 is a quarter size and so on
+		static const int MAX_MIP_LEVEL = 6;
+
+		//Mip level saved to the disk cache (64x64 for a normal level)
+		static const int DISK_MIP_LEVEL = 4;
+
+	private:
+		//Everything a thumbnail depends on
+		struct Key {
+			Image* tileset = nullptr;
+			quint64 tileDefsRevision = 0;
+			QVector<QPair<int, quint64>> layers;
+
+			bool operator==(const Key& other) const {
+				return tileset == other.tileset && tileDefsRevision == other.tileDefsRevision && layers == other.layers;
+			}
+			bool operator!=(const Key& other) const { return !(*this == other); }
+		};
+
+		struct Entry {
+			Key key;
+			quint64 serial = 0;
+
+			//mips[i] is mip level firstMip + i
+			int firstMip = 0;
+			QVector<QImage> mips;
+			qint64 bytes = 0;
+			quint64 lastUsed = 0;
+
+			//The newest render that has been queued
+			bool pending = false;
+			Key pendingKey;
+			int pendingFirstMip = 0;
+		};
+
+		//A level's tiles as they were when the render was queued. The tilemaps are copies sharing the level's tile chunks
+		struct Job {
+			Level* level;
+			quint64 serial;
+			Key key;
+			int firstMip;
+			int width;
+			int height;
+			QImage tileset;
+			QVector<std::shared_ptr<Tilemap>> layers;
+
+			//Indexed the same as Level::getTileDefs, looked up through a copy of the level's table
+			QVector<QPair<QRect, QImage>> tileDefs;
+			QRect tileDefLookupBounds;
+			QVector<int> tileDefLookup;
+			QVector<QImage> mips;
+
+			//Set when the thumbnail is of the whole level and should be saved to disk
+			QString fileName;
+			QString tilesetName;
+			ThumbnailDiskCache::Source diskSource;
+			QImage diskImage;
+		};
+
+		QThreadPool m_threadPool;
+		QHash<Level*, Entry> m_entries;
+		quint64 m_nextSerial = 1;
+		quint64 m_useCounter = 0;
+		qint64 m_bytes = 0;
+		ThumbnailDiskCache* m_diskCache = nullptr;
+
+		static Key makeKey(Level* level, Image* tilesetImage, const QVector<int>& layers);
+		static void render(Job* job);
+
+		void queueRender(Level* level, Image* tilesetImage, const QVector<int>& layers, const Key& key, int firstMip);
+		void applyJob(std::shared_ptr<Job> job);
+		void setMips(Entry& entry, int firstMip, const QVector<QImage>& mips);
+		void evict(Level* keep);
+
+	signals:
+		void ready();
+
+	public:
+		//Bytes of thumbnails to keep in memory, including a quarter for the ones read from disk. 0 to keep them all
+		static qint64 memoryBudget;
+		static qint64 getDiskBudget() { return memoryBudget / 4; }
+
+		LevelThumbnails(QObject* parent = nullptr);
+		~LevelThumbnails();
+
+		//Mip level to draw with at this view scale, or 0 when the tiles should be drawn as normal
+		static int getMipLevel(double scale);
+
+		void setDiskCache(ThumbnailDiskCache* diskCache) { m_diskCache = diskCache; }
+
+		//Draw level from the thumbnail saved on disk, without needing it to be loaded. Returns the status of the saved thumbnail
+		ThumbnailDiskCache::Status drawSaved(QPainter* painter, Level* level, Image* tilesetImage);
+
+		//The same, for a level file that may not have a Level yet
+		ThumbnailDiskCache::Status drawSaved(QPainter* painter, const QString& fileName, const QRectF& rect, Image* tilesetImage);
+
+		//Draw layers of level from its thumbnail, queueing a new one if it is missing or out of date.
+		//An out of date thumbnail is still drawn while the new one is made. Returns false if there is nothing to draw yet
+		bool draw(QPainter* painter, Level* level, Image* tilesetImage, const QVector<int>& layers, int mipLevel);
+
+		void remove(Level* level);
+		void clear();
+	};
+};
+
+#endif
@@ -26,6 +26,8 @@
 #include "AniEditor/AniEditorWindow.h"
 #include "ResourceManagerFileSystem.h"
 #include "EditTileDefs.h"
+#include "LevelSnapshotCache.h"
+#include "FileNameIndex.h"
 
 namespace TilesEditor
 {
@@ -51,11 +53,20 @@ namespace TilesEditor
             m_objectFolderChanged = true;
         }
 
+        //Folder listings are saved so the next start only has to check which folders changed
+        FileNameIndex::instance()->setFileName(QDir(exeDir).filePath("cache/fileindex.dat"));
+
         m_objectManager = new ObjectManager(ui.objectTree, objectsFolder);
         m_resourceManager = new ResourceManagerFileSystem(rootDir, m_objectManager);
        
         m_resourceManager->incrementRef();
 
+        m_thumbnailDiskCache = new ThumbnailDiskCache(QDir(exeDir).filePath("cache/thumbnails"), this);
+
+        //Parsed levels are saved as binary snapshots unless turned off
+        if (settings.value("levelSnapshots", true).toBool())
+            LevelSnapshotCache::instance()->setDirectory(QDir(exeDir).filePath("cache/snapshots"));
+
         m_defaultPalette = app.palette();
 
         QMainWindow::setTabPosition(Qt::AllDockWidgetAreas, QTabWidget::North);
@@ -141,6 +152,21 @@ namespace TilesEditor
         if (settings.contains("viewPositionsMax"))
             m_maxScrollPositions = settings.value("viewPositionsMax").toInt();
 
+        //In megabytes. Levels are loaded up to 1000 pixels outside the view, so never unload those
+        if (settings.contains("overworldMemoryBudget"))
+            Overworld::memoryBudget = settings.value("overworldMemoryBudget").toLongLong() * 1024 * 1024;
+
+        //In megabytes. Freed images and anis are kept until they use more than this
+        if (settings.contains("resourceRetentionBudget"))
+            AbstractResourceManager::retentionBudget = settings.value("resourceRetentionBudget").toLongLong() * 1024 * 1024;
+
+        //In megabytes. Zoomed out level thumbnails are dropped (least recently drawn first) when they use more than this
+        if (settings.contains("levelThumbnailBudget"))
+            LevelThumbnails::memoryBudget = settings.value("levelThumbnailBudget").toLongLong() * 1024 * 1024;
+
+        if (settings.contains("overworldEvictionRadius"))
+            Overworld::evictionRadius = qMax(1024.0, settings.value("overworldEvictionRadius").toDouble());
+
         auto scrollPositions = settings.value("viewPositions").toStringList();
         for (auto& item : scrollPositions)
         {
@@ -331,6 +357,11 @@ namespace TilesEditor
 
         
         settings.setValue("viewPositionsMax", m_maxScrollPositions);
+        settings.setValue("overworldMemoryBudget", Overworld::memoryBudget / (1024 * 1024));
+        settings.setValue("overworldEvictionRadius", Overworld::evictionRadius);
+        settings.setValue("resourceRetentionBudget", AbstractResourceManager::retentionBudget / (1024 * 1024));
+        settings.setValue("levelThumbnailBudget", LevelThumbnails::memoryBudget / (1024 * 1024));
+        settings.setValue("levelSnapshots", LevelSnapshotCache::instance()->isEnabled());
         settings.setValue("viewPositions", scrollPositions);
         if (m_objectFolderChanged)
         {
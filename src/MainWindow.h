@@ -15,6 +15,7 @@
 #include "IEngine.h"
 #include "ResourceManagerFileSystem.h"
 #include "TileDefs.h"
+#include "ThumbnailDiskCache.h"
 
 namespace TilesEditor
 {
@@ -59,6 +60,7 @@ namespace TilesEditor
 
         bool m_objectFolderChanged = false;
         ResourceManagerFileSystem* m_resourceManager;
+        ThumbnailDiskCache* m_thumbnailDiskCache;
         ObjectManager* m_objectManager;
         QStandardItemModel m_tilesetList;
         TileGroupListModel m_tileGroupsList;
@@ -104,6 +106,7 @@ namespace TilesEditor
         QString parseInlineString(const QString& expression) override;
         QString parseExpression(const QString& expression) override;
         AbstractResourceManager* getResourceManager() override { return m_resourceManager; }
+        ThumbnailDiskCache* getThumbnailDiskCache() override { return m_thumbnailDiskCache; }
         void addSearchDir(const QString& dir);
         ObjectManager* getObjectManager() override { return m_objectManager; }
         bool testCodeForErrors(const QString& code, QString* errorOutput, ScriptingLanguage language) override;
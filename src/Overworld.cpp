@@ -1,21 +1,28 @@
 #include <QFile>
+#include <QBuffer>
 #include <iterator>
+#include <algorithm>
 #include "Overworld.h"
 #include "Level.h"
-#include "EntitySpatialGrid.h"
+#include "FlatEntitySpatialGrid.h"
 #include "StringTools.h"
+#include "JsonStreamReader.h"
 #include "cJSON/JsonHelper.h"
 #include "FileFormatManager.h"
 #include "AbstractLevelFormat.h"
 
 namespace TilesEditor
 {
+	qint64 Overworld::memoryBudget = 512 * 1024 * 1024;
+	double Overworld::evictionRadius = 2048.0;
+
 	Overworld::Overworld(IWorld* world, const QString& name)
 	{
 		m_world = world;
 		m_json = nullptr;
 		m_name = name;
 		m_levelMap = nullptr;
+		m_loadScheduler = new LevelLoadScheduler(world->getResourceManager());
 
 		m_unitWidth = m_unitHeight = 16;
 
@@ -24,8 +31,14 @@ namespace TilesEditor
 
 	Overworld::~Overworld()
 	{
-		for (auto level : m_levelNames)
-			delete level;
+		//Wait for any loads still running before the levels go away
+		delete m_loadScheduler;
+
+		for (auto entry : m_levelEntries)
+		{
+			delete entry->getLevel();
+			delete entry;
+		}
 
 		if (m_entitySpatialMap)
 			delete m_entitySpatialMap;
@@ -138,11 +151,7 @@ namespace TilesEditor
 										auto levelX = x * (64.0 * 16);
 										auto levelY = y * (64.0 * 16);
 
-										auto level = new Level(m_world, levelX, levelY, 64 * 16, 64 * 16, this, levelName);
-										FileFormatManager::instance()->applyFormat(level);
-										m_levelMap->add(level);
-
-										m_levelNames[levelName] = level;
+										addLevelEntry(levelName, levelX, levelY, 64 * 16, 64 * 16);
 									}
 								}
 							}
@@ -198,12 +207,7 @@ namespace TilesEditor
 							auto levelX = x * (64.0 * 16);
 							auto levelY = y * (64.0 * 16);
 
-							auto level = new Level(m_world, levelX, levelY, 64 * 16, 64 * 16, this, levelName);
-							FileFormatManager::instance()->applyFormat(level);
-
-							m_levelMap->add(level);
-
-							m_levelNames[levelName] = level;
+							addLevelEntry(levelName, levelX, levelY, 64 * 16, 64 * 16);
 						}
 					}
 				}
@@ -218,94 +222,184 @@ namespace TilesEditor
 
 	bool Overworld::loadWorldStream(QIODevice* stream)
 	{
+		using Token = JsonStreamReader::Token;
+
 		if (m_json) {
 			cJSON_Delete(m_json);
 			m_json = nullptr;
 		}
 
-		QTextStream textStream(stream);
-		QString text = textStream.readAll();
+		//Levels are created as the file is parsed. The json is only built when saving, see readWorldJson
+		JsonStreamReader reader(stream);
+		if (reader.readNext() != Token::BeginObject)
+			return false;
 
-		if (!text.isEmpty())
-		{
-			m_json = cJSON_Parse(text.toLocal8Bit().data());
+		QString type, version;
+		int width = 1, height = 1, defaultLevelWidth = 1, defaultLevelHeight = 1;
+		bool hasType = false, hasVersion = false, hasWidth = false, hasHeight = false, hasDefaultLevelWidth = false, hasDefaultLevelHeight = false;
+		bool started = false, hasLevels = false;
+		cJSON* jsonLevels = nullptr;
+		auto firstEntry = m_levelEntries.size();
 
-			if (m_json)
+		auto start = [&]() -> bool
+		{
+			if (!started)
 			{
-				auto type = jsonGetChildString(m_json, "type");
-				auto version = jsonGetChildString(m_json, "version");
-
-
-				if (type == "overworld" && version == "1.0")
-				{
-					m_unitWidth = m_unitHeight = 1;
-					auto width = jsonGetChildInt(m_json, "width", 1) * 16;
-					auto height = jsonGetChildInt(m_json, "height", 1) * 16;
+				if (type != "overworld" || version != "1.0")
+					return false;
 
-					auto defaultLevelWidth = jsonGetChildInt(m_json, "defaultLevelWidth", 1) * 16;
-					auto defaultLevelHeight = jsonGetChildInt(m_json, "defaultLevelHeight", 1) * 16;
+				m_unitWidth = m_unitHeight = 1;
+				setSize(width * 16, height * 16);
+				started = true;
+			}
+			return true;
+		};
 
-					setSize(width, height);
+		//Each row is an array of level names, or {name, width, height} objects
+		auto readLevels = [&](JsonStreamReader& reader)
+		{
+			if (reader.token() != Token::BeginArray)
+			{
+				reader.skipValue();
+				return;
+			}
 
-					auto jsonLevels = cJSON_GetObjectItem(m_json, "levels");
-					if (jsonLevels)
+			auto nextLevelX = 0.0;
+			auto nextLevelY = 0.0;
+			while (reader.readNext() != Token::EndArray && !reader.hasError())
+			{
+				if (reader.token() == Token::BeginArray)
+				{
+					while (reader.readNext() != Token::EndArray && !reader.hasError())
 					{
-						auto nextLevelX = 0.0;
-						auto nextLevelY = 0.0;
+						QString levelName;
+						int levelWidth = 0, levelHeight = 0;
 
-						for (auto row = 0; row < cJSON_GetArraySize(jsonLevels); ++row)
+						if (reader.token() == Token::String)
 						{
-							auto jsonRow = cJSON_GetArrayItem(jsonLevels, row);
-
-							if (jsonRow)
-							{
-								for (auto column = 0; column < cJSON_GetArraySize(jsonRow); ++column)
-								{
-									auto jsonItem = cJSON_GetArrayItem(jsonRow, column);
+							levelName = reader.toString();
+							levelWidth = defaultLevelWidth * 16;
+							levelHeight = defaultLevelHeight * 16;
+						}
+						else if (reader.token() == Token::BeginObject)
+						{
+							auto jsonItem = reader.readValue();
+							if (!jsonItem)
+								return;
+
+							levelName = jsonGetChildString(jsonItem, "name");
+							levelWidth = jsonGetChildInt(jsonItem, "width") * 16;
+							levelHeight = jsonGetChildInt(jsonItem, "height") * 16;
+							cJSON_Delete(jsonItem);
+						}
+						else {
+							reader.skipValue();
+							continue;
+						}
 
-									if (jsonItem->type == cJSON_String)
-									{
-										auto levelName = QString(jsonItem->valuestring);
+						addLevelEntry(levelName, nextLevelX, nextLevelY, levelWidth, levelHeight);
+						nextLevelX += levelWidth;
+					}
+				}
+				else reader.skipValue();
 
-										auto levelWidth = defaultLevelWidth;
-										auto levelHeight = defaultLevelHeight;
+				nextLevelX = 0.0;
+				nextLevelY += defaultLevelHeight * 16;
+			}
+		};
 
+		bool failed = false;
+		while (reader.readNext() != Token::EndObject && !reader.hasError())
+		{
+			auto readInt = [&reader](int* value, bool* has) {
+				reader.readNext();
+				*value = reader.token() == Token::Number ? reader.intValue() : 1;
+				*has = true;
+				reader.skipValue();
+			};
+
+			if (reader.keyEquals("type") && !hasType)
+			{
+				reader.readNext();
+				type = reader.token() == Token::String ? reader.toString() : QString();
+				hasType = true;
+				reader.skipValue();
+			}
+			else if (reader.keyEquals("version") && !hasVersion)
+			{
+				reader.readNext();
+				version = reader.token() == Token::String ? reader.toString() : QString();
+				hasVersion = true;
+				reader.skipValue();
+			}
+			else if (reader.keyEquals("width") && !hasWidth)
+				readInt(&width, &hasWidth);
+			else if (reader.keyEquals("height") && !hasHeight)
+				readInt(&height, &hasHeight);
+			else if (reader.keyEquals("defaultLevelWidth") && !hasDefaultLevelWidth)
+				readInt(&defaultLevelWidth, &hasDefaultLevelWidth);
+			else if (reader.keyEquals("defaultLevelHeight") && !hasDefaultLevelHeight)
+				readInt(&defaultLevelHeight, &hasDefaultLevelHeight);
+			else if (reader.keyEquals("levels") && !hasLevels)
+			{
+				reader.readNext();
+				hasLevels = true;
 
-										auto level = new Level(m_world, nextLevelX, nextLevelY, levelWidth, levelHeight, this, levelName);
-										m_levelMap->add(level);
-										m_levelNames[levelName] = level;
-										nextLevelX += levelWidth;
-									}
-									else if (jsonItem->type == cJSON_Object)
-									{
-										auto levelName = jsonGetChildString(jsonItem, "name");
-										auto levelWidth = jsonGetChildInt(jsonItem, "width") * 16;
-										auto levelHeight = jsonGetChildInt(jsonItem, "height") * 16;
-										auto level = new Level(m_world, nextLevelX, nextLevelY, levelWidth, levelHeight, this, levelName);
-										m_levelMap->add(level);
-										m_levelNames[levelName] = level;
-										nextLevelX += levelWidth;
-									}
-								}
-								nextLevelX = 0.0;
-								nextLevelY += defaultLevelHeight;
-							}
-						}
+				//Levels can only be placed once the sizes are known. If they come first they're kept until the end
+				if (hasType && hasVersion && hasWidth && hasHeight && hasDefaultLevelWidth && hasDefaultLevelHeight)
+				{
+					if (!start())
+					{
+						failed = true;
+						break;
 					}
-
-					return true;
+					readLevels(reader);
 				}
-				cJSON_Delete(m_json);
-				m_json = nullptr;
+				else jsonLevels = reader.readValue();
+			}
+			else reader.skipValue();
+		}
+
+		if (!failed && !reader.hasError() && start())
+		{
+			if (jsonLevels)
+			{
+				auto text = cJSON_PrintUnformatted(jsonLevels);
+				QByteArray levelsData(text);
+				free(text);
+
+				QBuffer levelsBuffer(&levelsData);
+				levelsBuffer.open(QIODevice::ReadOnly);
+
+				JsonStreamReader levelsReader(&levelsBuffer);
+				levelsReader.readNext();
+				readLevels(levelsReader);
+				cJSON_Delete(jsonLevels);
 			}
+			return true;
+		}
 
+		if (jsonLevels)
+			cJSON_Delete(jsonLevels);
 
+		//Levels read before the error are dropped, like the whole file used to be
+		while (m_levelEntries.size() > firstEntry)
+		{
+			auto entry = m_levelEntries.takeLast();
+			m_levelMap->remove(entry);
+			if (m_levelEntryNames.value(entry->getName()) == entry)
+				m_levelEntryNames.remove(entry->getName());
+			delete entry;
 		}
 		return false;
 	}
 
 	bool Overworld::saveFile(IFileRequester* requester)
 	{
+		//Read before the file is opened for writing
+		if (m_name.endsWith(".world") && !readWorldJson())
+			return false;
+
 		auto stream = m_world->getResourceManager()->openStreamFullPath(m_fileName, QIODevice::WriteOnly);
 
 		if (stream)
@@ -367,6 +461,23 @@ namespace TilesEditor
 		return true;
 	}
 
+	bool Overworld::readWorldJson()
+	{
+		if (m_json)
+			return true;
+
+		//The json is only built when it's first saved, from the file as it is on disk
+		auto stream = m_world->getResourceManager()->openStreamFullPath(m_fileName, QIODevice::ReadOnly);
+		if (!stream)
+			return false;
+
+		auto worldData = stream->readAll();
+		delete stream;
+
+		m_json = cJSON_Parse(worldData.constData() + (worldData.startsWith("\xEF\xBB\xBF") ? 3 : 0));
+		return m_json != nullptr;
+	}
+
 	bool Overworld::saveWorldStream(QIODevice* _stream)
 	{
 		if (m_json)
@@ -390,11 +501,28 @@ namespace TilesEditor
 	{
 		m_width = width;
 		m_height = height;
-		m_levelMap = new EntitySpatialGrid<Level>(0.0, 0.0, width, height, 64 * 16, 64 * 16);
-		m_entitySpatialMap = new EntitySpatialGrid<AbstractLevelEntity>(0.0, 0.0, width, height);
+		m_levelMap = new FlatEntitySpatialGrid<LevelEntry>(0.0, 0.0, width, height, 64 * 16, 64 * 16);
+		m_entitySpatialMap = new FlatEntitySpatialGrid<AbstractLevelEntity>(0.0, 0.0, width, height);
+	}
+
+	void Overworld::addLevelEntry(const QString& name, double x, double y, int width, int height)
+	{
+		auto entry = new LevelEntry(name, x, y, width, height);
+		m_levelMap->add(entry);
+		m_levelEntries.push_back(entry);
+		m_levelEntryNames[name] = entry;
 	}
 
 	void Overworld::searchLevels(const QRectF& rect, QSet<Level*>& output)
+	{
+		QList<LevelEntry*> entries;
+		m_levelMap->search(rect, false, entries);
+
+		for (auto entry : entries)
+			output.insert(getLevel(entry));
+	}
+
+	void Overworld::searchLevelEntries(const QRectF& rect, QSet<LevelEntry*>& output)
 	{
 		m_levelMap->search(rect, false, output);
 	}
@@ -429,40 +557,144 @@ namespace TilesEditor
 
 	void Overworld::preloadLevels()
 	{
-		for (auto level : m_levelNames)
+		for (auto entry : m_levelEntries)
 		{
+			auto level = getLevel(entry);
 			if (level->getLoadState() == LoadState::STATE_NOT_LOADED)
 			{
 				QString fullPath;
 				if (m_world->getResourceManager()->locateFile(level->getName(), &fullPath))
 				{
+					//Preloaded levels stay queued even when they are far from the view
 					level->setFileName(fullPath);
-					level->loadFile(true);
+					level->setLoadState(LoadState::STATE_LOADING);
+					m_loadScheduler->requestLoad(level, false);
 				}
 			}
 		}
+
+		//The whole world was asked for, so keep it
+		m_preloaded = true;
+	}
+
+	void Overworld::touchLevels(const QSet<Level*>& levels)
+	{
+		++m_useCounter;
+		for (auto level : levels)
+		{
+			if (level->getLoadState() != LoadState::STATE_LOADED)
+				continue;
+
+			auto it = m_levelLastUsed.find(level);
+			if (it == m_levelLastUsed.end())
+			{
+				m_levelLastUsed.insert(level, m_useCounter);
+				m_evictionPending = true;
+			}
+			else it.value() = m_useCounter;
+		}
+	}
+
+	QList<Level*> Overworld::getLevelsToEvict(const QRectF& viewRect, const std::function<bool(Level*)>& isPinned)
+	{
+		QList<Level*> retval;
+		if (memoryBudget <= 0 || m_preloaded || !m_evictionPending)
+			return retval;
+
+		//Only levels that have been drawn are tracked, which covers all levels loaded by scrolling around
+		qint64 usage = 0;
+		QList<QPair<Level*, qint64>> candidates;
+		auto keepRect = viewRect.adjusted(-evictionRadius, -evictionRadius, evictionRadius, evictionRadius);
+		for (auto it = m_levelLastUsed.begin(); it != m_levelLastUsed.end();)
+		{
+			auto level = it.key();
+			if (level->getLoadState() != LoadState::STATE_LOADED)
+			{
+				it = m_levelLastUsed.erase(it);
+				continue;
+			}
+
+			auto levelUsage = level->getMemoryUsage();
+			usage += levelUsage;
+
+			if (level->canUnload() && !keepRect.intersects(level->getRect()) && !isPinned(level))
+				candidates.push_back(QPair<Level*, qint64>(level, levelUsage));
+			++it;
+		}
+
+		if (usage <= memoryBudget)
+		{
+			m_evictionPending = false;
+			return retval;
+		}
+
+		std::sort(candidates.begin(), candidates.end(), [this](const QPair<Level*, qint64>& a, const QPair<Level*, qint64>& b) {
+			return m_levelLastUsed.value(a.first) < m_levelLastUsed.value(b.first);
+		});
+
+		for (auto& candidate : candidates)
+		{
+			if (usage <= memoryBudget)
+				break;
+
+			usage -= candidate.second;
+			m_levelLastUsed.remove(candidate.first);
+			retval.push_back(candidate.first);
+		}
+
+		//Still over when the only levels left are near the view, so check again as it moves away from them
+		m_evictionPending = usage > memoryBudget;
+		return retval;
 	}
 
 
+	void Overworld::releaseLevel(Level* level)
+	{
+		auto it = m_levelEntryNames.find(level->getName());
+		if (it == m_levelEntryNames.end() || it.value()->getLevel() != level)
+			return;
+
+		m_loadScheduler->cancel(level);
+		m_levelLastUsed.remove(level);
+		m_levelNames.remove(level->getName());
+		it.value()->setLevel(nullptr);
+		delete level;
+	}
+
 	bool Overworld::containsLevel(const QString& name) const
 	{
-		return m_levelNames.find(name) != m_levelNames.end();
+		return m_levelEntryNames.find(name) != m_levelEntryNames.end();
 	}
 
 
 	Level* Overworld::getLevel(const QString& levelName)
 	{
-		auto it = m_levelNames.find(levelName);
-		if (it != m_levelNames.end())
-			return it.value();
+		auto it = m_levelEntryNames.find(levelName);
+		if (it != m_levelEntryNames.end())
+			return getLevel(it.value());
 		return nullptr;
 	}
 
+	Level* Overworld::getLevel(LevelEntry* entry)
+	{
+		if (!entry->getLevel())
+		{
+			auto level = new Level(m_world, entry->getX(), entry->getY(), entry->getWidth(), entry->getHeight(), this, entry->getName());
+			FileFormatManager::instance()->applyFormat(level);
+			if (!entry->getFileName().isEmpty())
+				level->setFileName(entry->getFileName());
+
+			entry->setLevel(level);
+			m_levelNames[entry->getName()] = level;
+		}
+		return entry->getLevel();
+	}
+
 	Level* Overworld::getLevelAt(const QPointF& point)
 	{
-		auto level = m_levelMap->entityAt(point);
-		if (level != nullptr)
-			return level;
+		auto entry = m_levelMap->entityAt(point);
+		if (entry != nullptr)
+			return getLevel(entry);
 
 		return nullptr;
 
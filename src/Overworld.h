@@ -2,16 +2,21 @@
 #define OVERWORLDH
 
 #include <QString>
+#include <QByteArray>
 #include <QMap>
 #include <QList>
 #include <QSet>
 #include <QIODevice>
 #include <QRect>
+#include <QHash>
+#include <functional>
 #include "IEntitySpatialMap.h"
 #include "Level.h"
+#include "LevelEntry.h"
 #include "AbstractLevelEntity.h"
 #include "IWorld.h"
 #include "IFileRequester.h"
+#include "LevelLoadScheduler.h"
 
 namespace TilesEditor
 {
@@ -26,6 +31,7 @@ namespace TilesEditor
 		QString m_tilesetImageName;
 		QStringList m_gmapFileLines;
 		 
+		//The .world file. It is parsed straight from the stream when loading, and only read again (into m_json) when it is first saved
 		cJSON* m_json;
 
 		int m_width;
@@ -34,11 +40,32 @@ namespace TilesEditor
 		int m_unitWidth;
 		int m_unitHeight;
 
-		IEntitySpatialMap<Level>* m_levelMap;
+		//Every level in the overworld. Levels are only created from their entries when first needed
+		IEntitySpatialMap<LevelEntry>* m_levelMap;
 		IEntitySpatialMap<AbstractLevelEntity>* m_entitySpatialMap;
+		QList<LevelEntry*> m_levelEntries;
+		QMap<QString, LevelEntry*> m_levelEntryNames;
+
+		//Levels that have been created so far
 		QMap<QString, Level*> m_levelNames;
 
+		LevelLoadScheduler* m_loadScheduler;
+
+		//When each loaded level was last visible, for least recently used eviction
+		QHash<Level*, quint64> m_levelLastUsed;
+		quint64 m_useCounter = 0;
+		bool m_preloaded = false;
+
+		//Set when a newly loaded level is drawn, so the memory used is only added up again when it could have gone over the budget
+		bool m_evictionPending = false;
+
 	public:
+		//Loaded levels are unloaded (least recently used first) when they use more than this many bytes. 0 to never unload
+		static qint64 memoryBudget;
+
+		//Levels within this distance (in pixels) of the view are never unloaded
+		static double evictionRadius;
+
 		Overworld(IWorld* world, const QString& name);
 		~Overworld();
 
@@ -65,9 +92,14 @@ namespace TilesEditor
 		bool saveGMapStream(QIODevice* stream);
 		bool saveTXTStream(QIODevice* stream);
 		bool saveWorldStream(QIODevice* stream);
+		bool readWorldJson();
 
 		void setSize(int width, int height);
+		void addLevelEntry(const QString& name, double x, double y, int width, int height);
+
+		//Creates any levels in rect that haven't been yet
 		void searchLevels(const QRectF& rect, QSet<Level*>& output);
+		void searchLevelEntries(const QRectF& rect, QSet<LevelEntry*>& output);
 
 		void updateObjectMoved(AbstractLevelEntity* entity);
 
@@ -76,6 +108,17 @@ namespace TilesEditor
 		int getTileAt(int tileDepth, const QPointF& point);
 		void preloadLevels();
 
+		void touchLevels(const QSet<Level*>& levels);
+
+		//Levels that should be unloaded to get back under the memory budget, least recently used first.
+		//Modified levels, levels near viewRect and pinned levels are kept. Only checked after a new level has been drawn,
+		//or every time while it can't get back under the budget
+		QList<Level*> getLevelsToEvict(const QRectF& viewRect, const std::function<bool(Level*)>& isPinned);
+
+		//Delete an unloaded level that nothing else points at, so its entry creates a new one if it's needed again
+		void releaseLevel(Level* level);
+		LevelLoadScheduler* getLoadScheduler() { return m_loadScheduler; }
+
 		bool containsLevel(const QString& name) const;
 		int getWidth() const { return m_width; }
 		int getHeight() const { return m_height; }
@@ -87,10 +130,14 @@ namespace TilesEditor
 		int getTileHeight() const { return 16; }
 		IEntitySpatialMap<AbstractLevelEntity>* getEntitySpatialMap() { return m_entitySpatialMap; }
 		Level* getLevel(const QString& levelName);
+		Level* getLevel(LevelEntry* entry);
 		Level* getLevelAt(const QPointF& point);
 
 		QList<Level*> getModifiedLevels();
+
+		//Only the levels created so far. Levels that haven't been created have nothing loaded or modified
 		QMap<QString, Level*>& getLevelList() { return m_levelNames; }
+		const QList<LevelEntry*>& getLevelEntries() const { return m_levelEntries; }
 	};
 };
 
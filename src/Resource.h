@@ -46,6 +46,9 @@ namespace TilesEditor
 		virtual void replace(QIODevice* stream, AbstractResourceManager* resourceManager) {}
 		
 		virtual void release(AbstractResourceManager* resourceManager) {};
+
+		//Bytes of decoded data held. Used to budget the freed resources a resource manager keeps around
+		virtual qint64 getMemoryUsage() const { return 0; }
 		virtual ResourceType getResourceType() const = 0;
 	};
 }
@@ -1,6 +1,6 @@
-#include <QDirIterator>
 #include <QFile>
 #include "ResourceManagerFileSystem.h"
+#include "FileNameIndex.h"
 
 namespace TilesEditor
 {
@@ -15,25 +15,93 @@ namespace TilesEditor
 
 		if (level <= maxLevel)
 		{
-			QDirIterator it(searchPath, QStringList(), QDir::Filter::Files | QDir::Filter::NoDotAndDotDot | QDir::Filter::Dirs);
-			while (it.hasNext())
+			//Listed by FileNameIndex::update
+			auto directory = FileNameIndex::instance()->getDirectory(searchPath);
+			if (directory)
 			{
-				auto fInfo = it.nextFileInfo();
-
-				if (fInfo.isDir())
+				for (auto& entry : directory->entries)
 				{
-					auto newPath = fInfo.absoluteFilePath();
-					if (!newPath.endsWith('/'))
-						newPath += '/';
-					searchDirectory(newPath, level + 1, maxLevel);
+					if (entry.endsWith('/'))
+						searchDirectory(searchPath + entry, level + 1, maxLevel);
+					else m_fileNameCache[entry.toLower()] = searchPath + entry;
 				}
-				else if (fInfo.isFile())
+			}
+		}
+	}
+
+	//How deep directory is below the recursive search folder that searches furthest past it
+	bool ResourceManagerFileSystem::getSearchLevel(const QString& directory, int* level, int* maxLevel) const
+	{
+		auto found = false;
+		for (auto it = m_recursiveDirectories.cbegin(); it != m_recursiveDirectories.cend(); ++it)
+		{
+			if (!directory.startsWith(it.key()))
+				continue;
+
+			auto depth = int(directory.mid(it.key().size()).count('/'));
+			if (depth <= it.value() && (!found || it.value() - depth > *maxLevel - *level))
+			{
+				*level = depth;
+				*maxLevel = it.value();
+				found = true;
+			}
+		}
+		return found;
+	}
+
+	void ResourceManagerFileSystem::filesChanged(const QString& directory, const QStringList& added, const QStringList& removed)
+	{
+		int level = 0, maxLevel = 0;
+		auto recursive = getSearchLevel(directory, &level, &maxLevel);
+		if (!recursive && !m_searchDirectories.contains(directory))
+			return;
+
+		for (auto& entry : removed)
+		{
+			if (entry.endsWith('/'))
+			{
+				//Forget the folder, its sub folders and everything found in them
+				auto path = directory + entry;
+				m_fileNameCache.removeIf([&path](const QHash<QString, QString>::iterator& it) { return it.value().startsWith(path); });
+				m_searchDirectories.removeIf([&path](const QString& dir) { return dir.startsWith(path); });
+				m_searchDirectoriesList.removeIf([&path](const QString& dir) { return dir.startsWith(path); });
+				continue;
+			}
+
+			auto it = m_fileNameCache.find(entry.toLower());
+			if (it != m_fileNameCache.end() && it.value() == directory + entry)
+				m_fileNameCache.erase(it);
+		}
+
+		for (auto& entry : added)
+		{
+			if (entry.endsWith('/'))
+			{
+				//Sub folders of plain search folders aren't searched
+				if (recursive)
 				{
-					m_fileNameCache[fInfo.fileName().toLower()] = fInfo.absoluteFilePath();
+					//Searched once it has been listed, see directoryUpdated
+					auto path = directory + entry;
+					if (level < maxLevel)
+						FileNameIndex::instance()->update(path, maxLevel - level - 1);
+					else searchDirectory(path, level + 1, maxLevel);
 				}
 			}
-			
+			else m_fileNameCache[entry.toLower()] = directory + entry;
 		}
+
+		m_missingFiles.clear();
+	}
+
+	void ResourceManagerFileSystem::directoryUpdated(const QString& directory)
+	{
+		int level = 0, maxLevel = 0;
+		if (getSearchLevel(directory, &level, &maxLevel))
+			searchDirectory(directory, level, maxLevel);
+		else if (!m_searchDirectories.contains(directory))
+			return;
+
+		m_missingFiles.clear();
 	}
 
 	QIODevice* ResourceManagerFileSystem::openStreamFullPath(const QString& fullPath, QIODeviceBase::OpenModeFlag mode)
@@ -53,7 +121,21 @@ namespace TilesEditor
 	{
 		setRootDir(rootDir);
 		addSearchDir(m_rootDir);
-			
+
+		m_filesChangedConnection = QObject::connect(FileNameIndex::instance(), &FileNameIndex::filesChanged, [this](const QString& directory, const QStringList& added, const QStringList& removed) {
+			filesChanged(directory, added, removed);
+		});
+
+		m_updatedConnection = QObject::connect(FileNameIndex::instance(), &FileNameIndex::updated, [this](const QString& directory) {
+			directoryUpdated(directory);
+		});
+		m_clock.start();
+	}
+
+	ResourceManagerFileSystem::~ResourceManagerFileSystem()
+	{
+		QObject::disconnect(m_filesChangedConnection);
+		QObject::disconnect(m_updatedConnection);
 	}
 
 	void ResourceManagerFileSystem::setRootDir(const QString& dir)
@@ -78,6 +160,10 @@ namespace TilesEditor
 
 		if (count != m_searchDirectories.count())
 			m_searchDirectoriesList.push_back(searchPath);
+
+		//Files in it are still found by checking the folder, but it's watched so new files clear m_missingFiles
+		FileNameIndex::instance()->update(searchPath, 0);
+		m_missingFiles.clear();
 	}
 
 	void ResourceManagerFileSystem::addSearchDirRecursive(const QString& dir, int max)
@@ -87,7 +173,15 @@ namespace TilesEditor
 		if (!searchPath.endsWith('/'))
 			searchPath += '/';
 
-		searchDirectory(searchPath, 0, max);
+		auto it = m_recursiveDirectories.find(searchPath);
+		if (it == m_recursiveDirectories.end())
+			m_recursiveDirectories.insert(searchPath, max);
+		else it.value() = qMax(it.value(), max);
+
+		//Lists the folders in the background, or only checks their modified times if they're in the saved index.
+		//They are searched once that's done, see directoryUpdated
+		FileNameIndex::instance()->update(searchPath, max);
+		m_missingFiles.clear();
 	}
 
 	bool ResourceManagerFileSystem::isCompatible(const QString& connectionString)
@@ -104,6 +198,9 @@ namespace TilesEditor
 			for (auto pair : otherFileSystem->m_fileNameCache.asKeyValueRange())
 				this->m_fileNameCache[pair.first] = pair.second;
 
+			for (auto pair : otherFileSystem->m_recursiveDirectories.asKeyValueRange())
+				this->m_recursiveDirectories[pair.first] = qMax(this->m_recursiveDirectories.value(pair.first, 0), pair.second);
+
 			for (auto& dir : otherFileSystem->m_searchDirectoriesList)
 			{
 				auto count = this->m_searchDirectories.count();
@@ -111,6 +208,7 @@ namespace TilesEditor
 				if (count != this->m_searchDirectories.count())
 					m_searchDirectoriesList.push_back(dir);
 			}
+			m_missingFiles.clear();
 		}
 	}
 
@@ -119,6 +217,14 @@ namespace TilesEditor
 		auto fileNameLower = name.toLower();
 
 		auto it = m_fileNameCache.find(fileNameLower);
+
+		//Folders still being listed might have it
+		if (it == m_fileNameCache.end() && FileNameIndex::instance()->isUpdating())
+		{
+			FileNameIndex::instance()->waitForUpdates();
+			it = m_fileNameCache.find(fileNameLower);
+		}
+
 		if (it != m_fileNameCache.end())
 		{
 			if (outPath)
@@ -126,6 +232,14 @@ namespace TilesEditor
 			return true;
 		}
 
+		auto missingIt = m_missingFiles.constFind(fileNameLower);
+		if (missingIt != m_missingFiles.cend() && (missingIt.value() < 0 || missingIt.value() > m_clock.elapsed()))
+		{
+			if (outPath)
+				*outPath = "";
+			return false;
+		}
+
 		for (auto& dir : m_searchDirectoriesList)
 		{
 			QString fullPath = dir + fileNameLower;
@@ -140,7 +254,20 @@ namespace TilesEditor
 			}
 		}
 
-		*outPath = "";
+		//Only folders being watched will clear the miss when the file turns up
+		auto watched = true;
+		for (auto& dir : m_searchDirectoriesList)
+		{
+			if (!FileNameIndex::instance()->isWatched(dir))
+			{
+				watched = false;
+				break;
+			}
+		}
+		m_missingFiles[fileNameLower] = watched ? -1 : m_clock.elapsed() + MISSING_FILE_TIMEOUT;
+
+		if (outPath)
+			*outPath = "";
 		return false;
 	}
 
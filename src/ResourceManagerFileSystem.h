@@ -5,7 +5,9 @@
 #include <QSet>
 #include <QStringList>
 #include <QMap>
+#include <QHash>
 #include <QFileInfo>
+#include <QElapsedTimer>
 #include <QFileDialog>
 #include "AbstractResourceManager.h"
 
@@ -20,9 +22,23 @@ namespace TilesEditor
 		QSet<QString>	m_searchDirectories;
 		QStringList		m_searchDirectoriesList;
 
-		QMap<QString, QString>	m_fileNameCache;
+		//Folders added with addSearchDirRecursive, and how many levels of sub folders are searched below them
+		QHash<QString, int>	m_recursiveDirectories;
+
+		QHash<QString, QString>	m_fileNameCache;
+
+		//Names that weren't found anywhere, and when to look for them again (-1 for never). Cleared whenever the search
+		//folders or their files change. Misses only last MISSING_FILE_TIMEOUT when some search folders aren't watched
+		static const int MISSING_FILE_TIMEOUT = 2000;
+		QHash<QString, qint64>	m_missingFiles;
+		QElapsedTimer	m_clock;
+		QMetaObject::Connection m_filesChangedConnection;
+		QMetaObject::Connection m_updatedConnection;
 
 		void searchDirectory(const QString& searchPath, int level, int maxLevel);
+		bool getSearchLevel(const QString& directory, int* level, int* maxLevel) const;
+		void filesChanged(const QString& directory, const QStringList& added, const QStringList& removed);
+		void directoryUpdated(const QString& directory);
 
 	protected:
 		void requestFile(const QString& fileName) override {
@@ -31,6 +47,7 @@ namespace TilesEditor
 
 	public:
 		ResourceManagerFileSystem(const QString& rootDir, ObjectManager* objectManager);
+		~ResourceManagerFileSystem();
 
 		void setRootDir(const QString& dir);
 		void addSearchDir(const QString& dir);
@@ -119,7 +119,7 @@ namespace TilesEditor
 
 				for (auto tilemap : layers)
 				{
-					tilemap->draw(painter, viewRect, m_world->getTilesetImage(), tilemap->getX(), tilemap->getY());
+					level->compositeTilemap(tilemap, m_world->getTilesetImage(), tilemap->getX(), tilemap->getY(), painter, viewRect);
 				}
 
 				if (ui.showObjectCheckBox->isChecked())
@@ -170,7 +170,7 @@ namespace TilesEditor
 
 			for (auto tilemap : layers)
 			{
-				tilemap->draw(painter, viewRect, m_world->getTilesetImage(), tilemap->getX(), tilemap->getY());
+				level->compositeTilemap(tilemap, m_world->getTilesetImage(), tilemap->getX(), tilemap->getY(), painter, viewRect);
 			}
 		}
 
@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <QFileInfo>
+#include <QDir>
+#include <QCryptographicHash>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QSaveFile>
+#include <QList>
+#include <QPair>
+#include "ThumbnailDiskCache.h"
+
+namespace TilesEditor
+{
+	ThumbnailDiskCache::ThumbnailDiskCache(const QString& directory, QObject* parent):
+		QObject(parent), m_directory(directory)
+	{
+		QDir().mkpath(m_directory);
+
+		//Mostly waiting on the disk
+		m_threadPool.setMaxThreadCount(2);
+		m_clock.start();
+	}
+
+	ThumbnailDiskCache::~ThumbnailDiskCache()
+	{
+		m_threadPool.clear();
+		m_threadPool.waitForDone();
+	}
+
+	ThumbnailDiskCache::Source ThumbnailDiskCache::getSource(const QString& filePath, const QString& tilesetName)
+	{
+		Source retval;
+		retval.filePath = filePath;
+		retval.tilesetName = tilesetName;
+
+		QFileInfo fi(filePath);
+		if (fi.exists())
+		{
+			retval.size = fi.size();
+			retval.modified = fi.lastModified().toMSecsSinceEpoch();
+		}
+		return retval;
+	}
+
+	QString ThumbnailDiskCache::getCacheFileName(const QString& filePath) const
+	{
+		auto hash = QCryptographicHash::hash(QDir::cleanPath(filePath).toUtf8(), QCryptographicHash::Sha1).toHex();
+		return QDir(m_directory).filePath(QString::fromLatin1(hash) + ".png");
+	}
+
+	ThumbnailDiskCache::Status ThumbnailDiskCache::find(const QString& filePath, const QString& tilesetName, QImage* image)
+	{
+		auto it = m_entries.find(filePath);
+		if (it == m_entries.end())
+		{
+			m_entries.insert(filePath, Entry());
+
+			auto fileName = getCacheFileName(filePath);
+			m_threadPool.start([this, fileName, filePath]()
+			{
+				auto current = getSource(filePath, QString());
+
+				//The source is stored as png text
+				QImageReader reader(fileName);
+				Source stored;
+				stored.filePath = filePath;
+				stored.size = reader.text("size").toLongLong();
+				stored.modified = reader.text("modified").toLongLong();
+				stored.tilesetName = reader.text("tileset");
+
+				auto thumbnail = reader.read();
+				auto success = !thumbnail.isNull();
+				if (success)
+					thumbnail = thumbnail.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+				QMetaObject::invokeMethod(this, [this, filePath, thumbnail, stored, current, success]() {
+					loadFinished(filePath, thumbnail, stored, current, success);
+				}, Qt::QueuedConnection);
+			});
+			return Status::Loading;
+		}
+
+		auto& entry = it.value();
+		if (entry.status == Status::Loading || entry.status == Status::Missing)
+			return entry.status;
+
+		entry.lastUsed = ++m_useCounter;
+		if (!entry.checking && m_clock.elapsed() - entry.checked >= CHECK_INTERVAL)
+			check(filePath, entry);
+
+		*image = entry.image;
+
+		auto current = entry.current;
+		current.tilesetName = tilesetName;
+		return entry.source == current ? Status::Fresh : Status::Stale;
+	}
+
+	bool ThumbnailDiskCache::contains(const Source& source) const
+	{
+		auto it = m_entries.find(source.filePath);
+		return it != m_entries.end() && it->status == Status::Fresh && it->source == source;
+	}
+
+	void ThumbnailDiskCache::setImage(Entry& entry, const QImage& image)
+	{
+		m_bytes -= entry.bytes;
+		entry.image = image;
+		entry.bytes = image.sizeInBytes();
+		m_bytes += entry.bytes;
+	}
+
+	void ThumbnailDiskCache::check(const QString& filePath, Entry& entry)
+	{
+		entry.checking = true;
+		m_threadPool.start([this, filePath]()
+		{
+			auto current = getSource(filePath, QString());
+			QMetaObject::invokeMethod(this, [this, filePath, current]() {
+				checkFinished(filePath, current);
+			}, Qt::QueuedConnection);
+		});
+	}
+
+	void ThumbnailDiskCache::checkFinished(const QString& filePath, Source current)
+	{
+		auto it = m_entries.find(filePath);
+		if (it == m_entries.end() || !it->checking)
+			return;
+
+		it->checking = false;
+		it->checked = m_clock.elapsed();
+
+		current.tilesetName = it->current.tilesetName;
+		if (!(it->current == current))
+		{
+			it->current = current;
+			emit ready();
+		}
+	}
+
+	void ThumbnailDiskCache::loadFinished(const QString& filePath, QImage image, Source source, Source current, bool success)
+	{
+		auto it = m_entries.find(filePath);
+
+		//A new thumbnail was inserted while this one was being read
+		if (it == m_entries.end() || it->status != Status::Loading)
+			return;
+
+		it->current = current;
+		it->checked = m_clock.elapsed();
+		if (success)
+		{
+			it->status = Status::Fresh;
+			it->source = source;
+			it->lastUsed = ++m_useCounter;
+			setImage(*it, image);
+		}
+		else it->status = Status::Missing;
+
+		emit ready();
+	}
+
+	void ThumbnailDiskCache::insert(const Source& source, const QImage& image)
+	{
+		auto& entry = m_entries[source.filePath];
+		entry.status = Status::Fresh;
+		entry.source = source;
+		entry.current = source;
+		entry.lastUsed = ++m_useCounter;
+		entry.checked = m_clock.elapsed();
+		entry.checking = false;
+		setImage(entry, image);
+
+		auto fileName = getCacheFileName(source.filePath);
+		m_threadPool.start([fileName, source, image]()
+		{
+			QSaveFile file(fileName);
+			if (!file.open(QIODevice::WriteOnly))
+				return;
+
+			QImageWriter writer(&file, "png");
+			writer.setText("file", source.filePath);
+			writer.setText("size", QString::number(source.size));
+			writer.setText("modified", QString::number(source.modified));
+			writer.setText("tileset", source.tilesetName);
+
+			if (writer.write(image))
+				file.commit();
+		});
+	}
+
+	void ThumbnailDiskCache::trim(qint64 budget)
+	{
+		if (budget <= 0 || m_bytes <= budget)
+			return;
+
+		//Trim to three quarters so this isn't redone for every thumbnail read after it
+		auto target = budget - budget / 4;
+
+		QList<QPair<quint64, QString>> candidates;
+		for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it)
+		{
+			if (it->bytes > 0)
+				candidates.push_back(QPair<quint64, QString>(it->lastUsed, it.key()));
+		}
+
+		std::sort(candidates.begin(), candidates.end());
+		for (auto& candidate : candidates)
+		{
+			if (m_bytes <= target)
+				break;
+
+			auto it = m_entries.find(candidate.second);
+			m_bytes -= it->bytes;
+			m_entries.erase(it);
+		}
+	}
+};
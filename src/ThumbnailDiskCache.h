@@ -0,0 +1,105 @@
+#ifndef THUMBNAILDISKCACHEH
+#define THUMBNAILDISKCACHEH
+
+#include <QObject>
+#include <QThreadPool>
+#include <QHash>
+#include <QString>
+#include <QImage>
+#include <QElapsedTimer>
+
+namespace TilesEditor
+{
+	//Level thumbnails saved to disk (one png per level file), so an overworld can be shown zoomed out
+	//before any of its levels have been loaded. Each thumbnail records the size and modified time of the
+	//level file and the tileset image it was made with. Ones that don't match any more are still returned
+	//(marked stale) so they can be shown until the level is loaded and a new thumbnail made.
+	//Thumbnails in memory are dropped least recently used first, see trim
+	class ThumbnailDiskCache :
+		public QObject
+	{
+		Q_OBJECT
+
+	public:
+		//What a thumbnail was made from
+		struct Source {
+			QString filePath;
+			qint64 size = -1;
+			qint64 modified = 0;
+			QString tilesetName;
+
+			bool operator==(const Source& other) const {
+				return filePath == other.filePath && size == other.size && modified == other.modified && tilesetName == other.tilesetName;
+			}
+		};
+
+		enum class Status {
+			Missing,
+			Loading,
+			Stale,
+			Fresh
+		};
+
+	private:
+		//Status is Fresh for every entry with an image, find works out if it is stale
+		struct Entry {
+			Status status = Status::Loading;
+
+			//What the saved thumbnail was made from, and the level file as it is now
+			Source source;
+			Source current;
+			QImage image;
+			qint64 bytes = 0;
+			quint64 lastUsed = 0;
+
+			//When current was last read from the level file
+			qint64 checked = 0;
+			bool checking = false;
+		};
+
+		//How often (ms) the level files of thumbnails being drawn are checked for changes
+		static const int CHECK_INTERVAL = 5000;
+
+		QString m_directory;
+		QThreadPool m_threadPool;
+		QHash<QString, Entry> m_entries;
+		qint64 m_bytes = 0;
+		quint64 m_useCounter = 0;
+		QElapsedTimer m_clock;
+
+		QString getCacheFileName(const QString& filePath) const;
+		void setImage(Entry& entry, const QImage& image);
+		void check(const QString& filePath, Entry& entry);
+		void loadFinished(const QString& filePath, QImage image, Source source, Source current, bool success);
+		void checkFinished(const QString& filePath, Source current);
+
+	signals:
+		void ready();
+
+	public:
+		ThumbnailDiskCache(const QString& directory, QObject* parent = nullptr);
+		~ThumbnailDiskCache();
+
+		//Size and modified time of filePath
+		static Source getSource(const QString& filePath, const QString& tilesetName);
+
+		//The thumbnail of a level file made with this tileset. Thumbnails not in memory yet are read in the background
+		//(Status::Loading) and ready is emitted when done. The level file is checked for changes in the background
+		//every CHECK_INTERVAL, and ready is emitted if it changed
+		Status find(const QString& filePath, const QString& tilesetName, QImage* image);
+
+		//True if the thumbnail for source is already saved
+		bool contains(const Source& source) const;
+
+		//Remember image as the thumbnail for source and write it to disk in the background
+		void insert(const Source& source, const QImage& image);
+
+		//Drop the least recently found thumbnails until they use well under budget bytes. Dropped ones are read
+		//from disk again the next time they are found
+		void trim(qint64 budget);
+
+		qint64 getMemoryUsage() const { return m_bytes; }
+	};
+};
+
+#endif
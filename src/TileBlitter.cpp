@@ -0,0 +1,85 @@
+#include <cstring>
+#include "TileBlitter.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TILEBLITTER_SSE2
+#endif
+
+namespace TilesEditor
+{
+	TileBlitter::TileBlitter(QImage* dest):
+		m_dest(dest)
+	{
+	}
+
+	uint TileBlitter::getTranslucencyAlpha(int translucency)
+	{
+		//Matches the painter opacity of 1 - (translucency / 15), and 0.05 for fully invisible tiles
+		static const uint alphas[16] = {
+			256, 239, 222, 205, 188, 171, 154, 137,
+			119, 102, 85, 68, 51, 34, 17, 13
+		};
+		return alphas[translucency & 0xF];
+	}
+
+	void TileBlitter::scaleRow(quint32* dest, const quint32* src, int count, uint alpha)
+	{
+		int i = 0;
+
+#ifdef TILEBLITTER_SSE2
+		//4 pixels at a time, each channel widened to 16 bits
+		auto zero = _mm_setzero_si128();
+		auto alpha16 = _mm_set1_epi16(short(alpha));
+		for (; i + 4 <= count; i += 4)
+		{
+			auto pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			auto lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(pixels, zero), alpha16), 8);
+			auto hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(pixels, zero), alpha16), 8);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_packus_epi16(lo, hi));
+		}
+#endif
+
+		//Two channels per multiply
+		for (; i < count; ++i)
+		{
+			auto pixel = src[i];
+			auto rb = (((pixel & 0x00FF00FF) * alpha) >> 8) & 0x00FF00FF;
+			auto ag = (((pixel >> 8) & 0x00FF00FF) * alpha) & 0xFF00FF00;
+			dest[i] = rb | ag;
+		}
+	}
+
+	void TileBlitter::drawTile(int destX, int destY, const QImage& source, int srcX, int srcY, int translucency)
+	{
+		//Clip to both images, the same as drawPixmap would
+		QRect srcRect(srcX, srcY, 16, 16);
+		srcRect = srcRect.intersected(source.rect());
+		srcRect = srcRect.intersected(m_dest->rect().translated(srcX - destX, srcY - destY));
+
+		auto x = destX + (srcRect.x() - srcX);
+		auto y = destY + (srcRect.y() - srcY);
+		auto width = srcRect.width();
+
+		auto alpha = getTranslucencyAlpha(translucency);
+		for (auto row = 0; row < srcRect.height(); ++row)
+		{
+			auto src = reinterpret_cast<const quint32*>(source.constScanLine(srcRect.y() + row)) + srcRect.x();
+			auto dest = reinterpret_cast<quint32*>(m_dest->scanLine(y + row)) + x;
+
+			if (alpha == 256)
+				std::memcpy(dest, src, width * sizeof(quint32));
+			else scaleRow(dest, src, width, alpha);
+		}
+
+		//Fully invisible tiles get a red line through them so they can still be found
+		if (translucency == 15)
+		{
+			for (auto i = 0; i < 16; ++i)
+			{
+				if (m_dest->rect().contains(destX + i, destY + i))
+					reinterpret_cast<quint32*>(m_dest->scanLine(destY + i))[destX + i] = 0xFFFF0000;
+			}
+		}
+	}
+};
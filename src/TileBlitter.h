@@ -0,0 +1,31 @@
+#ifndef TILEBLITTERH
+#define TILEBLITTERH
+
+#include <QImage>
+#include <QRect>
+
+namespace TilesEditor
+{
+	//Writes 16x16 tiles straight into the scanlines of an ARGB32 premultiplied image, without going through QPainter.
+	//Each tile has to land on a transparent part of the image (eg: a freshly cleared render chunk), so opaque tiles
+	//are a plain copy and translucent tiles just scale the source pixels by one of the 16 translucency levels
+	class TileBlitter
+	{
+	private:
+		QImage* m_dest;
+
+	public:
+		TileBlitter(QImage* dest);
+
+		//source must be ARGB32 premultiplied (see Image::premultipliedImage)
+		void drawTile(int destX, int destY, const QImage& source, int srcX, int srcY, int translucency);
+
+		//dest[i] = src[i] * alpha / 256. alpha is 0-256
+		static void scaleRow(quint32* dest, const quint32* src, int count, uint alpha);
+
+		//Opacity (0-256) used for each tile translucency. Fully invisible tiles are still drawn faintly
+		static uint getTranslucencyAlpha(int translucency);
+	};
+};
+
+#endif
@@ -0,0 +1,165 @@
+#include <cmath>
+#include "TileFloodFill.h"
+
+namespace TilesEditor
+{
+	TileFloodFill::TileFloodFill(TilemapLookup lookup):
+		m_lookup(lookup)
+	{
+	}
+
+	TileFloodFill::~TileFloodFill()
+	{
+		qDeleteAll(m_states);
+	}
+
+	Tilemap* TileFloodFill::tilemapAt(int tileX, int tileY, TilemapState** state)
+	{
+		//Most lookups land in the same level as the previous one
+		if (m_lastTilemap != nullptr &&
+			tileX >= m_lastState->originX && tileX < m_lastState->originX + m_lastState->hcount &&
+			tileY >= m_lastState->originY && tileY < m_lastState->originY + m_lastState->vcount)
+		{
+			*state = m_lastState;
+			return m_lastTilemap;
+		}
+
+		auto tilemap = m_lookup(tileX, tileY);
+		if (tilemap == nullptr)
+			return nullptr;
+
+		auto it = m_states.find(tilemap);
+		if (it == m_states.end())
+		{
+			auto newState = new TilemapState();
+			newState->originX = int(std::floor(tilemap->getX() / 16.0));
+			newState->originY = int(std::floor(tilemap->getY() / 16.0));
+			newState->hcount = tilemap->getHCount();
+			newState->vcount = tilemap->getVCount();
+			newState->visited.resize(newState->hcount * newState->vcount);
+
+			it = m_states.insert(tilemap, newState);
+		}
+
+		m_lastTilemap = tilemap;
+		m_lastState = it.value();
+
+		*state = m_lastState;
+		return tilemap;
+	}
+
+	bool TileFloodFill::canFill(Tilemap* tilemap, TilemapState* state, int x, int y) const
+	{
+		if (state->visited.testBit(y * state->hcount + x))
+			return false;
+
+		auto tile = tilemap->getTile(x, y);
+		return !Tilemap::IsInvisibleTile(tile) && m_startTiles.contains(tile);
+	}
+
+	void TileFloodFill::scanRow(int tileY, int left, int right)
+	{
+		//Push one seed for every run of fillable tiles in the row. The row can cross level boundaries
+		for (int x = left; x <= right;)
+		{
+			TilemapState* state = nullptr;
+			auto tilemap = tilemapAt(x, tileY, &state);
+			if (tilemap == nullptr)
+			{
+				++x;
+				continue;
+			}
+
+			auto localY = tileY - state->originY;
+			auto end = qMin(right, state->originX + state->hcount - 1);
+
+			bool inRun = false;
+			for (; x <= end; ++x)
+			{
+				if (canFill(tilemap, state, x - state->originX, localY))
+				{
+					if (!inRun)
+						m_seeds.push_back(QPoint(x, tileY));
+					inRun = true;
+				}
+				else inRun = false;
+			}
+		}
+	}
+
+	int TileFloodFill::fill(int startTileX, int startTileY, const Tilemap* pattern)
+	{
+		m_pattern = pattern;
+		m_patternOffsetX = (int)std::ceil(double(startTileX) / pattern->getHCount()) * pattern->getHCount() - startTileX;
+		m_patternOffsetY = (int)std::ceil(double(startTileY) / pattern->getVCount()) * pattern->getVCount() - startTileY;
+
+		//Get a set of tiles that can be replaced
+		for (auto y = 0; y < pattern->getVCount(); ++y)
+		{
+			for (auto x = 0; x < pattern->getHCount(); ++x)
+			{
+				TilemapState* state = nullptr;
+				auto tilemap = tilemapAt(startTileX + x, startTileY + y, &state);
+
+				int tile = 0;
+				if (tilemap && tilemap->tryGetTile(startTileX + x - state->originX, startTileY + y - state->originY, &tile))
+					m_startTiles.insert(tile);
+			}
+		}
+
+		m_seeds.push_back(QPoint(startTileX, startTileY));
+		while (!m_seeds.isEmpty())
+		{
+			auto seed = m_seeds.takeLast();
+
+			TilemapState* state = nullptr;
+			auto tilemap = tilemapAt(seed.x(), seed.y(), &state);
+			if (tilemap == nullptr)
+				continue;
+
+			auto y = seed.y() - state->originY;
+			auto x = seed.x() - state->originX;
+
+			if (!canFill(tilemap, state, x, y))
+				continue;
+
+			//Extend the span left and right as far as it goes within this level
+			auto left = x;
+			auto right = x;
+			while (left > 0 && canFill(tilemap, state, left - 1, y))
+				--left;
+
+			while (right < state->hcount - 1 && canFill(tilemap, state, right + 1, y))
+				++right;
+
+			state->visited.fill(true, y * state->hcount + left, y * state->hcount + right + 1);
+
+			m_spans.push_back(Span{ tilemap, state->originX, state->originY, y, left, right });
+			m_tileCount += right - left + 1;
+
+			//The span reached the level edge, so carry on into the neighbouring level
+			if (left == 0)
+				m_seeds.push_back(QPoint(state->originX - 1, seed.y()));
+
+			if (right == state->hcount - 1)
+				m_seeds.push_back(QPoint(state->originX + state->hcount, seed.y()));
+
+			auto worldLeft = state->originX + left;
+			auto worldRight = state->originX + right;
+			scanRow(seed.y() - 1, worldLeft, worldRight);
+			scanRow(seed.y() + 1, worldLeft, worldRight);
+		}
+
+		return m_tileCount;
+	}
+
+	int TileFloodFill::getPatternTile(const Tilemap* pattern, int patternOffsetX, int patternOffsetY, int tileX, int tileY)
+	{
+		auto hcount = (int)pattern->getHCount();
+		auto vcount = (int)pattern->getVCount();
+
+		auto patternTileX = ((tileX + patternOffsetX) % hcount + hcount) % hcount;
+		auto patternTileY = ((tileY + patternOffsetY) % vcount + vcount) % vcount;
+		return pattern->getTile(patternTileX, patternTileY);
+	}
+};
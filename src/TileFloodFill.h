@@ -0,0 +1,80 @@
+#ifndef TILEFLOODFILLH
+#define TILEFLOODFILLH
+
+#include <functional>
+#include <QHash>
+#include <QSet>
+#include <QBitArray>
+#include <QVector>
+#include <QPoint>
+#include "Tilemap.h"
+
+namespace TilesEditor
+{
+	//Span based (scanline) pattern flood fill over a tile layer that can be split across many level tilemaps.
+	//Used by both the real flood fill and the flood fill preview
+	class TileFloodFill
+	{
+	public:
+		//A horizontal run of tiles to fill. left/right are inclusive and local to the tilemap
+		struct Span {
+			Tilemap* tilemap;
+			int originX;
+			int originY;
+			int tileY;
+			int left;
+			int right;
+		};
+
+		//Return the tilemap covering the world tile position, or nullptr if nothing can be filled there
+		typedef std::function<Tilemap* (int tileX, int tileY)> TilemapLookup;
+
+	private:
+		struct TilemapState {
+			int originX;
+			int originY;
+			int hcount;
+			int vcount;
+			QBitArray visited;
+		};
+
+		TilemapLookup m_lookup;
+		QSet<int> m_startTiles;
+		QHash<Tilemap*, TilemapState*> m_states;
+		QVector<Span> m_spans;
+		QVector<QPoint> m_seeds;
+
+		Tilemap* m_lastTilemap = nullptr;
+		TilemapState* m_lastState = nullptr;
+
+		const Tilemap* m_pattern = nullptr;
+		int m_patternOffsetX = 0;
+		int m_patternOffsetY = 0;
+		int m_tileCount = 0;
+
+		Tilemap* tilemapAt(int tileX, int tileY, TilemapState** state);
+		bool canFill(Tilemap* tilemap, TilemapState* state, int x, int y) const;
+		void scanRow(int tileY, int left, int right);
+
+	public:
+		TileFloodFill(TilemapLookup lookup);
+		~TileFloodFill();
+
+		int fill(int startTileX, int startTileY, const Tilemap* pattern);
+
+		const QVector<Span>& getSpans() const { return m_spans; }
+		const QSet<int>& getStartTiles() const { return m_startTiles; }
+		int getTileCount() const { return m_tileCount; }
+		int getPatternOffsetX() const { return m_patternOffsetX; }
+		int getPatternOffsetY() const { return m_patternOffsetY; }
+
+		//Pattern tile for a world tile position (relative to the start position of the last fill)
+		int getPatternTile(int tileX, int tileY) const {
+			return getPatternTile(m_pattern, m_patternOffsetX, m_patternOffsetY, tileX, tileY);
+		}
+
+		static int getPatternTile(const Tilemap* pattern, int patternOffsetX, int patternOffsetY, int tileX, int tileY);
+	};
+};
+
+#endif
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <iterator>
+#include <atomic>
 #include <Level.h>
 #include "Tilemap.h"
 #include "IEngine.h"
@@ -14,26 +17,136 @@ namespace TilesEditor
         m_hcount = source.m_hcount;
         m_vcount = source.m_vcount;
         m_layerIndex = source.m_layerIndex;
-        m_tiles = new int[m_hcount * m_vcount];
 
-        memcpy(m_tiles, source.m_tiles, m_hcount * m_vcount * sizeof(int));
+        //Chunks are shared with the source until either tilemap writes to them
+        m_chunksHCount = source.m_chunksHCount;
+        m_chunks = source.m_chunks;
+        m_revision = source.m_revision;
     }
 
     Tilemap::Tilemap(IWorld* world, double x, double y, int hcount, int vcount, int layerIndex) :
 		AbstractLevelEntity(world, x, y), m_hcount(hcount), m_vcount(vcount)
 	{
-		m_tiles = new int[hcount * vcount];
+        m_chunksHCount = (m_hcount + TILE_CHUNK_SIZE - 1) / TILE_CHUNK_SIZE;
+        m_chunks.resize(m_chunksHCount * ((m_vcount + TILE_CHUNK_SIZE - 1) / TILE_CHUNK_SIZE));
 		clear(Tilemap::MakeTile(0, 0, 0));
 
 		m_layerIndex = layerIndex;
 	}
 
+    const QExplicitlySharedDataPointer<Tilemap::TileChunk>& Tilemap::invisibleChunk()
+    {
+        static QExplicitlySharedDataPointer<TileChunk> chunk = []() {
+            auto retval = new TileChunk();
+            std::fill(std::begin(retval->tiles), std::end(retval->tiles), Tilemap::MakeInvisibleTile(0));
+            return QExplicitlySharedDataPointer<TileChunk>(retval);
+        }();
 
+        return chunk;
+    }
+
+    quint64 Tilemap::nextRevision()
+    {
+        static std::atomic<quint64> revision(0);
+        return ++revision;
+    }
 
 	void Tilemap::clear(int tile)
 	{
-		for (unsigned int i = 0; i < m_hcount * m_vcount; ++i)
-			m_tiles[i] = tile;
+        //Every chunk points at the same block until it is written to
+        QExplicitlySharedDataPointer<TileChunk> chunk;
+        if (tile == Tilemap::MakeInvisibleTile(0))
+            chunk = invisibleChunk();
+        else {
+            chunk = QExplicitlySharedDataPointer<TileChunk>(new TileChunk());
+            std::fill(std::begin(chunk->tiles), std::end(chunk->tiles), tile);
+        }
+
+        m_chunks.fill(chunk);
+        m_revision = nextRevision();
+
+		invalidateRenderCache();
+	}
+
+	void Tilemap::setTiles(const QVector<int>& tiles, int hcount, int vcount)
+	{
+		//Narrower than a tile, so there are no chunks
+		if (m_chunksHCount == 0)
+			return;
+
+		auto invisibleTile = Tilemap::MakeInvisibleTile(0);
+		auto chunksVCount = m_chunks.size() / m_chunksHCount;
+
+		for (auto chunkY = 0U; chunkY < chunksVCount; ++chunkY)
+		{
+			for (auto chunkX = 0U; chunkX < m_chunksHCount; ++chunkX)
+			{
+				auto chunk = QExplicitlySharedDataPointer<TileChunk>(new TileChunk());
+				bool invisible = true;
+
+				for (auto y = 0; y < TILE_CHUNK_SIZE; ++y)
+				{
+					for (auto x = 0; x < TILE_CHUNK_SIZE; ++x)
+					{
+						int tileX = chunkX * TILE_CHUNK_SIZE + x;
+						int tileY = chunkY * TILE_CHUNK_SIZE + y;
+
+						auto tile = tileX < hcount && tileY < vcount ? tiles[tileY * hcount + tileX] : invisibleTile;
+						chunk->tiles[y * TILE_CHUNK_SIZE + x] = tile;
+						invisible = invisible && tile == invisibleTile;
+					}
+				}
+
+				m_chunks[chunkY * m_chunksHCount + chunkX] = invisible ? invisibleChunk() : chunk;
+			}
+		}
+
+		m_revision = nextRevision();
+		invalidateRenderCache();
+	}
+
+	Tilemap::RenderChunk* Tilemap::getRenderChunk(int chunkX, int chunkY, Image* tilesetImage)
+	{
+		if (m_renderChunks.isEmpty())
+			m_renderChunks.resize(getRenderChunksHCount() * getRenderChunksVCount());
+
+		//Chunks composited with a different tileset image are no longer valid
+		if (m_renderChunksTileset != tilesetImage)
+		{
+			m_renderChunksTileset = tilesetImage;
+			invalidateRenderCache();
+		}
+
+		return &m_renderChunks[chunkY * getRenderChunksHCount() + chunkX];
+	}
+
+	void Tilemap::invalidateRenderCache()
+	{
+		for (auto& chunk : m_renderChunks)
+			chunk.dirty = true;
+	}
+
+	void Tilemap::releaseRenderCache()
+	{
+		m_renderChunks.clear();
+		m_renderChunksTileset = nullptr;
+	}
+
+	qint64 Tilemap::getMemoryUsage() const
+	{
+		qint64 retval = sizeof(Tilemap);
+
+		//Chunks shared with other tilemaps are counted in full by each of them
+		for (auto& chunk : m_chunks)
+		{
+			if (chunk != invisibleChunk())
+				retval += sizeof(TileChunk);
+		}
+
+		for (auto& renderChunk : m_renderChunks)
+			retval += renderChunk.image.sizeInBytes();
+
+		return retval;
 	}
 
 
@@ -41,14 +154,16 @@ namespace TilesEditor
     {
         // Guard self assignment
         if (this == &other)
-            return *this; // delete[]/size=0 would also be ok
+            return *this;
 
         m_hcount = other.m_hcount;
         m_vcount = other.m_vcount;
         m_layerIndex = other.m_layerIndex;
-        m_tiles = new int[m_hcount * m_vcount];
+        m_chunksHCount = other.m_chunksHCount;
+        m_chunks = other.m_chunks;
+        m_revision = other.m_revision;
 
-        memcpy(m_tiles, other.m_tiles, m_hcount * m_vcount * sizeof(int));
+        releaseRenderCache();
         return *this;
     }
 
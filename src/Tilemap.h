@@ -2,9 +2,13 @@
 #define TILEMAPH
 
 #include <QPainter>
+#include <QImage>
+#include <QVector>
 #include <QList>
 #include <QPair>
 #include <QRect>
+#include <QSharedData>
+#include <QExplicitlySharedDataPointer>
 #include "AbstractLevelEntity.h"
 #include "Image.h"
 #include "LevelEntityType.h"
@@ -18,13 +22,59 @@ namespace TilesEditor
 	{
 		friend class Renderer;
 
+	public:
+		//Number of tiles (across and down) stored in a single tile chunk
+		static const int TILE_CHUNK_SIZE = 16;
+
+		//Number of tiles (across and down) pre-composited into a single render chunk
+		static const int RENDER_CHUNK_SIZE = 32;
+
+		//Tiles are stored in fixed size blocks that are shared between copies until written to
+		struct TileChunk :
+			public QSharedData
+		{
+			int tiles[TILE_CHUNK_SIZE * TILE_CHUNK_SIZE];
+		};
+
+		struct RenderChunk
+		{
+			QImage image;
+			bool dirty = true;
+			bool empty = false;
+		};
+
 	private:
 		unsigned int    m_hcount,
 			m_vcount;
 
 		double m_layerIndex;
-		int* m_tiles;
 
+		unsigned int m_chunksHCount;
+		QVector<QExplicitlySharedDataPointer<TileChunk>> m_chunks;
+
+		static const QExplicitlySharedDataPointer<TileChunk>& invisibleChunk();
+
+		//Changes whenever the tiles change. Values are unique across all tilemaps, so
+		//two tilemaps with the same revision hold the same tiles
+		quint64 m_revision = 0;
+		static quint64 nextRevision();
+
+		int chunkIndex(unsigned int x, unsigned int y) const {
+			return (y / TILE_CHUNK_SIZE) * m_chunksHCount + (x / TILE_CHUNK_SIZE);
+		}
+
+		static int chunkTileIndex(unsigned int x, unsigned int y) {
+			return (y % TILE_CHUNK_SIZE) * TILE_CHUNK_SIZE + (x % TILE_CHUNK_SIZE);
+		}
+
+		//Lazily created the first time this tilemap is drawn through Level::drawTilemap
+		QVector<RenderChunk> m_renderChunks;
+		Image* m_renderChunksTileset = nullptr;
+
+		void invalidateRenderTile(unsigned int x, unsigned int y) {
+			if (!m_renderChunks.isEmpty())
+				m_renderChunks[(y / RENDER_CHUNK_SIZE) * getRenderChunksHCount() + (x / RENDER_CHUNK_SIZE)].dirty = true;
+		}
 
 	public:
 		Tilemap(const Tilemap& source);
@@ -32,18 +82,13 @@ namespace TilesEditor
 		Tilemap(IWorld* world, double x, double y, int hcount, int vcount, int layerIndex);
 
 		~Tilemap() {
-			delete m_tiles;
 		}
 
 		void clear(int tile);
 
-		/*
-		void reset(int hcount, int vcount) {
-			delete m_tiles;
-			m_hcount = hcount;
-			m_vcount = vcount;
-			m_tiles = new int[hcount * vcount];
-		}*/
+		//Replace every tile from a row-major array of hcount * vcount tiles.
+		//Blocks that are completely invisible share the invisible chunk
+		void setTiles(const QVector<int>& tiles, int hcount, int vcount);
 
 
 		int getWidth() const override {
@@ -76,26 +121,58 @@ namespace TilesEditor
 		Tilemap& operator=(const Tilemap& other);
 		void setTile(unsigned int x, unsigned int y, int tile) {
 			if (x < m_hcount && y < m_vcount) {
-				m_tiles[y * m_hcount + x] = tile;
+				auto& chunk = m_chunks[chunkIndex(x, y)];
+
+				if (chunk->tiles[chunkTileIndex(x, y)] != tile)
+				{
+					//Copy the chunk if it is shared with another tilemap (or is the invisible chunk)
+					chunk.detach();
+					chunk->tiles[chunkTileIndex(x, y)] = tile;
+					m_revision = nextRevision();
+					invalidateRenderTile(x, y);
+				}
 			}
 		}
 
 		int getTile(unsigned int x, unsigned int y) const {
 			if (x < m_hcount && y < m_vcount) {
-				return m_tiles[y * m_hcount + x];
+				return m_chunks.at(chunkIndex(x, y))->tiles[chunkTileIndex(x, y)];
 			}
 			return 0;
 		}
 
 		bool tryGetTile(unsigned int x, unsigned int y, int* tile) const {
 			if (x < m_hcount && y < m_vcount) {
-				*tile = m_tiles[y * m_hcount + x];
+				*tile = m_chunks.at(chunkIndex(x, y))->tiles[chunkTileIndex(x, y)];
 				return true;
 			}
 			*tile = MakeInvisibleTile(0);
 			return false;
 		}
 
+		quint64 getRevision() const {
+			return m_revision;
+		}
+
+		int getRenderChunksHCount() const {
+			return (m_hcount + RENDER_CHUNK_SIZE - 1) / RENDER_CHUNK_SIZE;
+		}
+
+		int getRenderChunksVCount() const {
+			return (m_vcount + RENDER_CHUNK_SIZE - 1) / RENDER_CHUNK_SIZE;
+		}
+
+		bool isInvisibleChunk(unsigned int x, unsigned int y) const {
+			return m_chunks.at(chunkIndex(x, y)) == invisibleChunk();
+		}
+
+		RenderChunk* getRenderChunk(int chunkX, int chunkY, Image* tilesetImage);
+		void invalidateRenderCache();
+		void releaseRenderCache();
+
+		//Rough number of bytes used by the tiles and render cache
+		qint64 getMemoryUsage() const;
+
 		LevelEntityType getEntityType() const { return LevelEntityType::ENTITY_TILEMAP; }
 		void draw(QPainter* painter, const QRectF& viewRect, double x, double y) override;
 		void draw(QPainter* painter, const QRectF& viewRect, Image* tilesetImage, double x, double y);
@@ -1,6 +1,7 @@
 #include <QStringList>
 #include <QFile>
 #include <QTextStream>
+#include <QCryptographicHash>
 #include "Tileset.h"
 #include "StringTools.h"
 
@@ -21,6 +22,7 @@ namespace TilesEditor
 		m_vcount = jsonGetChildInt(node, "vcount", 0);
 
 		m_tileTypes.clear();
+		m_hash.clear();
 		
 		auto tileTypes = jsonGetChildString(node, "defaultTileTypes", "");
 
@@ -52,7 +54,10 @@ namespace TilesEditor
 	{
 		size_t index = (top * m_hcount) + left;
 		if (index < m_tileTypes.size())
+		{
 			m_tileTypes[index] = type;
+			m_hash.clear();
+		}
 	}
 
 	void Tileset::resize(int hcount, int vcount)
@@ -71,6 +76,28 @@ namespace TilesEditor
 		m_hcount = hcount;
 		m_vcount = vcount;
 		m_tileTypes = newTileTypes;
+		m_hash.clear();
+	}
+
+	const QByteArray& Tileset::getHash() const
+	{
+		if (m_hash.isEmpty())
+		{
+			QCryptographicHash hash(QCryptographicHash::Sha1);
+			hash.addData(text().toUtf8());
+			hash.addData(m_imageName.toUtf8());
+
+			if (hasTileTypes())
+			{
+				QVector<int> tileTypes(m_hcount * m_vcount);
+				for (auto i = 0; i < tileTypes.size(); ++i)
+					tileTypes[i] = getTileType(size_t(i));
+
+				hash.addData(QByteArrayView(reinterpret_cast<const char*>(tileTypes.constData()), tileTypes.size() * sizeof(int)));
+			}
+			m_hash = hash.result();
+		}
+		return m_hash;
 	}
 
 	void Tileset::loadFromFile(const QString& fileName)
@@ -22,6 +22,9 @@ namespace TilesEditor
 
 		QVector<int> m_tileTypes;
 
+		//Worked out by getHash, and cleared whenever anything it covers changes
+		mutable QByteArray m_hash;
+
 	public:
 		Tileset();
 		Tileset(const QString& imageName) { m_imageName = imageName; this->setText(m_imageName); }
@@ -40,19 +43,30 @@ namespace TilesEditor
 		void setTileType(int left, int top, int type);
 
 		const QString& getImageName() const { return m_imageName; }
-		void setImageName(const QString& name) { m_imageName = name; }
+		void setImageName(const QString& name) { m_imageName = name; m_hash.clear(); }
 		void loadFromFile(const QString& fileName);
 
 		void saveToFile();
 		void saveToFile(const QString& fileName);
 		cJSON* serializeJSON();
 
+		//SHA1 of the name, image name and tile types, which is everything a parsed level depends on
+		const QByteArray& getHash() const;
+
+		void setData(const QVariant& value, int role = Qt::UserRole + 1) override {
+			//The name is the display text
+			if (role == Qt::DisplayRole)
+				m_hash.clear();
+			QStandardItem::setData(value, role);
+		}
+
 		Tileset& operator=(const Tileset& other) {
 			m_fileName = other.m_fileName;
 			m_imageName = other.m_imageName;
 			m_hcount = other.m_hcount;
 			m_vcount = other.m_vcount;
 			m_tileTypes = other.m_tileTypes;
+			m_hash = other.m_hash;
 
 			setText(other.text());
 			return *this;
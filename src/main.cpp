@@ -14,6 +14,7 @@
 #include "AniEditorWindow.h"
 
 #include "DarkStyle.h"
+#include "Benchmarks.h"
  
 
 void myMessageHandler(QtMsgType type, const QMessageLogContext&, const QString& msg)
@@ -46,7 +47,16 @@ void myMessageHandler(QtMsgType type, const QMessageLogContext&, const QString&
 
 int main(int argc, char *argv[])
 {
+    //Benchmarks are headless unless another platform is asked for
+    auto runBenchmark = argc > 1 && QString(argv[1]) == "-benchmark";
+    if (runBenchmark && !qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
     QApplication app(argc, argv);
+
+    if (runBenchmark)
+        return TilesEditor::Benchmarks::run(QApplication::arguments().mid(2));
+
     QString exeDir = QApplication::applicationDirPath();
     QString settingsPath = QDir(exeDir).filePath("settings.ini");
     QSettings settings(settingsPath, QSettings::IniFormat);